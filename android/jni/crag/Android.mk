@@ -70,6 +70,7 @@ LOCAL_SRC_FILES := \
 	$(CRAG_PATH)/form/Engine.cpp \
 	$(CRAG_PATH)/form/Formation.cpp \
 	$(CRAG_PATH)/form/Mesh.cpp \
+	$(CRAG_PATH)/form/MidPointCache.cpp \
 	$(CRAG_PATH)/form/NodeBuffer.cpp \
 	$(CRAG_PATH)/form/Node.cpp \
 	$(CRAG_PATH)/form/Object.cpp \
@@ -104,6 +105,7 @@ LOCAL_SRC_FILES := \
 	$(CRAG_PATH)/gfx/Texture2d.cpp \
 	$(CRAG_PATH)/gfx/TextureCubeMap.cpp \
 	$(CRAG_PATH)/gfx/LitVertex.cpp \
+	$(CRAG_PATH)/gfx/TerrainVertex.cpp \
 	$(CRAG_PATH)/gfx/Uniform.cpp \
 	$(CRAG_PATH)/main.cpp \
 	$(CRAG_PATH)/pch.cpp \
@@ -137,6 +139,7 @@ LOCAL_SRC_FILES := \
 	$(CRAG_PATH)/smp/Semaphore.cpp \
 	$(CRAG_PATH)/smp/smp.cpp \
 	$(CRAG_PATH)/smp/Thread.cpp \
+	$(CRAG_PATH)/smp/ThreadPool.cpp \
 	$(CRAG_PATH)/ipc/Uid.cpp \
 
 LOCAL_ALLOW_UNDEFINED_SYMBOLS := true
@@ -0,0 +1,51 @@
+//
+//  terrain.vert
+//  crag
+//
+//  Created on 2026-10-18.
+//  This program is distributed under the terms of the GNU General Public License.
+//
+
+// per-object inputs from the renderer
+uniform MATRIX4 model_view_matrix;
+uniform MATRIX4 projection_matrix;
+uniform COLOR4 color;
+
+// per-vertex inputs from renderer (see gfx::TerrainVertex)
+attribute VECTOR3 vertex_position;
+attribute VECTOR2 vertex_normal;
+
+// outputs to poly.frag
+varying VECTOR3 fragment_position;
+varying VECTOR3 fragment_normal;
+varying COLOR4 fragment_diffuse;
+varying COLOR3 fragment_reflection;
+varying COLOR3 fragment_illumination;
+
+// mirrors gfx::TerrainVertex::DecodeNormal
+VECTOR3 DecodeNormal(VECTOR2 encoded)
+{
+	VECTOR3 normal = vec3(encoded, 1. - abs(encoded.x) - abs(encoded.y));
+	if (normal.z < 0.)
+	{
+		VECTOR2 sign_not_zero = vec2(normal.x >= 0. ? 1. : -1., normal.y >= 0. ? 1. : -1.);
+		normal.xy = (1. - abs(normal.yx)) * sign_not_zero;
+	}
+	return normalize(normal);
+}
+
+void main(void)
+{
+	VECTOR4 position4 = model_view_matrix * vec4(vertex_position, 1.);
+	gl_Position = projection_matrix * position4;
+	fragment_position = position4.xyz;
+
+	fragment_normal = (model_view_matrix * vec4(DecodeNormal(vertex_normal), 0.)).xyz;
+
+	fragment_diffuse = color;
+
+	LightResults result = ForegroundLightVertex(fragment_position, fragment_normal);
+
+	fragment_reflection = result.reflection;
+	fragment_illumination = result.illumination;
+}
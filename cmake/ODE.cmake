@@ -20,7 +20,7 @@ if (${CMAKE_CXX_COMPILER_ID} STREQUAL MSVC)
 			URL "${ODE_URL}"
 			URL_MD5 "${ODE_URL_MD5}"
 			UPDATE_COMMAND ""
-			CONFIGURE_COMMAND cd <SOURCE_DIR>\\build && premake4 --platform=${ODE_PREMAKE_PLATFORM} --only-single --only-static vs2010
+			CONFIGURE_COMMAND cd <SOURCE_DIR>\\build && premake4 --platform=${ODE_PREMAKE_PLATFORM} --only-single --only-static --with-ou vs2010
 				COMMAND "devenv.exe" -Upgrade <SOURCE_DIR>\\build\\vs2010\\ode.sln
 			BUILD_COMMAND MSBuild <SOURCE_DIR>\\build\\vs2010\\ode.sln /property:Configuration=Release /property:Platform=${ODE_MSBUILD_PLATFORM}
 				COMMAND MSBuild <SOURCE_DIR>\\build\\vs2010\\ode.sln /property:Configuration=Debug /property:Platform=${ODE_MSBUILD_PLATFORM}
@@ -40,7 +40,7 @@ else ()
 			URL "${ODE_URL}"
 			URL_MD5 "${ODE_URL_MD5}"
 			UPDATE_COMMAND ""
-			CONFIGURE_COMMAND cd <SOURCE_DIR> && ./bootstrap COMMAND <SOURCE_DIR>/configure --disable-demos --with-trimesh=opcode --prefix=<INSTALL_DIR>
+			CONFIGURE_COMMAND cd <SOURCE_DIR> && ./bootstrap COMMAND <SOURCE_DIR>/configure --disable-demos --with-trimesh=opcode --enable-ou --prefix=<INSTALL_DIR>
 			BUILD_COMMAND $(MAKE) COMMAND $(MAKE) install
 			INSTALL_COMMAND ""
 	)
@@ -0,0 +1,676 @@
+//
+//  bench/FormBench.cpp
+//  crag
+//
+//  Created on 2026-10-18.
+//  This program is distributed under the terms of the GNU General Public License.
+//
+
+#include "pch.h"
+
+#include "form/Formation.h"
+#include "form/Mesh.h"
+#include "form/MeshFilter.h"
+#include "form/Scene.h"
+#include "form/Surrounding.h"
+
+#include "entity/sim/PlanetShader.h"
+
+#include "gfx/LodParameters.h"
+
+#include "core/app.h"
+#include "core/ConfigEntry.h"
+
+// headless benchmark of the formation system; moves a camera along a
+// deterministic path and reports the cost of each form::Scene tick;
+// usage: crag_form_bench [--option=value ...] [config_key=value ...]
+
+namespace
+{
+	////////////////////////////////////////////////////////////////////////////////
+	// config
+
+	// altitudes are proportional to planet radius
+	CONFIG_DEFINE(bench_orbit_altitude, .5);
+	CONFIG_DEFINE(bench_flyover_altitude, .005);
+	CONFIG_DEFINE(bench_flyover_angle, .05);
+	CONFIG_DEFINE(bench_descent_start_altitude, 2.);
+	CONFIG_DEFINE(bench_descent_end_altitude, .0025);
+
+	CONFIG_DEFINE(bench_lod_min_distance, 1.f);
+
+	// simulated time between ticks; determines camera velocity
+	CONFIG_DEFINE(bench_tick_duration, 1. / 60.);
+
+	// as in MonitorOrigin; the origin moves to the camera
+	// when the nearest geometry is too close relative to the origin
+	CONFIG_DEFINE(bench_min_precision_score, .001f);
+
+	// game config which would otherwise make the work done in a tick depend on
+	// the speed of the machine; set before the command line is read and reported
+	// in the output; e.g. without a time budget, every expansion candidate is tried
+	char const * const fixed_config[][2] =
+	{
+		{ "node_expansion_time_budget", "0" }
+	};
+
+	////////////////////////////////////////////////////////////////////////////////
+	// types
+
+	enum class Path
+	{
+		orbit,
+		flyover,
+		descent,
+		recorded
+	};
+
+	enum class MeshMode
+	{
+		flat,
+		patched,
+		indexed
+	};
+
+	enum class Format
+	{
+		csv,
+		json
+	};
+
+	char const * const path_names[] = { "orbit", "flyover", "descent", "recorded" };
+	char const * const mesh_mode_names[] = { "flat", "patched", "indexed" };
+	char const * const format_names[] = { "csv", "json" };
+
+	struct Options
+	{
+		Path path = Path::orbit;
+		MeshMode mesh_mode = MeshMode::flat;
+		Format format = Format::csv;
+		char const * path_filename = nullptr;
+		char const * output_filename = nullptr;
+		int num_ticks = 1000;
+		int num_quaterne = 16384;
+		int num_planets = 1;
+		int num_observers = 1;
+		int seed = 3634;
+		double radius = 10000000.;
+	};
+
+	// measurements of a single tick
+	struct Sample
+	{
+		core::Time tick_duration;
+		core::Time mesh_duration;	// zero if no mesh was generated
+		core::Time observer_mesh_duration;	// zero unless there are several observers
+		int num_quaterne;
+		int num_expansions;
+		int num_vertices;
+		int num_observer_vertices;	// total over the meshes seen by each observer
+		bool reorigin;
+		int num_points;
+		float point_fragmentation;
+	};
+
+	using Positions = std::vector<geom::uni::Vector3>;
+	using Samples = std::vector<Sample>;
+
+	////////////////////////////////////////////////////////////////////////////////
+	// command-line
+
+	// sets value to the index of the matching name; returns false if none match
+	template <typename ENUM, std::size_t N>
+	bool ParseName(char const * const (& names)[N], char const * string, ENUM & value)
+	{
+		auto found = std::find_if(std::begin(names), std::end(names), [string] (char const * name)
+		{
+			return std::strcmp(name, string) == 0;
+		});
+
+		if (found == std::end(names))
+		{
+			return false;
+		}
+
+		value = static_cast<ENUM>(found - std::begin(names));
+		return true;
+	}
+
+	bool ParseOption(char const * key, char const * value, Options & options)
+	{
+		if (! std::strcmp(key, "path"))
+		{
+			return ParseName(path_names, value, options.path) && options.path != Path::recorded;
+		}
+
+		if (! std::strcmp(key, "path-file"))
+		{
+			options.path = Path::recorded;
+			options.path_filename = value;
+			return true;
+		}
+
+		if (! std::strcmp(key, "mesh"))
+		{
+			return ParseName(mesh_mode_names, value, options.mesh_mode);
+		}
+
+		if (! std::strcmp(key, "format"))
+		{
+			return ParseName(format_names, value, options.format);
+		}
+
+		if (! std::strcmp(key, "output"))
+		{
+			options.output_filename = value;
+			return true;
+		}
+
+		if (! std::strcmp(key, "ticks"))
+		{
+			return sscanf(value, "%d", & options.num_ticks) == 1 && options.num_ticks > 0;
+		}
+
+		if (! std::strcmp(key, "quaterne"))
+		{
+			return sscanf(value, "%d", & options.num_quaterne) == 1 && options.num_quaterne > 0;
+		}
+
+		if (! std::strcmp(key, "planets"))
+		{
+			return sscanf(value, "%d", & options.num_planets) == 1 && options.num_planets > 0;
+		}
+
+		if (! std::strcmp(key, "observers"))
+		{
+			return sscanf(value, "%d", & options.num_observers) == 1 && options.num_observers > 0;
+		}
+
+		if (! std::strcmp(key, "seed"))
+		{
+			return sscanf(value, "%d", & options.seed) == 1;
+		}
+
+		if (! std::strcmp(key, "radius"))
+		{
+			return sscanf(value, "%lg", & options.radius) == 1 && options.radius > 0;
+		}
+
+		return false;
+	}
+
+	// options take the form, --key=value; anything else is passed to config
+	bool ParseCommandLine(int argc, char * * argv, Options & options)
+	{
+		for (; argc > 0; ++ argv, -- argc)
+		{
+			auto argument = * argv;
+			auto separator = std::strchr(argument, '=');
+
+			if (std::strncmp(argument, "--", 2) != 0)
+			{
+#if defined(ENABLE_CONFIG)
+				auto value = "1";
+				if (separator)
+				{
+					* separator = '\0';
+					value = separator + 1;
+				}
+
+				auto entry = ::crag::core::config::Entry::find(argument);
+				if (entry != nullptr && entry->Set(value))
+				{
+					continue;
+				}
+#endif
+
+				ERROR_MESSAGE("unrecognised config parameter, \"%s\"", argument);
+				return false;
+			}
+
+			if (! separator)
+			{
+				ERROR_MESSAGE("missing value in option, \"%s\"", argument);
+				return false;
+			}
+
+			* separator = '\0';
+			if (! ParseOption(argument + 2, separator + 1, options))
+			{
+				ERROR_MESSAGE("bad option, \"%s=%s\"", argument, separator + 1);
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool SetFixedConfig()
+	{
+		for (auto const & parameter : fixed_config)
+		{
+#if defined(ENABLE_CONFIG)
+			auto entry = ::crag::core::config::Entry::find(parameter[0]);
+			if (entry != nullptr && entry->Set(parameter[1]))
+			{
+				continue;
+			}
+#endif
+
+			ERROR_MESSAGE("failed to set config parameter, \"%s\"", parameter[0]);
+			return false;
+		}
+
+		return true;
+	}
+
+	// the current value of a config parameter as text
+	std::string GetConfigValue(char const * name)
+	{
+#if defined(ENABLE_CONFIG)
+		char value[64];
+		auto entry = ::crag::core::config::Entry::find(name);
+		if (entry != nullptr && entry->Get(value, sizeof(value)))
+		{
+			return value;
+		}
+#endif
+
+		return "unknown";
+	}
+
+	// reads one absolute position per line: x y z
+	bool LoadPositions(char const * filename, Positions & positions)
+	{
+		auto file = fopen(filename, "r");
+		if (! file)
+		{
+			ERROR_MESSAGE("failed to open camera path, \"%s\"", filename);
+			return false;
+		}
+
+		geom::uni::Vector3 position;
+		while (fscanf(file, "%lg %lg %lg", & position.x, & position.y, & position.z) == 3)
+		{
+			positions.push_back(position);
+		}
+
+		fclose(file);
+
+		if (positions.empty())
+		{
+			ERROR_MESSAGE("no positions in camera path, \"%s\"", filename);
+			return false;
+		}
+
+		return true;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	// simulation
+
+	// planets are laid out along the x axis with the first at the origin
+	geom::uni::Vector3 GetPlanetCenter(Options const & options, int planet_index)
+	{
+		return geom::uni::Vector3(options.radius * 4. * planet_index, 0., 0.);
+	}
+
+	// position of the camera at the given tick
+	geom::uni::Vector3 GetCameraPosition(Options const & options, Positions const & positions, int tick)
+	{
+		auto t = (options.num_ticks > 1) ? double(tick) / (options.num_ticks - 1) : 0.;
+		auto radius = options.radius;
+
+		switch (options.path)
+		{
+			case Path::orbit:
+			{
+				auto angle = t * 2. * PI;
+				auto distance = radius * (1. + bench_orbit_altitude);
+				return geom::uni::Vector3(std::cos(angle), 0., std::sin(angle)) * distance;
+			}
+
+			case Path::flyover:
+			{
+				auto angle = t * bench_flyover_angle;
+				auto distance = radius * (1. + bench_flyover_altitude);
+				return geom::uni::Vector3(std::cos(angle), std::sin(angle), 0.) * distance;
+			}
+
+			case Path::descent:
+			{
+				// altitude falls exponentially so that time is spent at every scale
+				auto altitude_ratio = bench_descent_end_altitude / bench_descent_start_altitude;
+				auto altitude = bench_descent_start_altitude * std::pow(altitude_ratio, t);
+				return geom::uni::Vector3(0., 1., 0.) * (radius * (1. + altitude));
+			}
+
+			case Path::recorded:
+				ASSERT(tick < static_cast<int>(positions.size()));
+				return positions[tick];
+		}
+
+		DEBUG_BREAK("bad path, %d", int(options.path));
+		return geom::uni::Vector3::Zero();
+	}
+
+	// velocity of the camera at the given tick, from the motion to the next tick
+	form::Vector3 GetCameraVelocity(Options const & options, Positions const & positions, int tick)
+	{
+		auto next_tick = std::min(tick + 1, options.num_ticks - 1);
+		auto previous_tick = next_tick - 1;
+		if (previous_tick < 0)
+		{
+			return form::Vector3::Zero();
+		}
+
+		auto displacement = GetCameraPosition(options, positions, next_tick) - GetCameraPosition(options, positions, previous_tick);
+		return static_cast<form::Vector3>(displacement / bench_tick_duration);
+	}
+
+	// additional observers are spread evenly along the camera path
+	gfx::LodParametersVector GetSecondaryLodParameters(Options const & options, Positions const & positions, geom::Space const & space, int tick)
+	{
+		gfx::LodParametersVector secondary_lod_parameters;
+		for (auto observer_index = 1; observer_index < options.num_observers; ++ observer_index)
+		{
+			auto observer_tick = (tick + options.num_ticks * observer_index / options.num_observers) % options.num_ticks;
+			secondary_lod_parameters.push_back({
+				space.AbsToRel(GetCameraPosition(options, positions, observer_tick)),
+				bench_lod_min_distance,
+				GetCameraVelocity(options, positions, observer_tick)
+			});
+		}
+
+		return secondary_lod_parameters;
+	}
+
+	bool ShouldReviseOrigin(gfx::LodParameters const & lod_parameters, form::Scalar min_leaf_distance_squared)
+	{
+		if (min_leaf_distance_squared == std::numeric_limits<decltype(min_leaf_distance_squared)>::max())
+		{
+			return false;
+		}
+
+		auto distance_from_origin = geom::Magnitude(lod_parameters.center);
+		auto distance_from_surface = std::sqrt(min_leaf_distance_squared);
+
+		return distance_from_surface < distance_from_origin * bench_min_precision_score;
+	}
+
+	void ReserveFlatMesh(Options const & options, form::Mesh & mesh)
+	{
+		// same proportions as form::Engine
+		auto max_num_nodes = options.num_quaterne * form::Surrounding::num_nodes_per_quaterna;
+		auto max_num_tris = max_num_nodes * 2;
+		auto max_num_verts = max_num_tris * 2;
+
+		mesh.Reserve(max_num_verts, max_num_tris);
+	}
+
+	void InitMesh(Options const & options, form::Mesh & mesh)
+	{
+		switch (options.mesh_mode)
+		{
+			case MeshMode::flat:
+				ReserveFlatMesh(options, mesh);
+				break;
+
+			case MeshMode::patched:
+				mesh.EnablePatching(options.num_quaterne * form::Surrounding::num_nodes_per_quaterna);
+				break;
+
+			case MeshMode::indexed:
+				mesh.EnableIndexing();
+				break;
+		}
+	}
+
+	int GetNumVertices(form::Mesh const & mesh)
+	{
+		if (! mesh.IsIndexed())
+		{
+			return mesh.GetNumVertices();
+		}
+
+		auto num_vertices = 0;
+		for (auto chunk_index = 0; chunk_index != mesh.GetNumChunks(); ++ chunk_index)
+		{
+			num_vertices += static_cast<int>(mesh.GetChunk(chunk_index).GetVertices().size());
+		}
+
+		return num_vertices;
+	}
+
+	void Run(Options const & options, Positions const & positions, Samples & samples)
+	{
+		// formations must outlive the scene
+		auto shader = std::make_shared<sim::PlanetShader>();
+		std::vector<std::unique_ptr<form::Formation>> formations;
+		for (auto planet_index = 0; planet_index != options.num_planets; ++ planet_index)
+		{
+			auto shape = geom::uni::Sphere3(GetPlanetCenter(options, planet_index), options.radius);
+			formations.emplace_back(new form::Formation(options.seed + planet_index, shader, shape));
+		}
+
+		auto space = geom::Space(GetCameraPosition(options, positions, 0));
+
+		form::Scene scene(options.num_quaterne, options.num_quaterne);
+		for (auto & formation : formations)
+		{
+			scene.AddFormation(* formation, space);
+		}
+
+		form::Mesh mesh;
+		InitMesh(options, mesh);
+
+		// per-observer meshes depend on where the observers are and so cannot be patched
+		form::Mesh observer_mesh;
+		if (options.num_observers > 1)
+		{
+			ReserveFlatMesh(options, observer_mesh);
+		}
+		auto num_observer_vertices = 0;
+
+		auto const & surrounding = scene.GetSurrounding();
+
+		samples.reserve(options.num_ticks);
+		for (auto tick = 0; tick != options.num_ticks; ++ tick)
+		{
+			auto camera_position = GetCameraPosition(options, positions, tick);
+			auto camera_velocity = GetCameraVelocity(options, positions, tick);
+			gfx::LodParameters lod_parameters = { space.AbsToRel(camera_position), bench_lod_min_distance, camera_velocity };
+
+			Sample sample = { 0., 0., 0., 0, 0, 0, 0, false, 0, 0.f };
+			auto num_expansions = surrounding.GetNumExpansions();
+
+			auto tick_begin = app::GetTime();
+			if (ShouldReviseOrigin(lod_parameters, surrounding.GetMinLeafDistanceSquared()))
+			{
+				space = geom::Space(camera_position);
+				lod_parameters.center = form::Vector3::Zero();
+				scene.OnSpaceReset(space, lod_parameters);
+				sample.reorigin = true;
+			}
+
+			auto secondary_lod_parameters = GetSecondaryLodParameters(options, positions, space, tick);
+			auto changed = scene.Tick(lod_parameters, secondary_lod_parameters);
+			sample.tick_duration = app::GetTime() - tick_begin;
+			sample.num_quaterne = surrounding.GetNumQuaternaUsed();
+			sample.num_expansions = surrounding.GetNumExpansions() - num_expansions;
+
+			if (changed)
+			{
+				auto mesh_begin = app::GetTime();
+				scene.GenerateMesh(mesh, space);
+				sample.mesh_duration = app::GetTime() - mesh_begin;
+			}
+
+			// each observer is given the part of the shared mesh which faces it
+			if (changed && ! secondary_lod_parameters.empty())
+			{
+				auto observer_mesh_begin = app::GetTime();
+				auto generate_observer_mesh = [&] (form::Vector3 const & observer_center)
+				{
+					scene.GenerateMesh(observer_mesh, space, form::MeshFilter(observer_center));
+					num_observer_vertices += observer_mesh.GetNumVertices();
+				};
+
+				num_observer_vertices = 0;
+				generate_observer_mesh(lod_parameters.center);
+				for (auto const & secondary : secondary_lod_parameters)
+				{
+					generate_observer_mesh(secondary.center);
+				}
+				sample.observer_mesh_duration = app::GetTime() - observer_mesh_begin;
+			}
+
+			sample.num_vertices = GetNumVertices(mesh);
+			sample.num_observer_vertices = num_observer_vertices;
+			sample.num_points = surrounding.GetPoints().GetSize();
+			sample.point_fragmentation = surrounding.GetPoints().GetFragmentation();
+			samples.push_back(sample);
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////
+	// output
+
+	void WriteCsv(FILE * out, Samples const & samples)
+	{
+		for (auto const & parameter : fixed_config)
+		{
+			fprintf(out, "# %s=%s\n", parameter[0], GetConfigValue(parameter[0]).c_str());
+		}
+
+		fprintf(out, "tick,tick_seconds,num_quaterne,num_expansions,mesh_seconds,num_vertices,observer_mesh_seconds,num_observer_vertices,reorigin,num_points,point_fragmentation\n");
+
+		auto tick = 0;
+		for (auto const & sample : samples)
+		{
+			fprintf(out, "%d,%.9f,%d,%d,%.9f,%d,%.9f,%d,%d,%d,%.6f\n",
+				tick ++,
+				sample.tick_duration,
+				sample.num_quaterne,
+				sample.num_expansions,
+				sample.mesh_duration,
+				sample.num_vertices,
+				sample.observer_mesh_duration,
+				sample.num_observer_vertices,
+				int(sample.reorigin),
+				sample.num_points,
+				sample.point_fragmentation);
+		}
+	}
+
+	void WriteJson(FILE * out, Options const & options, Samples const & samples)
+	{
+		auto total_tick_duration = 0., max_tick_duration = 0., total_mesh_duration = 0., total_observer_mesh_duration = 0.;
+		auto num_meshes = 0;
+		auto num_samples = static_cast<int>(samples.size());
+		for (auto const & sample : samples)
+		{
+			total_tick_duration += sample.tick_duration;
+			max_tick_duration = std::max(max_tick_duration, sample.tick_duration);
+			total_mesh_duration += sample.mesh_duration;
+			total_observer_mesh_duration += sample.observer_mesh_duration;
+			num_meshes += sample.mesh_duration > 0;
+		}
+
+		fprintf(out, "{\n");
+		fprintf(out, "\t\"path\": \"%s\",\n", path_names[int(options.path)]);
+		fprintf(out, "\t\"mesh\": \"%s\",\n", mesh_mode_names[int(options.mesh_mode)]);
+		fprintf(out, "\t\"target_num_quaterne\": %d,\n", options.num_quaterne);
+		fprintf(out, "\t\"num_planets\": %d,\n", options.num_planets);
+		fprintf(out, "\t\"num_observers\": %d,\n", options.num_observers);
+		fprintf(out, "\t\"config\": {\n");
+		auto num_fixed_config = static_cast<int>(sizeof(fixed_config) / sizeof(fixed_config[0]));
+		for (auto index = 0; index != num_fixed_config; ++ index)
+		{
+			auto name = fixed_config[index][0];
+			fprintf(out, "\t\t\"%s\": \"%s\"%s\n", name, GetConfigValue(name).c_str(), (index + 1 < num_fixed_config) ? "," : "");
+		}
+		fprintf(out, "\t},\n");
+		fprintf(out, "\t\"summary\": {\n");
+		fprintf(out, "\t\t\"num_ticks\": %d,\n", num_samples);
+		fprintf(out, "\t\t\"total_tick_seconds\": %.9f,\n", total_tick_duration);
+		fprintf(out, "\t\t\"max_tick_seconds\": %.9f,\n", max_tick_duration);
+		fprintf(out, "\t\t\"num_meshes\": %d,\n", num_meshes);
+		fprintf(out, "\t\t\"total_mesh_seconds\": %.9f,\n", total_mesh_duration);
+		fprintf(out, "\t\t\"total_observer_mesh_seconds\": %.9f\n", total_observer_mesh_duration);
+		fprintf(out, "\t},\n");
+		fprintf(out, "\t\"ticks\": [\n");
+
+		for (auto tick = 0; tick != num_samples; ++ tick)
+		{
+			auto const & sample = samples[tick];
+			fprintf(out, "\t\t{ \"tick\": %d, \"tick_seconds\": %.9f, \"num_quaterne\": %d, \"num_expansions\": %d, \"mesh_seconds\": %.9f, \"num_vertices\": %d, \"observer_mesh_seconds\": %.9f, \"num_observer_vertices\": %d, \"reorigin\": %s, \"num_points\": %d, \"point_fragmentation\": %.6f }%s\n",
+				tick,
+				sample.tick_duration,
+				sample.num_quaterne,
+				sample.num_expansions,
+				sample.mesh_duration,
+				sample.num_vertices,
+				sample.observer_mesh_duration,
+				sample.num_observer_vertices,
+				sample.reorigin ? "true" : "false",
+				sample.num_points,
+				sample.point_fragmentation,
+				(tick + 1 == num_samples) ? "" : ",");
+		}
+
+		fprintf(out, "\t]\n");
+		fprintf(out, "}\n");
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// main
+
+int main(int argc, char * * argv)
+{
+	Options options;
+	if (! SetFixedConfig() || ! ParseCommandLine(argc - 1, argv + 1, options))
+	{
+		return EXIT_FAILURE;
+	}
+
+	Positions positions;
+	if (options.path == Path::recorded)
+	{
+		if (! LoadPositions(options.path_filename, positions))
+		{
+			return EXIT_FAILURE;
+		}
+
+		options.num_ticks = static_cast<int>(positions.size());
+	}
+
+	Samples samples;
+	Run(options, positions, samples);
+
+	auto out = options.output_filename ? fopen(options.output_filename, "w") : stdout;
+	if (! out)
+	{
+		ERROR_MESSAGE("failed to open output file, \"%s\"", options.output_filename);
+		return EXIT_FAILURE;
+	}
+
+	switch (options.format)
+	{
+		case Format::csv:
+			WriteCsv(out, samples);
+			break;
+
+		case Format::json:
+			WriteJson(out, options, samples);
+			break;
+	}
+
+	if (out != stdout)
+	{
+		fclose(out);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -55,6 +55,8 @@ namespace crag
 
 	public:
 		counted_object() { _counter.IncrementObject(); }
+		counted_object(counted_object const &) { _counter.IncrementObject(); }
+		counted_object & operator=(counted_object const &) { return * this; }
 		~counted_object() { _counter.DecrementObject(); }
 	private:
 		static _Counter _counter;
@@ -74,6 +74,28 @@ namespace core
 #endif
 		}
 		
+		// calls function on every element which is currently allocated;
+		// unlike for_each_activated, function may modify elements freely
+		// but the free list must be walked first to find the allocated ones
+		template <typename Function>
+		void for_each_allocated(Function function)
+		{
+			auto activated_end = reinterpret_cast<value_type *>(_unlinked_begin);
+			std::vector<bool> is_free(activated_end - _array, false);
+			for (auto node_iterator = _free_list_head; node_iterator != _unlinked_begin; node_iterator = node_iterator->next)
+			{
+				is_free[get_index(* reinterpret_cast<value_type *>(node_iterator))] = true;
+			}
+
+			for (auto element = _array; element != activated_end; ++ element)
+			{
+				if (! is_free[get_index(* element)])
+				{
+					function(* element);
+				}
+			}
+		}
+
 		// returns uninitialized block of memory large enough to hold object of type, value_type
 		// or nullptr if the pool is full
 		void * allocate()
@@ -167,6 +189,13 @@ namespace core
 			return _num_allocated;
 		}
 
+		// returns the count of elements which have ever been allocated since
+		// the last free list reset; includes free elements between them
+		constexpr size_type activated_size() const noexcept
+		{
+			return core::get_index(_array, * reinterpret_cast<value_type const *>(_unlinked_begin));
+		}
+
 		// returns the maximum count of objects
 		constexpr int capacity() const noexcept
 		{
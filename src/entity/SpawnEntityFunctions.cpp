@@ -166,11 +166,12 @@ EntityHandle SpawnPlanet(const Sphere3 & sphere, int random_seed, int num_crater
 		auto & engine = entity.GetEngine();
 		physics::Engine & physics_engine = engine.GetPhysicsEngine();
 		auto const & formation = controller->GetFormation();
-		auto const * polyhedron = engine.GetScene().GetPolyhedron(formation);
+		auto const & scene = engine.GetScene();
+		auto const * polyhedron = scene.GetPolyhedron(formation);
 		if (polyhedron)
 		{
 			auto body = std::unique_ptr<physics::PlanetBody>(
-				new physics::PlanetBody(sphere.center, physics_engine, * polyhedron, physics::Scalar(sphere.radius)));
+				new physics::PlanetBody(sphere.center, physics_engine, * polyhedron, scene.GetSurrounding(), physics::Scalar(sphere.radius)));
 			entity.SetLocation(std::move(body));
 		}
 		else
@@ -16,6 +16,7 @@
 
 #include "form/CastRay.h"
 #include "form/ForEachFaceInSphere.h"
+#include "form/Surrounding.h"
 
 #include "gfx/Debug.h"
 #include "gfx/PlainVertex.h"
@@ -54,6 +55,152 @@ namespace std
 	};
 }
 
+namespace
+{
+	////////////////////////////////////////////////////////////////////////////////
+	// config constants
+
+	// terrain is gathered from a sphere this much bigger (proportionally)
+	// than the bounding sphere of a body so that it can be re-used while the
+	// body moves around inside it
+	CONFIG_DEFINE(planet_collision_margin, .5);
+
+	////////////////////////////////////////////////////////////////////////////////
+	// CollisionBuffers
+
+	constexpr auto max_num_contacts = 10240;
+	
+	// storage used by HandleCollisionWithSolid; kept off the stack and re-used
+	// because collisions with different bodies may be handled concurrently
+	struct CollisionBuffers
+	{
+		CollisionBuffers()
+		: contacts(max_num_contacts)
+		{
+		}
+
+		// terrain is gathered here before being compared with the patch
+		Mesh mesh;
+		std::vector<Vector3> normals;
+		
+		std::vector<ContactGeom> contacts;
+	};
+
+	std::mutex collision_buffers_mutex;
+	std::vector<std::unique_ptr<CollisionBuffers>> free_collision_buffers;
+
+	std::unique_ptr<CollisionBuffers> AcquireCollisionBuffers()
+	{
+		std::lock_guard<std::mutex> lock(collision_buffers_mutex);
+		if (free_collision_buffers.empty())
+		{
+			return std::unique_ptr<CollisionBuffers>(new CollisionBuffers);
+		}
+
+		auto buffers = std::move(free_collision_buffers.back());
+		free_collision_buffers.pop_back();
+		return buffers;
+	}
+
+	void ReleaseCollisionBuffers(std::unique_ptr<CollisionBuffers> buffers)
+	{
+		std::lock_guard<std::mutex> lock(collision_buffers_mutex);
+		free_collision_buffers.push_back(std::move(buffers));
+	}
+	
+	bool operator==(Mesh const & lhs, Mesh const & rhs)
+	{
+		auto & lhs_vertices = lhs.GetVertices();
+		auto & rhs_vertices = rhs.GetVertices();
+		return lhs_vertices.size() == rhs_vertices.size()
+			&& std::equal(std::begin(lhs_vertices), std::end(lhs_vertices), std::begin(rhs_vertices), [] (gfx::PlainVertex const & lhs_vertex, gfx::PlainVertex const & rhs_vertex)
+			{
+				return lhs_vertex.pos == rhs_vertex.pos;
+			});
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// PlanetBody::TerrainPatch
+
+// the surface of the planet in the vicinity of a body; re-used
+// until the body leaves its bounds or the surrounding changes
+struct PlanetBody::TerrainPatch
+{
+	OBJECT_NO_COPY(TerrainPatch);
+
+	TerrainPatch()
+	: bounds(Vector3::Zero(), Scalar(0))
+	, version(0)
+	, has_clear_faces(false)
+	, mesh_data(nullptr)
+	, mesh_collision_handle(nullptr)
+	, is_used(true)
+	{
+	}
+
+	~TerrainPatch()
+	{
+		DestroyGeometry();
+	}
+
+	void DestroyGeometry()
+	{
+		if (mesh_collision_handle)
+		{
+			dGeomDestroy(mesh_collision_handle);
+			mesh_collision_handle = nullptr;
+		}
+
+		if (mesh_data)
+		{
+			dGeomTriMeshDataDestroy(mesh_data);
+			mesh_data = nullptr;
+		}
+	}
+
+	void CreateGeometry()
+	{
+		ASSERT(! mesh_data);
+		ASSERT(! mesh_collision_handle);
+
+		auto & vertices = mesh.GetVertices();
+		auto & indices = mesh.GetIndices();
+		if (indices.empty())
+		{
+			return;
+		}
+
+		mesh_data = dGeomTriMeshDataCreate();
+		dGeomTriMeshDataBuildSingle1(mesh_data,
+			vertices.front().pos.data(), static_cast<int>(sizeof(Mesh::value_type)), static_cast<int>(vertices.size()),
+			indices.data(), static_cast<int>(indices.size()), static_cast<int>(sizeof(Mesh::index_type)),
+			reinterpret_cast<void const *>(normals.data()));
+
+		mesh_collision_handle = dCreateTriMesh(nullptr, mesh_data, nullptr, nullptr, nullptr);
+	}
+
+	// the region from which faces were gathered
+	Sphere3 bounds;
+	
+	// of the surrounding when faces were gathered
+	std::uint32_t version;
+	
+	form::SphereQueryHint hint;
+	
+	Mesh mesh;
+	std::vector<Vector3> normals;	// one per face
+	
+	// true if faces were left out because the bounds were clear of them
+	bool has_clear_faces;
+	
+	MeshData mesh_data;
+	CollisionHandle mesh_collision_handle;
+	
+	// true if used since the last call to PurgeTerrainPatches
+	bool is_used;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // PlanetBody members
 
@@ -61,15 +208,21 @@ CRAG_ROSTER_OBJECT_DEFINE(
 	PlanetBody,
 	10,
 	Pool::CallBase<Body, & Body::PreTick>(Engine::GetPreTickRoster()),
-	Pool::CallBase<Body, & Body::PostTick>(Engine::GetPostTickRoster()))
+	Pool::CallBase<Body, & Body::PostTick>(Engine::GetPostTickRoster()),
+	Pool::Call<& PlanetBody::PurgeTerrainPatches>(Engine::GetPostTickRoster()))
 
-PlanetBody::PlanetBody(Transformation const & transformation, Engine & engine, form::Polyhedron const & polyhedron, Scalar radius)
+PlanetBody::PlanetBody(Transformation const & transformation, Engine & engine, form::Polyhedron const & polyhedron, form::Surrounding const & surrounding, Scalar radius)
 : SphereBody(transformation, nullptr, engine, radius)
 , _polyhedron(polyhedron)
+, _surrounding(surrounding)
 , _mean_radius(radius)
 {
 }
 
+PlanetBody::~PlanetBody()
+{
+}
+
 Vector3 PlanetBody::GetGravitationalAttraction(Vector3 const & pos) const
 {
 	Vector3 const & center = GetTranslation();
@@ -115,89 +268,64 @@ bool PlanetBody::HandleCollisionWithSolid(Body & body, Sphere3 const & bounding_
 	auto planet_collision_handle = GetCollisionHandle();
 	
 	////////////////////////////////////////////////////////////////////////////////
-	// generate mesh representing the planet surface in the vacinity of the body
-
-	// TODO: make thread-safe; this is low-priority because:
-	// a) using single-threaded collision;
-	// b) thread-safety strategy is likely to depend on specifics of parallelization
-	static Mesh mesh;
-	static std::vector<Vector3> normals;
+	// get mesh representing the planet surface in the vacinity of the body
 
-	auto & vertices = mesh.GetVertices();
-	auto & indices = mesh.GetIndices();
-	
-	ASSERT(vertices.empty());
-	ASSERT(indices.empty());
-	ASSERT(normals.empty());
-
-	// only applied if the body is embedded and won't register with ODE collision
-	Scalar max_distance = std::numeric_limits<Scalar>::lowest();
-	Vector3 max_distance_normal;
-	auto face_functor = [&] (form::Triangle3 const & face, form::Vector3 const & normal)
-	{
-		Vector3 centroid = geom::Centroid(face);
-		form::Plane3 plane(centroid, normal);
-		
-		auto distance = Distance(plane, bounding_sphere.center);
-		if (distance > max_distance)
-		{
-			max_distance = distance;
-			max_distance_normal = normal;
-		}
-
-		if (distance > bounding_sphere.radius)
-		{
-			// body is clear of this poly - even if it was an infinite plane
-			return;
-		}
-
-		auto index = static_cast<int>(vertices.size()) + 2;
-		for (auto & point : face.points)
-		{
-			indices.push_back(index --);
-			vertices.push_back(gfx::PlainVertex{ point });
-			normals.push_back(normal);
-		}
-	};
-	
-	form::ForEachFaceInSphere(_polyhedron, bounding_sphere, face_functor);
+	auto buffers = AcquireCollisionBuffers();
+	auto & patch = GetTerrainPatch(body);
+	UpdateTerrainPatch(patch, bounding_sphere, buffers->mesh, buffers->normals);
 	
 	// early-out
-	if (indices.empty())
+	if (! patch.mesh_collision_handle)
 	{
+		ReleaseCollisionBuffers(std::move(buffers));
 		return true;
 	}
-	CRAG_VERIFY_OP(max_distance, >, std::numeric_limits<Scalar>::lowest());
-
-    ////////////////////////////////////////////////////////////////////////////////
-	// create physics geometry based on mesh
-
-	MeshData mesh_data = dGeomTriMeshDataCreate();
-	dGeomTriMeshDataBuildSingle1(mesh_data,
-		vertices.front().pos.data(), static_cast<int>(sizeof(Mesh::value_type)), static_cast<int>(vertices.size()),
-		indices.data(), static_cast<int>(indices.size()), static_cast<int>(sizeof(Mesh::index_type)),
-		reinterpret_cast<void const *>(normals.data()));
 
-	CollisionHandle mesh_collision_handle = dCreateTriMesh(nullptr, mesh_data, nullptr, nullptr, nullptr);
-	
     ////////////////////////////////////////////////////////////////////////////////
 	// collide and generate contacts
 
-	constexpr auto max_num_contacts = 10240;
 	constexpr auto spare_contact = 1;
-	typedef std::array<ContactGeom, max_num_contacts> ContactVector;
-	ContactVector contacts;
+	auto & contacts = buffers->contacts;
 	auto num_contacts = 0;
 	
 	int flags = static_cast<int>(contacts.size()) - spare_contact;
 	ASSERT((flags >> 16) == 0);
 
-	num_contacts = dCollide(body_collision_handle, mesh_collision_handle, flags, contacts.data(), sizeof(ContactVector::value_type));
+	num_contacts = dCollide(body_collision_handle, patch.mesh_collision_handle, flags, contacts.data(), sizeof(ContactGeom));
 
 	ASSERT(num_contacts <= static_cast<int>(contacts.size()));
 	
+	// only applied if the body is embedded and won't register with ODE collision
+	auto get_max_distance = [&] (Vector3 & max_distance_normal)
+	{
+		auto max_distance = std::numeric_limits<Scalar>::lowest();
+		auto & vertices = patch.mesh.GetVertices();
+		for (auto face_index = 0; face_index != static_cast<int>(patch.normals.size()); ++ face_index)
+		{
+			auto vertex = std::begin(vertices) + face_index * 3;
+			Triangle3 face(Vector3(vertex[0].pos), Vector3(vertex[1].pos), Vector3(vertex[2].pos));
+			auto const & normal = patch.normals[face_index];
+			
+			auto distance = Distance(geom::Plane<Scalar, 3>(geom::Centroid(face), normal), bounding_sphere.center);
+			if (distance > max_distance)
+			{
+				max_distance = distance;
+				max_distance_normal = normal;
+			}
+		}
+		
+		CRAG_VERIFY_OP(max_distance, >, std::numeric_limits<Scalar>::lowest());
+		return max_distance;
+	};
+
+	// a body which is clear of any face in the vicinity is not embedded
+	Vector3 max_distance_normal;
+	auto max_distance = (num_contacts == 0 && ! patch.has_clear_faces)
+		? get_max_distance(max_distance_normal)
+		: std::numeric_limits<Scalar>::max();
+
 	// If there's a good chance the body is contained by the polyhedron,
-	if (num_contacts == 0 && max_distance < - bounding_sphere.radius * 2.f)
+	if (max_distance < - bounding_sphere.radius * 2.f)
 	{
 		// add a provisional contact.
 		auto & containment_geom = contacts[num_contacts];
@@ -219,7 +347,7 @@ bool PlanetBody::HandleCollisionWithSolid(Body & body, Sphere3 const & bounding_
 		std::for_each(std::begin(contacts), std::begin(contacts) + num_contacts, [&] (ContactGeom & contact)
 		{
 			ASSERT(contact.g1 == body_collision_handle);
-			ASSERT(contact.g2 == mesh_collision_handle);
+			ASSERT(contact.g2 == patch.mesh_collision_handle);
 			contact.g2 = planet_collision_handle;
 		});
 	}
@@ -232,18 +360,7 @@ bool PlanetBody::HandleCollisionWithSolid(Body & body, Sphere3 const & bounding_
 		contact_function(begin, begin + num_contacts);
 	}
 
-	////////////////////////////////////////////////////////////////////////////////
-	// clean up physics objects
-	
-	dGeomDestroy(mesh_collision_handle);
-	dGeomTriMeshDataDestroy(mesh_data);
-
-	////////////////////////////////////////////////////////////////////////////////
-	// clean up mesh
-	
-	vertices.clear();
-	indices.clear();
-	normals.clear();
+	ReleaseCollisionBuffers(std::move(buffers));
 
 	return true;
 }
@@ -284,6 +401,48 @@ bool PlanetBody::HandleCollisionWithRay(Body & body)
 	return true;
 }
 
+bool PlanetBody::HandleCollisionWithRays(RayCastQuery const * begin, RayCastQuery const * end, form::RayCastResult * results)
+{
+	auto num_queries = static_cast<int>(end - begin);
+	
+	std::vector<form::Ray3> rays;
+	std::vector<form::Scalar> lengths;
+	std::vector<int> indices;
+	rays.reserve(num_queries);
+	lengths.reserve(num_queries);
+	indices.reserve(num_queries);
+	
+	for (auto index = 0; index != num_queries; ++ index)
+	{
+		auto const & query = begin[index];
+		if (query.exception == this)
+		{
+			continue;
+		}
+		
+		// as in HandleCollisionWithRay, testing beyond a previous contact is of no use
+		auto const & previous_result = results[index];
+		auto length = previous_result ? previous_result.GetDistance() : query.length;
+		CRAG_VERIFY_OP(length, <=, query.length);
+		
+		rays.push_back(query.ray);
+		lengths.push_back(length);
+		indices.push_back(index);
+	}
+	
+	auto num_rays = static_cast<int>(rays.size());
+	std::vector<form::RayCastResult> ray_cast_results(num_rays);
+	form::CastRays(_polyhedron, rays.data(), lengths.data(), ray_cast_results.data(), num_rays);
+	
+	for (auto ray_index = 0; ray_index != num_rays; ++ ray_index)
+	{
+		auto & result = results[indices[ray_index]];
+		result = std::min(result, ray_cast_results[ray_index]);
+	}
+	
+	return true;
+}
+
 void PlanetBody::DebugDraw() const
 {
 	using namespace gfx::Debug;
@@ -304,3 +463,105 @@ void PlanetBody::DebugDraw() const
 
 	form::ForEachFaceInSphere(_polyhedron, bounding_sphere, face_functor);
 }
+
+PlanetBody::TerrainPatch & PlanetBody::GetTerrainPatch(Body const & body)
+{
+	std::lock_guard<std::mutex> lock(_terrain_patches_mutex);
+	auto & patch = _terrain_patches[& body];
+	if (! patch)
+	{
+		patch.reset(new TerrainPatch);
+	}
+	
+	patch->is_used = true;
+	return * patch;
+}
+
+// re-gathers the faces of the patch if the body has left it or if the
+// surrounding has changed; only re-builds the geometry if the faces changed
+void PlanetBody::UpdateTerrainPatch(TerrainPatch & patch, Sphere3 const & bounding_sphere, Mesh & mesh, std::vector<Vector3> & normals) const
+{
+	auto version = _surrounding.GetVersion();
+	auto is_contained = patch.bounds.radius > 0 && geom::Contains(patch.bounds, bounding_sphere);
+	if (is_contained && patch.version == version)
+	{
+		return;
+	}
+
+	if (! is_contained)
+	{
+		patch.bounds = Sphere3(bounding_sphere.center, bounding_sphere.radius * Scalar(1. + planet_collision_margin));
+	}
+	patch.version = version;
+	
+	auto & bounds = patch.bounds;
+	auto & vertices = mesh.GetVertices();
+	auto & indices = mesh.GetIndices();
+	auto has_clear_faces = false;
+	
+	ASSERT(vertices.empty());
+	ASSERT(indices.empty());
+	ASSERT(normals.empty());
+
+	auto face_functor = [&] (form::Triangle3 const & face, form::Vector3 const & normal)
+	{
+		Vector3 centroid = geom::Centroid(face);
+		form::Plane3 plane(centroid, normal);
+		
+		auto distance = Distance(plane, bounds.center);
+		if (distance > bounds.radius)
+		{
+			// bounds are clear of this poly - even if it was an infinite plane
+			has_clear_faces = true;
+			return;
+		}
+
+		auto index = static_cast<int>(vertices.size()) + 2;
+		for (auto & point : face.points)
+		{
+			indices.push_back(index --);
+			vertices.push_back(gfx::PlainVertex{ point });
+		}
+		normals.push_back(normal);
+	};
+	
+	form::ForEachFaceInSphere(_polyhedron, bounds, face_functor, patch.hint);
+	patch.has_clear_faces = has_clear_faces;
+
+	if (mesh == patch.mesh && normals == patch.normals)
+	{
+		vertices.clear();
+		indices.clear();
+		normals.clear();
+		return;
+	}
+
+	// swap so that the old faces are cleared away with the buffers
+	patch.mesh.GetVertices().swap(vertices);
+	patch.mesh.GetIndices().swap(indices);
+	patch.normals.swap(normals);
+	
+	vertices.clear();
+	indices.clear();
+	normals.clear();
+	
+	patch.DestroyGeometry();
+	patch.CreateGeometry();
+}
+
+void PlanetBody::PurgeTerrainPatches()
+{
+	for (auto i = std::begin(_terrain_patches); i != std::end(_terrain_patches); )
+	{
+		auto & patch = * i->second;
+		if (patch.is_used)
+		{
+			patch.is_used = false;
+			++ i;
+		}
+		else
+		{
+			i = _terrain_patches.erase(i);
+		}
+	}
+}
@@ -16,6 +16,7 @@
 namespace form
 {
 	class Polyhedron;
+	class Surrounding;
 }
 
 namespace physics
@@ -32,7 +33,8 @@ namespace physics
 	public:
 		CRAG_ROSTER_OBJECT_DECLARE(PlanetBody);
 
-		PlanetBody(Transformation const & transformation, Engine & engine, form::Polyhedron const & polyhedron, Scalar radius);
+		PlanetBody(Transformation const & transformation, Engine & engine, form::Polyhedron const & polyhedron, form::Surrounding const & surrounding, Scalar radius);
+		~PlanetBody();
 		
 		Vector3 GetGravitationalAttraction(Vector3 const & pos) const override;
 	private:
@@ -40,12 +42,39 @@ namespace physics
 
 		bool HandleCollisionWithSolid(Body & body, Sphere3 const & bounding_sphere, ContactFunction & contact_function) override;
 		bool HandleCollisionWithRay(Body & body) override;
+		bool HandleCollisionWithRays(RayCastQuery const * begin, RayCastQuery const * end, form::RayCastResult * results) override;
 
 		void DebugDraw() const override;
 
+		////////////////////////////////////////////////////////////////////////////////
+		// types
+
+		struct TerrainPatch;
+		using TerrainPatchMap = std::unordered_map<Body const *, std::unique_ptr<TerrainPatch>>;
+
+		////////////////////////////////////////////////////////////////////////////////
+		// functions
+
+		// may be called concurrently for different bodies
+		TerrainPatch & GetTerrainPatch(Body const & body);
+		
+		// mesh and normals are used to gather faces; they are returned empty
+		void UpdateTerrainPatch(TerrainPatch & patch, Sphere3 const & bounding_sphere, Mesh & mesh, std::vector<Vector3> & normals) const;
+		
+		// called after each tick; discards the patches of bodies
+		// which didn't collide with the planet during the tick
+		void PurgeTerrainPatches();
+
+		////////////////////////////////////////////////////////////////////////////////
 		// variables
+
 		form::Polyhedron const & _polyhedron;
+		form::Surrounding const & _surrounding;
 		Scalar _mean_radius;
+
+		// surface in the vicinity of each body which collided in the last tick
+		TerrainPatchMap _terrain_patches;
+		std::mutex _terrain_patches_mutex;
 	};
 	
 }
@@ -37,12 +37,13 @@ namespace
 	CONFIG_DEFINE(camera_push_magnitude, 100.f);
 	CONFIG_DEFINE(camera_lod_radius, 2.5f);
 	
-	void UpdateLodParameters(Vector3 const & /*camera_translation*/, Vector3 const & subject_translation)
+	void UpdateLodParameters(Vector3 const & /*camera_translation*/, Vector3 const & subject_translation, Vector3 const & velocity)
 	{
 		// broadcast new camera position
 		gfx::SetLodParametersEvent event;
 		event.parameters.center = subject_translation;
 		event.parameters.min_distance = camera_lod_radius;
+		event.parameters.velocity = velocity;
 		Daemon::Broadcast(event);
 	}
 
@@ -160,7 +161,7 @@ void CameraController::Tick()
 	const auto & space = engine.GetSpace();
 	auto forward = camera_to_subject / distance;
 
-	UpdateLodParameters(camera_translation, subject_translation);
+	UpdateLodParameters(camera_translation, subject_translation, camera_body.GetVelocity());
 	UpdateCamera(camera_transformation, space, forward, up);
 	UpdateBody(camera_body, * _ray_cast, subject_translation, up);
 	UpdateCameraRayCast();
@@ -181,6 +181,7 @@ void MouseObserverController::UpdateCamera() const
 	gfx::SetLodParametersEvent set_lod_parameters_event;
 	set_lod_parameters_event.parameters.center = transformation.GetTranslation();
 	set_lod_parameters_event.parameters.min_distance = frustum_default_depth_near;
+	set_lod_parameters_event.parameters.velocity = body.GetVelocity();
 	Daemon::Broadcast(set_lod_parameters_event);
 }
 
@@ -11,9 +11,8 @@
 
 #include "PlanetShader.h"
 
-#include "sim/Engine.h"
-
 #include "form/Formation.h"
+#include "form/MidPointCache.h"
 #include "form/Node.h"
 #include "form/Point.h"
 #include "form/Polyhedron.h"
@@ -44,28 +43,8 @@ namespace
 		geom::uni::Vector3(-1, -1, -1)
 	};
 	
-	// InitMidPoint helper
-	int MeasureDepth(form::Node const * n, int max_depth)
-	{
-		int depth = 0;
-		
-		for (;;)
-		{
-			n = n->GetParent();
-			if (n == nullptr)
-			{
-				break;
-			}
-			
-			++ depth;
-			if (depth >= max_depth)
-			{
-				break;
-			}
-		}
-		
-		return depth;
-	}
+	// number of mid-points whose positions are calculated together
+	constexpr auto max_num_points_per_pass = 64;
 }
 
 
@@ -116,7 +95,7 @@ namespace debug
 			return;
 		}
 		m.Lock();
-		lines.push_back(Line(node.center, point.pos, row, column));
+		lines.push_back(Line(node.GetCenter(), point.pos, row, column));
 		m.Unlock();
 	}
 	
@@ -144,18 +123,29 @@ namespace debug
 
 
 ////////////////////////////////////////////////////////////////////////////////
-// PlanetShader::Params
+// PlanetShader::Pass
 
-struct PlanetShader::Params
+// mid-points which missed the cache; stored as arrays of scalars
+// so that the arithmetic common to all of them can be vectorized
+struct PlanetShader::Pass
 {
-	Params(Params const &) noexcept = delete;
-	Params & operator=(Params const &) noexcept = delete;
-
-	form::Node const & a;
-	form::Node const & b;
-	int const index;
-	int const depth;	// as a proportion of planet_shader_depth_deep
-	Random rnd;
+	using Scalar = geom::uni::Scalar;
+	using Array = std::array<Scalar, max_num_points_per_pass>;
+
+	// inputs: corners either side of the mid-point, relative to the center
+	Array near_a_x, near_a_y, near_a_z;
+	Array near_b_x, near_b_y, near_b_z;
+
+	// inputs: altitude = (altitude_a + altitude_b) * weight + offset
+	Array weight, offset;
+
+	// outputs
+	Array result_x, result_y, result_z;
+	Array altitude;
+
+	form::MidPointRequest * requests[max_num_points_per_pass];
+	form::MidPointCache::Key keys[max_num_points_per_pass];
+	int size;
 };
 
 
@@ -186,38 +176,38 @@ void PlanetShader::InitRootPoints(form::Polyhedron & polyhedron, form::Point * p
 
 bool PlanetShader::InitMidPoint(form::Polyhedron & polyhedron, form::Node const & a, form::Node const & b, int index, form::Point & mid_point) const
 {
-	CRAG_VERIFY(a);
-	CRAG_VERIFY(b);
-
-	int max_depth = std::numeric_limits<int>::max();
-	int depth = MeasureDepth(& a, max_depth);
-	ASSERT(depth == MeasureDepth(& b, max_depth));
-
-	int seed_1 = Random(Random(a.seed).GetInt() + index).GetInt();
-	int seed_2 = Random(Random(b.seed).GetInt() + index).GetInt();
-	int combined_seed(seed_1 + seed_2);
-	Random rnd(combined_seed);
+	form::MidPointRequest request { & polyhedron, & a, & b, index, & mid_point, false };
+	InitMidPoints(polyhedron, & request, & request + 1);
+	return request.result;
+}
 
-	Params params { a, b, index, depth, Random(combined_seed) };
+void PlanetShader::InitMidPoints(form::Polyhedron & polyhedron, form::MidPointRequest * begin, form::MidPointRequest * end) const
+{
+	Pass pass;
 	
-	geom::uni::Vector3 result;
-	if (depth >= planet_shader_depth_medium)
-	{
-		CalcMidPointPos_SimpleInterp(polyhedron, result, params);
-	}
-	else 
+	while (begin != end)
 	{
-		CalcMidPointPos_Random(polyhedron, result, params);
+		auto pass_end = begin + std::min(end - begin, std::ptrdiff_t(max_num_points_per_pass));
+		
+		BeginPass(polyhedron, begin, pass_end, pass);
+		CalcMidPointPositions(polyhedron, pass);
+		EndPass(polyhedron, pass);
+		
+		begin = pass_end;
 	}
-	
-	mid_point.pos = static_cast<form::Point::Vector3>(result);
-//	mid_point.col = gfx::Color4b::White();
-
-	debug::MarkNodePoint(a, mid_point, 0, 0);
-	debug::MarkNodePoint(b, mid_point, 3, 3);
-	debug::ClampNodePoints();
+}
 
-	return true;
+std::uint64_t PlanetShader::GetMidPointCacheSignature(form::Formation const & formation) const
+{
+	using form::MidPointCache;
+	
+	auto signature = MidPointCache::initial_signature;
+	signature = MidPointCache::CombineSignature(signature, formation.GetShape().radius);
+	signature = MidPointCache::CombineSignature(signature, static_cast<int>(planet_shader_depth_medium));
+	signature = MidPointCache::CombineSignature(signature, static_cast<double>(planet_shader_random_range));
+	signature = MidPointCache::CombineSignature(signature, static_cast<double>(planet_shader_medium_coefficient));
+	
+	return signature;
 }
 
 // Comes in normalized. Is then given the correct length.
@@ -229,63 +219,163 @@ void PlanetShader::CalcRootPointPos(Random & rnd, geom::uni::Vector3 & position)
 
 geom::uni::Scalar PlanetShader::GetRandomHeightCoefficient(Random & rnd) const
 {
-	geom::uni::Scalar random_exponent = (.5 - rnd.GetFloatInclusive<geom::uni::Scalar>()) * planet_shader_random_range;
+	return GetRandomHeightCoefficient(rnd.GetFloatInclusive<geom::uni::Scalar>());
+}
+
+geom::uni::Scalar PlanetShader::GetRandomHeightCoefficient(geom::uni::Scalar rnd_value) const
+{
+	geom::uni::Scalar random_exponent = (.5 - rnd_value) * planet_shader_random_range;
 	geom::uni::Scalar coefficient = std::exp(random_exponent);
 	return coefficient;
 }
 
-// At shallow depth, heigh is highly random.
-bool PlanetShader::CalcMidPointPos_Random(form::Polyhedron & polyhedron, geom::uni::Vector3 & result, Params & params) const
+// fulfills requests from the cache and gathers the inputs of the remainder
+void PlanetShader::BeginPass(form::Polyhedron & polyhedron, form::MidPointRequest * begin, form::MidPointRequest * end, Pass & pass) const
 {
-	auto const & shape = static_cast<geom::uni::Sphere3>(polyhedron.GetShape());
+	using Scalar = geom::uni::Scalar;
+	
+	auto & formation = polyhedron.GetFormation();
+	auto mid_point_cache = formation.GetMidPointCache();
+	auto const & shape = polyhedron.GetShape();
 	
-	geom::uni::Scalar radius = shape.radius * GetRandomHeightCoefficient(params.rnd);
-	polyhedron.GetFormation().SampleRadius(radius);
-
-	geom::uni::Vector3 near_a = GetLocalPosition(params.a.GetCorner(TriMod(params.index + 1))->pos, shape.center);
-	geom::uni::Vector3 near_b = GetLocalPosition(params.b.GetCorner(TriMod(params.index + 1))->pos, shape.center);
-	result = near_a + near_b;
-	geom::uni::Scalar length = Magnitude(result);
-	result *= (radius / length);
-	result += shape.center;
+	// the variance of deep mid-points depends only on depth
+	auto variance_depth = -1;
+	auto variance_coefficient = Scalar(0);
 	
-	return true;
+	pass.size = 0;
+	for (auto request = begin; request != end; ++ request)
+	{
+		auto const & a = * request->a;
+		auto const & b = * request->b;
+		auto index = request->index;
+		CRAG_VERIFY(a);
+		CRAG_VERIFY(b);
+		ASSERT(a.depth == b.depth);
+		
+		request->result = true;
+		
+		auto near_a = GetLocalPosition(a.GetCorner(TriMod(index + 1))->pos, shape.center);
+		auto near_b = GetLocalPosition(b.GetCorner(TriMod(index + 1))->pos, shape.center);
+		
+		int seed_1 = a.GetChildSeed(index);
+		int seed_2 = b.GetChildSeed(index);
+		auto mid_point_key = form::MidPointCache::MakeKey(near_a, near_b, a.depth, seed_1, seed_2);
+		
+		geom::uni::Vector3 cached_position;
+		if (mid_point_cache && mid_point_cache->Find(mid_point_key, cached_position))
+		{
+			// cached positions are relative to the formation
+			formation.SampleRadius(Magnitude(cached_position));
+			request->mid_point->pos = static_cast<form::Point::Vector3>(cached_position + shape.center);
+			MarkMidPoint(* request);
+			continue;
+		}
+		
+		auto i = pass.size ++;
+		pass.requests[i] = request;
+		pass.keys[i] = mid_point_key;
+		
+		pass.near_a_x[i] = near_a.x;
+		pass.near_a_y[i] = near_a.y;
+		pass.near_a_z[i] = near_a.z;
+		pass.near_b_x[i] = near_b.x;
+		pass.near_b_y[i] = near_b.y;
+		pass.near_b_z[i] = near_b.z;
+		
+		Random rnd(seed_1 + seed_2);
+		auto rnd_value = rnd.GetFloatInclusive<Scalar>();
+		
+		if (a.depth < planet_shader_depth_medium)
+		{
+			// At shallow depth, height is highly random.
+			pass.weight[i] = 0;
+			pass.offset[i] = shape.radius * GetRandomHeightCoefficient(rnd_value);
+			continue;
+		}
+		
+		// Deeper, height is interpolated and varied less with depth.
+		if (a.depth != variance_depth)
+		{
+			variance_depth = a.depth;
+			variance_coefficient = GetAltitudeVarianceCoefficient(variance_depth, shape.radius);
+		}
+		
+		Scalar rnd_x = rnd_value * 2. - 1.;
+		rnd_x *= Squared(rnd_x);
+		
+		pass.weight[i] = .5;
+		pass.offset[i] = rnd_x * variance_coefficient;
+	}
 }
 
-bool PlanetShader::CalcMidPointPos_SimpleInterp(form::Polyhedron & polyhedron, geom::uni::Vector3 & result, Params & params) const
+// the arithmetic shared by all mid-points; free of branches
+void PlanetShader::CalcMidPointPositions(form::Polyhedron & polyhedron, Pass & pass) const
 {
-	auto const & shape = static_cast<geom::uni::Sphere3>(polyhedron.GetShape());
-	
-	geom::uni::Vector3 near_a = GetLocalPosition(params.a.GetCorner(TriMod(params.index + 1))->pos, shape.center);
-	geom::uni::Vector3 near_b = GetLocalPosition(params.b.GetCorner(TriMod(params.index + 1))->pos, shape.center);
-	result = near_a + near_b;
-	geom::uni::Scalar result_length = Magnitude(result);
+	auto const & center = polyhedron.GetShape().center;
+	auto size = pass.size;
 	
-	geom::uni::Scalar near_a_altitude = GetAltitude(near_a);
-	geom::uni::Scalar near_b_altitude = GetAltitude(near_b);
-	geom::uni::Scalar altitude = (near_a_altitude + near_b_altitude) * .5;
+	for (auto i = 0; i < size; ++ i)
+	{
+		auto near_a_altitude = std::sqrt(Squared(pass.near_a_x[i]) + Squared(pass.near_a_y[i]) + Squared(pass.near_a_z[i]));
+		auto near_b_altitude = std::sqrt(Squared(pass.near_b_x[i]) + Squared(pass.near_b_y[i]) + Squared(pass.near_b_z[i]));
+		auto altitude = (near_a_altitude + near_b_altitude) * pass.weight[i] + pass.offset[i];
+		
+		auto x = pass.near_a_x[i] + pass.near_b_x[i];
+		auto y = pass.near_a_y[i] + pass.near_b_y[i];
+		auto z = pass.near_a_z[i] + pass.near_b_z[i];
+		auto scale = altitude / std::sqrt(Squared(x) + Squared(y) + Squared(z));
+		
+		pass.result_x[i] = x * scale + center.x;
+		pass.result_y[i] = y * scale + center.y;
+		pass.result_z[i] = z * scale + center.z;
+		pass.altitude[i] = altitude;
+	}
+}
 
-	geom::uni::Scalar rnd_x = params.rnd.GetFloatInclusive<geom::uni::Scalar>() * 2. - 1.;
-	rnd_x *= Squared(rnd_x);
+// stores the results of CalcMidPointPositions
+void PlanetShader::EndPass(form::Polyhedron & polyhedron, Pass const & pass) const
+{
+	auto & formation = polyhedron.GetFormation();
+	auto mid_point_cache = formation.GetMidPointCache();
+	auto const & center = polyhedron.GetShape().center;
 	
-	// Figure out how much the altitude may be varied in either direction,
-	// and clip that variance based on the hard limits of the planet.
-	// Actually, clip it to half of that to make it look less like a hard limit.
-	// And do the clipping based on how far the variance /might/ go.
-	geom::uni::Scalar altitude_variance_coefficient = planet_shader_medium_coefficient / geom::uni::Scalar(1 << params.depth);
+	for (auto i = 0; i < pass.size; ++ i)
+	{
+		geom::uni::Vector3 result(pass.result_x[i], pass.result_y[i], pass.result_z[i]);
+		formation.SampleRadius(pass.altitude[i]);
+		
+		if (mid_point_cache)
+		{
+			mid_point_cache->Insert(pass.keys[i], result - center);
+		}
+		
+		auto & request = * pass.requests[i];
+		request.mid_point->pos = static_cast<form::Point::Vector3>(result);
+		MarkMidPoint(request);
+	}
+}
+
+void PlanetShader::MarkMidPoint(form::MidPointRequest const & request) const
+{
+	debug::MarkNodePoint(* request.a, * request.mid_point, 0, 0);
+	debug::MarkNodePoint(* request.b, * request.mid_point, 3, 3);
+	debug::ClampNodePoints();
+}
+
+// Figure out how much the altitude may be varied in either direction,
+// and clip that variance based on the hard limits of the planet.
+// Actually, clip it to half of that to make it look less like a hard limit.
+// And do the clipping based on how far the variance /might/ go.
+geom::uni::Scalar PlanetShader::GetAltitudeVarianceCoefficient(int depth, geom::uni::Scalar radius) const
+{
+	geom::uni::Scalar altitude_variance_coefficient = std::ldexp(geom::uni::Scalar(planet_shader_medium_coefficient), - depth);
 	
-	geom::uni::Scalar lod_variation_cycler = sin(0.1 * std::max(0, params.depth - planet_shader_depth_medium));
+	geom::uni::Scalar lod_variation_cycler = sin(0.1 * std::max(0, depth - planet_shader_depth_medium));
 	altitude_variance_coefficient *= lod_variation_cycler;
 	
-	altitude_variance_coefficient *= shape.radius;
-	
-	altitude += rnd_x * altitude_variance_coefficient;
-	polyhedron.GetFormation().SampleRadius(altitude);
-	
-	result *= (altitude / result_length);
-	result += shape.center;
+	altitude_variance_coefficient *= radius;
 	
-	return true;
+	return altitude_variance_coefficient;
 }
 
 geom::uni::Vector3 PlanetShader::GetLocalPosition(form::Point const & point, geom::uni::Vector3 const & center) const
@@ -27,14 +27,20 @@ namespace sim
 	private:
 		void InitRootPoints(form::Polyhedron & polyhedron, form::Point * points[]) const override;
 		bool InitMidPoint(form::Polyhedron & polyhedron, form::Node const & a, form::Node const & b, int index, form::Point & mid_point) const override;
+		void InitMidPoints(form::Polyhedron & polyhedron, form::MidPointRequest * begin, form::MidPointRequest * end) const override;
+		std::uint64_t GetMidPointCacheSignature(form::Formation const & formation) const override;
 		
 		void CalcRootPointPos(Random & rnd, geom::uni::Vector3 & position) const;
 		geom::uni::Scalar GetRandomHeightCoefficient(Random & rnd) const;
+		geom::uni::Scalar GetRandomHeightCoefficient(geom::uni::Scalar rnd_value) const;
+		geom::uni::Scalar GetAltitudeVarianceCoefficient(int depth, geom::uni::Scalar radius) const;
 
-		// Mid-Point Calculation 
-		struct Params;
-		bool CalcMidPointPos_Random(form::Polyhedron & polyhedron, geom::uni::Vector3 & result, Params & params) const;
-		bool CalcMidPointPos_SimpleInterp(form::Polyhedron & polyhedron, geom::uni::Vector3 & result, Params & params) const;
+		// Mid-Point Calculation; performed in passes of several points
+		struct Pass;
+		void BeginPass(form::Polyhedron & polyhedron, form::MidPointRequest * begin, form::MidPointRequest * end, Pass & pass) const;
+		void CalcMidPointPositions(form::Polyhedron & polyhedron, Pass & pass) const;
+		void EndPass(form::Polyhedron & polyhedron, Pass const & pass) const;
+		void MarkMidPoint(form::MidPointRequest const & request) const;
 
 		geom::uni::Vector3 GetLocalPosition(form::Point const & point, geom::uni::Vector3 const & center) const;
 		geom::uni::Vector3 GetLocalPosition(form::Vector3 const & point_pos, geom::uni::Vector3 const & center) const;
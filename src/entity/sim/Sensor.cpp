@@ -14,6 +14,7 @@
 #include "sim/Engine.h"
 #include "sim/Entity.h"
 
+#include "physics/Body.h"
 #include "physics/Engine.h"
 
 #include <geom/utils.h>
@@ -21,6 +22,8 @@
 #include "core/Random.h"
 #include "core/RosterObjectDefine.h"
 
+#include "gfx/Debug.h"
+
 using namespace sim;
 
 namespace
@@ -56,23 +59,21 @@ CRAG_ROSTER_OBJECT_DEFINE(
 
 Sensor::Sensor(Entity & entity, Ray3 const & ray, Scalar length, Scalar variance)
 : _entity(entity)
+, _body(core::StaticCast<physics::Body>(* entity.GetLocation()))
 , _length(length)
 , _variance(variance)
-, _ray_cast(new physics::RayCast(entity.GetEngine().GetPhysicsEngine(), length))
 , _local_ray(ray)
+, _scan_ray(GetGlobalRay())
+, _scan_index(-1)
 {
-	GenerateScanRay();
-	
-	auto & location = * entity.GetLocation();
-	auto & body = core::StaticCast<physics::Body>(location);
-	_ray_cast->SetIsCollidable(body, false);
 }
 
 CRAG_VERIFY_INVARIANTS_DEFINE_BEGIN(Sensor, self)
 	CRAG_ROSTER_OBJECT_VERIFY(self);
 	CRAG_VERIFY(self._local_ray.position);
 	CRAG_VERIFY_UNIT(self._local_ray.direction, .0001f);
-	CRAG_VERIFY_EQUAL(self._ray_cast->GetLength(), self._length);
+	CRAG_VERIFY_OP(self._length, >=, 0);
+	CRAG_VERIFY(self._result);
 CRAG_VERIFY_INVARIANTS_DEFINE_END
 
 // update global sensor ray position
@@ -92,24 +93,45 @@ void Sensor::GenerateScanRay() noexcept
 	scan_ray.direction /= scan_length;
 	
 	// generate new ray
-	_ray_cast->SetRay(scan_ray);
+	_scan_ray = scan_ray;
+	
+	// and submit it to be cast with the rays of other sensors
+	auto & physics_engine = _entity.GetEngine().GetPhysicsEngine();
+	_scan_index = physics_engine.SubmitRayCast(physics::RayCastQuery { scan_ray, _length, & _body });
 }
 
 void Sensor::SendReading() noexcept
 {
+	// a sensor created since the rays were submitted reads nothing
+	auto & physics_engine = _entity.GetEngine().GetPhysicsEngine();
+	_result = physics_engine.GetRayCastResult(_scan_index);
+	_scan_index = -1;
+	
 	TransmitSignal(CalcReading());
 }
 
 #if defined(CRAG_DEBUG)
 void Sensor::DebugDraw() noexcept
 {
-	_ray_cast->DebugDraw();
+	// draw previous ray result
+	auto start = _scan_ray.position;
+	auto end = geom::Project(_scan_ray, _length);
+	if (_result)
+	{
+		auto penetration_position = geom::Project(_scan_ray, _result.GetDistance());
+		gfx::Debug::AddLine(start, penetration_position, gfx::Debug::Color::Yellow());
+		gfx::Debug::AddLine(penetration_position, end, gfx::Debug::Color::Red());
+	}
+	else
+	{
+		gfx::Debug::AddLine(start, end, gfx::Debug::Color::Green());
+	}
 }
 #endif
 
 Scalar Sensor::CalcReading() const
 {
-	const auto & result = _ray_cast->GetResult();
+	const auto & result = _result;
 	if (! result)
 	{
 		return 0.f;
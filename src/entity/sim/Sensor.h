@@ -13,7 +13,9 @@
 
 #include "sim/defs.h"
 
-#include "physics/RayCast.h"
+#include "form/RayCastResult.h"
+
+#include "core/RosterObjectDeclare.h"
 
 namespace crag
 {
@@ -23,6 +25,11 @@ namespace crag
 	}
 }
 
+namespace physics
+{
+	class Body;
+}
+
 namespace sim
 {
 	class Entity;
@@ -56,10 +63,16 @@ namespace sim
 		// variables
 
 		Entity & _entity;
+		physics::Body const & _body;
 		Scalar _length;
 		Scalar _variance;
-		std::unique_ptr<physics::RayCast> const _ray_cast;
 		Ray3 const _local_ray;    // Project(_ray, 1) = average sensor tip
+		
+		// the ray most recently submitted for casting and its index
+		// among the physics engine's rays for the current tick, or -1
+		Ray3 _scan_ray;
+		int _scan_index;
+		form::RayCastResult _result;
 		std::vector<float> _thruster_mapping;
 	};
 }
@@ -684,6 +684,9 @@ void TouchObserverController::BroadcastTransformation() const
 	gfx::SetLodParametersEvent set_lod_parameters_event;
 	set_lod_parameters_event.parameters.center = _current_transformation.GetTranslation();
 	set_lod_parameters_event.parameters.min_distance = _frustum.depth_range[0];
+	
+	// the camera is placed directly by touch input rather than driven by physics
+	set_lod_parameters_event.parameters.velocity = Vector3::Zero();
 	Daemon::Broadcast(set_lod_parameters_event);
 }
 
@@ -15,6 +15,9 @@
 
 #include "core/ConfigEntry.h"
 
+#if defined(CRAG_CPU_X86)
+#include <xmmintrin.h>
+#endif
 
 using namespace form;
 
@@ -23,11 +26,79 @@ CONFIG_DEFINE(node_score_score_coefficient, 1.5);
 
 namespace
 {
+	// If false, bulk scoring uses the scalar path even where SIMD is available.
+	CONFIG_DEFINE(node_score_simd, true);
+	
+	// If true, nodes are scored against the position which the LOD center is
+	// expected to reach so that detail is added ahead of a moving observer.
+	CONFIG_DEFINE(node_score_prediction, false);
+	
+	// how far ahead the LOD center is extrapolated, in seconds
+	CONFIG_DEFINE(node_score_prediction_period, .5f);
+	
+	// limits extrapolation relative to the distance to the nearest leaf node
+	// so that the surface beneath a low observer does not lose detail
+	CONFIG_DEFINE(node_score_prediction_max_ratio, .5f);
+	
 	gfx::LodParameters invalid_lod_parameters = 
 	{
 		Vector3::Max(),
-		-1.f
+		-1.f,
+		Vector3::Zero()
 	};
+
+#if defined(CRAG_CPU_X86)
+	// approximates e^x for x in [-1, 1], i.e. the range of a dot product of unit vectors;
+	// relative error < .001
+	__m128 Exp4(__m128 x)
+	{
+		auto result = _mm_set1_ps(1.f / 720.f);
+		result = _mm_add_ps(_mm_mul_ps(result, x), _mm_set1_ps(1.f / 120.f));
+		result = _mm_add_ps(_mm_mul_ps(result, x), _mm_set1_ps(1.f / 24.f));
+		result = _mm_add_ps(_mm_mul_ps(result, x), _mm_set1_ps(1.f / 6.f));
+		result = _mm_add_ps(_mm_mul_ps(result, x), _mm_set1_ps(1.f / 2.f));
+		result = _mm_add_ps(_mm_mul_ps(result, x), _mm_set1_ps(1.f));
+		result = _mm_add_ps(_mm_mul_ps(result, x), _mm_set1_ps(1.f));
+		return result;
+	}
+	
+	// returns lhs where mask is set, otherwise rhs
+	__m128 Select4(__m128 mask, __m128 lhs, __m128 rhs)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, lhs), _mm_andnot_ps(mask, rhs));
+	}
+	
+	float HorizontalMin4(__m128 v)
+	{
+		float elements[4];
+		_mm_storeu_ps(elements, v);
+		return std::min(std::min(elements[0], elements[1]), std::min(elements[2], elements[3]));
+	}
+	
+	float HorizontalMax4(__m128 v)
+	{
+		float elements[4];
+		_mm_storeu_ps(elements, v);
+		return std::max(std::max(elements[0], elements[1]), std::max(elements[2], elements[3]));
+	}
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// CalculateNodeScoreFunctor::Counters definitions
+
+void CalculateNodeScoreFunctor::Counters::Reset()
+{
+	min_leaf_distance_squared = std::numeric_limits<Scalar>::max();
+	leaf_score_range[0] = std::numeric_limits<float>::max();
+	leaf_score_range[1] = std::numeric_limits<float>::min();
+}
+
+void CalculateNodeScoreFunctor::Counters::Merge(Counters const & rhs)
+{
+	min_leaf_distance_squared = std::min(min_leaf_distance_squared, rhs.min_leaf_distance_squared);
+	leaf_score_range[0] = std::min(leaf_score_range[0], rhs.leaf_score_range[0]);
+	leaf_score_range[1] = std::max(leaf_score_range[1], rhs.leaf_score_range[1]);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -35,6 +106,8 @@ namespace
 
 CalculateNodeScoreFunctor::CalculateNodeScoreFunctor()
 {
+	_counters.Reset();
+	
 	// make sure that the initial position is just plain wrong!
 	SetLodParameters(GetInvalidLodParameters());
 }
@@ -44,50 +117,129 @@ gfx::LodParameters const & CalculateNodeScoreFunctor::GetInvalidLodParameters()
 	return invalid_lod_parameters;
 }
 
-bool CalculateNodeScoreFunctor::IsSignificantlyDifferent(Vector3 const & other_lod_center) const
+bool CalculateNodeScoreFunctor::IsSignificantlyDifferent(gfx::LodParameters const & other_lod_parameters, gfx::LodParametersVector const & other_secondary_lod_parameters) const
 {
-	Scalar distance_squared = DistanceSq(other_lod_center, _lod_parameters.center);
-	return distance_squared >= min_recalc_distance_squared;
+	ASSERT(! _observers.empty());
+	
+	Scalar other_score_offset;
+	auto other_score_center = GetScoreCenter(other_lod_parameters, other_score_offset);
+	Scalar distance_squared = DistanceSq(other_score_center, _observers.front().center);
+	if (distance_squared >= min_recalc_distance_squared)
+	{
+		return true;
+	}
+	
+	if (other_secondary_lod_parameters.size() != _secondary_lod_parameters.size())
+	{
+		return true;
+	}
+	
+	return ! std::equal(
+		std::begin(other_secondary_lod_parameters), std::end(other_secondary_lod_parameters),
+		std::begin(_secondary_lod_parameters),
+		[] (gfx::LodParameters const & other, gfx::LodParameters const & lod_parameters)
+		{
+			return other.min_distance == lod_parameters.min_distance
+				&& DistanceSq(other.center, lod_parameters.center) < Squared(node_score_recalc_coefficient * lod_parameters.min_distance);
+		});
 }
 
 void CalculateNodeScoreFunctor::ResetCounters()
 {
-	min_leaf_distance_squared = std::numeric_limits<Scalar>::max();
-	leaf_score_range[0] = std::numeric_limits<float>::max();
-	leaf_score_range[1] = std::numeric_limits<float>::min();
+	_counters.Reset();
 }
 
 geom::Vector2f CalculateNodeScoreFunctor::GetLeafScoreRange() const
 {
-	return leaf_score_range;
+	return _counters.leaf_score_range;
 }
 
 Scalar CalculateNodeScoreFunctor::GetMinLeafDistanceSquared() const
 {
-	return min_leaf_distance_squared;
+	auto min_leaf_distance_squared = _counters.min_leaf_distance_squared;
+	if (_score_offset == 0 || min_leaf_distance_squared == std::numeric_limits<Scalar>::max())
+	{
+		return min_leaf_distance_squared;
+	}
+	
+	// distances were measured from the score center;
+	// the nearest leaf may be closer to the LOD center by as much as the offset
+	auto min_leaf_distance = std::max(std::sqrt(min_leaf_distance_squared) - _score_offset, Scalar(0));
+	return Squared(min_leaf_distance);
 }
 
-void CalculateNodeScoreFunctor::SetLodParameters(gfx::LodParameters const & lod_parameters)
+void CalculateNodeScoreFunctor::SetLodParameters(gfx::LodParameters const & lod_parameters, gfx::LodParametersVector const & secondary_lod_parameters)
 {
 	CRAG_VERIFY(lod_parameters);
 
 	_lod_parameters = lod_parameters;
+	_secondary_lod_parameters = secondary_lod_parameters;
+	
+	// only the primary LOD center is extrapolated
+	auto score_center = GetScoreCenter(lod_parameters, _score_offset);
 
 	min_recalc_distance_squared = Scalar(Squared(node_score_recalc_coefficient * lod_parameters.min_distance));
-	double min_score_distance_squared_precise = Squared(node_score_score_coefficient * lod_parameters.min_distance);
-	min_score_distance_squared = Scalar(min_score_distance_squared_precise);
-	inverse_min_score_distance_squared = Scalar(1. / min_score_distance_squared_precise);
+	
+	_observers.clear();
+	_observers.push_back(MakeObserver(score_center, lod_parameters.min_distance));
+	for (auto const & secondary : secondary_lod_parameters)
+	{
+		CRAG_VERIFY(secondary);
+		_observers.push_back(MakeObserver(secondary.center, secondary.min_distance));
+	}
 }
 
-void CalculateNodeScoreFunctor::operator()(Node & node)
+Vector3 CalculateNodeScoreFunctor::GetScoreCenter(gfx::LodParameters const & lod_parameters, Scalar & score_offset) const
 {
-	ASSERT(node.IsInUse());
+	score_offset = 0;
+	if (! node_score_prediction || lod_parameters.velocity == Vector3::Zero())
+	{
+		return lod_parameters.center;
+	}
+	
+	auto offset = lod_parameters.velocity * node_score_prediction_period;
+	auto offset_magnitude = Magnitude(offset);
 	
-	float score = node.area;
+	// uses the leaf distance of the previous pass, measured from its score center
+	auto max_offset_magnitude = std::sqrt(_counters.min_leaf_distance_squared) * node_score_prediction_max_ratio;
+	if (offset_magnitude > max_offset_magnitude)
+	{
+		offset *= max_offset_magnitude / offset_magnitude;
+		offset_magnitude = max_offset_magnitude;
+	}
+	
+	score_offset = offset_magnitude;
+	return lod_parameters.center + offset;
+}
+
+void CalculateNodeScoreFunctor::MergeCounters(Counters const & counters)
+{
+	_counters.Merge(counters);
+}
+
+void CalculateNodeScoreFunctor::operator()(Node & node)
+{
+	operator()(node, _counters);
+}
+
+CalculateNodeScoreFunctor::Observer CalculateNodeScoreFunctor::MakeObserver(Vector3 const & center, Scalar min_distance)
+{
+	double min_score_distance_squared_precise = Squared(node_score_score_coefficient * min_distance);
+	return Observer
+	{
+		center,
+		Scalar(min_score_distance_squared_precise),
+		Scalar(1. / min_score_distance_squared_precise)
+	};
+}
+
+float CalculateNodeScoreFunctor::Score(Observer const & observer, geom::Vector3f const & center, geom::Vector3f const & normal, float area, float & distance_squared)
+{
+	float score = area;
 	
 	// distance	
-	geom::Vector3f node_to_lod_center = _lod_parameters.center - node.center;
-	float distance_squared = MagnitudeSq(node_to_lod_center);
+	geom::Vector3f node_to_lod_center = observer.center - center;
+	distance_squared = MagnitudeSq(node_to_lod_center);
 	ASSERT(distance_squared < std::numeric_limits<float>::max());
 	if (distance_squared > 0) 
 	{
@@ -101,25 +253,49 @@ void CalculateNodeScoreFunctor::operator()(Node & node)
 	
 	// towardness: -1=facing away, 1=facing towards
 	// purpose: favour polys which are facing towards the LOD center
-	float lod_center_dp = DotProduct(node_to_lod_center, node.normal);
+	float lod_center_dp = DotProduct(node_to_lod_center, normal);
 	float towardness_factor = std::exp(lod_center_dp);
 	score *= towardness_factor;
 	
 	// Distance-based falloff.
-	if (distance_squared > min_score_distance_squared)
+	if (distance_squared > observer.min_score_distance_squared)
 	{
 		score /= distance_squared;
 	}
 	else 
 	{
-		score *= inverse_min_score_distance_squared;
+		score *= observer.inverse_min_score_distance_squared;
 	}
 	
 	ASSERT(score >= 0);
-	node.score = score;
+	return score;
+}
+
+float CalculateNodeScoreFunctor::Score(geom::Vector3f const & center, geom::Vector3f const & normal, float area, float & distance_squared) const
+{
+	ASSERT(! _observers.empty());
+	
+	auto score = Score(_observers.front(), center, normal, area, distance_squared);
+	std::for_each(std::begin(_observers) + 1, std::end(_observers), [&] (Observer const & observer)
+	{
+		float observer_distance_squared;
+		score = std::max(score, Score(observer, center, normal, area, observer_distance_squared));
+	});
+	
+	return score;
+}
+
+void CalculateNodeScoreFunctor::operator()(Node & node, Counters & counters) const
+{
+	ASSERT(node.IsInUse());
+	
+	float distance_squared;
+	float score = Score(node.GetCenter(), node.GetNormal(), node.GetArea(), distance_squared);
+	node.SetScore(score);
 	
 	if (node.IsLeaf())
 	{
+		auto & leaf_score_range = counters.leaf_score_range;
 		if (score < leaf_score_range.x)
 		{
 			leaf_score_range.x = score;
@@ -129,9 +305,120 @@ void CalculateNodeScoreFunctor::operator()(Node & node)
 			leaf_score_range.y = score;
 		}
 		
-		if (distance_squared < min_leaf_distance_squared)
+		if (distance_squared < counters.min_leaf_distance_squared)
+		{
+			counters.min_leaf_distance_squared = distance_squared;
+		}
+	}
+}
+
+void CalculateNodeScoreFunctor::operator()(NodeBuffer::ScoreData const & score_data, int begin_index, int end_index, Counters & counters) const
+{
+	ASSERT(begin_index <= end_index);
+	
+#if defined(CRAG_CPU_X86)
+	if (node_score_simd)
+	{
+		ScoreSse(score_data, begin_index, end_index, counters);
+		return;
+	}
+#endif
+
+	ScoreScalar(score_data, begin_index, end_index, counters);
+}
+
+// equivalent of operator()(Node &, Counters &) which reads from score data
+void CalculateNodeScoreFunctor::ScoreScalar(NodeBuffer::ScoreData const & score_data, int begin_index, int end_index, Counters & counters) const
+{
+	for (auto index = begin_index; index != end_index; ++ index)
+	{
+		geom::Vector3f center(score_data.center[0][index], score_data.center[1][index], score_data.center[2][index]);
+		geom::Vector3f normal(score_data.normal[0][index], score_data.normal[1][index], score_data.normal[2][index]);
+		
+		float distance_squared;
+		float score = Score(center, normal, score_data.area[index], distance_squared);
+		score_data.score[index] = score;
+		
+		if (score_data.leaf[index] != 0)
 		{
-			min_leaf_distance_squared = distance_squared;
+			auto & leaf_score_range = counters.leaf_score_range;
+			leaf_score_range.x = std::min(leaf_score_range.x, score);
+			leaf_score_range.y = std::max(leaf_score_range.y, score);
+			counters.min_leaf_distance_squared = std::min(counters.min_leaf_distance_squared, distance_squared);
 		}
 	}
 }
+
+#if defined(CRAG_CPU_X86)
+// four nodes at a time; the tail is handed to the scalar path
+void CalculateNodeScoreFunctor::ScoreSse(NodeBuffer::ScoreData const & score_data, int begin_index, int end_index, Counters & counters) const
+{
+	auto const zero = _mm_setzero_ps();
+	auto const one = _mm_set1_ps(1.f);
+	auto const float_max = _mm_set1_ps(std::numeric_limits<float>::max());
+	auto const float_lowest = _mm_set1_ps(std::numeric_limits<float>::lowest());
+	
+	auto leaf_score_min = float_max;
+	auto leaf_score_max = float_lowest;
+	auto leaf_distance_squared_min = float_max;
+	
+	auto index = begin_index;
+	for (auto simd_end_index = end_index - 3; index < simd_end_index; index += 4)
+	{
+		auto center_x = _mm_loadu_ps(score_data.center[0] + index);
+		auto center_y = _mm_loadu_ps(score_data.center[1] + index);
+		auto center_z = _mm_loadu_ps(score_data.center[2] + index);
+		auto normal_x = _mm_loadu_ps(score_data.normal[0] + index);
+		auto normal_y = _mm_loadu_ps(score_data.normal[1] + index);
+		auto normal_z = _mm_loadu_ps(score_data.normal[2] + index);
+		auto area = _mm_loadu_ps(score_data.area + index);
+		
+		auto score = zero;
+		auto primary_distance_squared = zero;
+		for (auto const & observer : _observers)
+		{
+			auto to_lod_center_x = _mm_sub_ps(_mm_set1_ps(observer.center.x), center_x);
+			auto to_lod_center_y = _mm_sub_ps(_mm_set1_ps(observer.center.y), center_y);
+			auto to_lod_center_z = _mm_sub_ps(_mm_set1_ps(observer.center.z), center_z);
+			
+			auto distance_squared = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(to_lod_center_x, to_lod_center_x),
+				_mm_mul_ps(to_lod_center_y, to_lod_center_y)),
+				_mm_mul_ps(to_lod_center_z, to_lod_center_z));
+			
+			// towardness; where the node is at the lod center, the direction is taken to be +x
+			auto dot_product = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(to_lod_center_x, normal_x),
+				_mm_mul_ps(to_lod_center_y, normal_y)),
+				_mm_mul_ps(to_lod_center_z, normal_z));
+			auto lod_center_dp = Select4(
+				_mm_cmpgt_ps(distance_squared, zero),
+				_mm_mul_ps(dot_product, _mm_rsqrt_ps(distance_squared)),
+				normal_x);
+			
+			// distance-based falloff
+			auto observer_score = _mm_mul_ps(area, Exp4(lod_center_dp));
+			observer_score = _mm_div_ps(observer_score, _mm_max_ps(distance_squared, _mm_set1_ps(observer.min_score_distance_squared)));
+			score = _mm_max_ps(score, observer_score);
+			
+			if (& observer == & _observers.front())
+			{
+				primary_distance_squared = distance_squared;
+			}
+		}
+		_mm_storeu_ps(score_data.score + index, score);
+		
+		auto is_leaf = _mm_cmpeq_ps(_mm_loadu_ps(score_data.leaf + index), one);
+		leaf_score_min = _mm_min_ps(leaf_score_min, Select4(is_leaf, score, float_max));
+		leaf_score_max = _mm_max_ps(leaf_score_max, Select4(is_leaf, score, float_lowest));
+		leaf_distance_squared_min = _mm_min_ps(leaf_distance_squared_min, Select4(is_leaf, primary_distance_squared, float_max));
+	}
+	
+	auto & leaf_score_range = counters.leaf_score_range;
+	leaf_score_range.x = std::min(leaf_score_range.x, HorizontalMin4(leaf_score_min));
+	leaf_score_range.y = std::max(leaf_score_range.y, HorizontalMax4(leaf_score_max));
+	counters.min_leaf_distance_squared = std::min(counters.min_leaf_distance_squared, HorizontalMin4(leaf_distance_squared_min));
+	
+	ScoreScalar(score_data, index, end_index, counters);
+}
+#endif
@@ -10,6 +10,7 @@
 #pragma once
 
 #include "form/defs.h"
+#include "form/NodeBuffer.h"
 
 #include "gfx/LodParameters.h"
 
@@ -20,38 +21,90 @@ namespace form
 
 	// A functor for use primarily in NodeBuffer::ForEachNode_Paralell/Serial.
 	// An object of this class is a member of NodeBuffer and stores all data needed to score the buffer's nodes.
+	// Nodes can be scored against several LOD centers at once, e.g. for
+	// additional viewpoints; a node's score is then its highest score from
+	// any of them. Leaf statistics concern the primary LOD center only.
 	// TODO: It doesn't make sense for this to persist across multiple Tick calls.
 	class CalculateNodeScoreFunctor
 	{
 		OBJECT_NO_COPY (CalculateNodeScoreFunctor);
 		
 	public:
+		// statistics about leaf nodes gathered during a scoring pass;
+		// a pass split across threads keeps one per thread and merges them
+		struct Counters
+		{
+			void Reset();
+			void Merge(Counters const & rhs);
+
+			Scalar min_leaf_distance_squared;
+			geom::Vector2f leaf_score_range;
+		};
 		
 		CalculateNodeScoreFunctor();
 
 		// Returns a lod center that is significantly different to any valid position. 
 		static gfx::LodParameters const & GetInvalidLodParameters();
 		
-		// Returns true iff using the functor with the given lod center instead
-		// would yield significantly different scores.
-		bool IsSignificantlyDifferent(Vector3 const & other_lod_center) const;
+		// Returns true iff using the functor with the given lod parameters instead
+		// would yield significantly different scores; with prediction, the point
+		// scored against depends on the velocity as well as the LOD center.
+		bool IsSignificantlyDifferent(gfx::LodParameters const & other_lod_parameters, gfx::LodParametersVector const & other_secondary_lod_parameters) const;
 		
 		void ResetCounters();
 		geom::Vector2f GetLeafScoreRange() const;
 		Scalar GetMinLeafDistanceSquared() const;
 		
-		void SetLodParameters(gfx::LodParameters const & lod_parameters);
+		void SetLodParameters(gfx::LodParameters const & lod_parameters, gfx::LodParametersVector const & secondary_lod_parameters = gfx::LodParametersVector());
+
+		void MergeCounters(Counters const & counters);
 
 		void operator() (Node & node);
+		void operator() (Node & node, Counters & counters) const;
+		
+		// scores nodes [begin_index, end_index) of score_data in bulk;
+		// writes to score_data.score only; uses SIMD where available
+		void operator() (NodeBuffer::ScoreData const & score_data, int begin_index, int end_index, Counters & counters) const;
 
 	private:
+		// the point against which nodes would be scored given lod_parameters
+		// and its distance from the LOD center
+		Vector3 GetScoreCenter(gfx::LodParameters const & lod_parameters, Scalar & score_offset) const;
+		
+		// a point against which nodes are scored
+		struct Observer
+		{
+			Vector3 center;
+			Scalar min_score_distance_squared;
+			Scalar inverse_min_score_distance_squared;
+		};
+		
+		static Observer MakeObserver(Vector3 const & center, Scalar min_distance);
+		
+		// returns the score of a node as seen by observer;
+		// sets distance_squared to that between them
+		static float Score(Observer const & observer, geom::Vector3f const & center, geom::Vector3f const & normal, float area, float & distance_squared);
+		
+		// returns the highest score of a node as seen by any observer;
+		// sets distance_squared to that from the primary observer
+		float Score(geom::Vector3f const & center, geom::Vector3f const & normal, float area, float & distance_squared) const;
+		
+		void ScoreScalar(NodeBuffer::ScoreData const & score_data, int begin_index, int end_index, Counters & counters) const;
+#if defined(CRAG_CPU_X86)
+		void ScoreSse(NodeBuffer::ScoreData const & score_data, int begin_index, int end_index, Counters & counters) const;
+#endif
+		
 		gfx::LodParameters _lod_parameters;
+		gfx::LodParametersVector _secondary_lod_parameters;
+		
+		// the first observer is the primary one; its center differs from the
+		// LOD center when prediction is enabled and the LOD center is moving
+		std::vector<Observer> _observers;
+		Scalar _score_offset;
+		
 		Scalar min_recalc_distance_squared;
-		Scalar min_score_distance_squared;
-		Scalar inverse_min_score_distance_squared;
-		Scalar min_leaf_distance_squared;
 		
-		geom::Vector2f leaf_score_range;
+		Counters _counters;
 	};
 
 }	// form
@@ -121,40 +121,50 @@ namespace
 			return side_attributes;
 		}
 
-		SideAttributes GenerateSideAttributes(Ray3 const & ray, Triangle3 const & side)
+		Plane3 GenerateSidePlane(Triangle3 const & side)
 		{
 			// assumes contact will typically occur much closer to surface
-			Plane3 plane(
+			return Plane3(
 				(side.points[0] + side.points[1]) * Scalar(.5),
 				geom::Normalized(geom::UnitNormal(side)));
+		}
 
-			return GenerateSideAttributes(ray, plane);
+		SideAttributes GenerateSideAttributes(Ray3 const & ray, Triangle3 const & side)
+		{
+			return GenerateSideAttributes(ray, GenerateSidePlane(side));
 		}
 
-		// given attributes with all 3 side attributes filled out, calculate the range
-		void GenerateAttributesRange(Attributes & attributes)
+		// given all 3 side attributes, calculate the range of the ray inside the pyramid
+		Range GenerateRange(SideAttributes const (& sides)[3])
 		{
-			attributes.range[0] = std::numeric_limits<Scalar>::lowest();
-			attributes.range[1] = std::numeric_limits<Scalar>::max();
+			Range range = {{ std::numeric_limits<Scalar>::lowest(), std::numeric_limits<Scalar>::max() }};
 
 			for (int side_index0 = 0; side_index0 != 3; ++ side_index0)
 			{
-				auto & side_attributes = attributes.sides[side_index0];
+				auto & side_attributes = sides[side_index0];
 
 				if (side_attributes.dot_product > 0)
 				{
 					// going in to the area
-					attributes.range[0] = std::max(attributes.range[0], side_attributes.intersection);
+					range[0] = std::max(range[0], side_attributes.intersection);
 				}
 				else
 				{
 					// going out of the area
-					attributes.range[1] = std::min(attributes.range[1], side_attributes.intersection);
+					range[1] = std::min(range[1], side_attributes.intersection);
 				}
 			}
 
-			CRAG_VERIFY(attributes.range[0]);
-			CRAG_VERIFY(attributes.range[1]);
+			CRAG_VERIFY(range[0]);
+			CRAG_VERIFY(range[1]);
+
+			return range;
+		}
+
+		// given attributes with all 3 side attributes filled out, calculate the range
+		void GenerateAttributesRange(Attributes & attributes)
+		{
+			attributes.range = GenerateRange(attributes.sides);
 		}
 
 		// fill out attributes given the ray cast invariants
@@ -329,6 +339,266 @@ namespace
 
 			return ForEachFace(std::begin(child_attributes), std::end(child_attributes), uniforms, & Recurse);
 		}
+
+		////////////////////////////////////////////////////////////////////////////////
+		// packets - used by CastRays to cast several rays in one traversal
+
+		// the most rays in a packet
+		constexpr auto max_packet_size = 8;
+
+		// identifies a subset of the rays in a packet
+		typedef std::uint32_t RayMask;
+		static_assert(max_packet_size <= std::numeric_limits<RayMask>::digits, "RayMask is too narrow");
+
+		// as Uniforms, except that the length of each ray
+		// is cut short as contact is found
+		struct PacketUniforms
+		{
+			Vector3 center;
+			Ray3 rays[max_packet_size];
+			Scalar lengths[max_packet_size];
+			RayCastResult results[max_packet_size];
+		};
+
+		// as Attributes for each ray in a packet
+		struct PacketAttributes
+		{
+			Node const * node;
+			Triangle3 surface;
+			SideAttributes sides[max_packet_size][3];
+			Range ranges[max_packet_size];
+
+			// the rays which pass through the pyramid within their length
+			RayMask mask;
+
+			// the least distance at which one of those rays enters the pyramid
+			Scalar min_range;
+		};
+
+		// type of the function given to the ForEachPacketFace function
+		typedef void ForEachPacketFaceFunction(PacketUniforms &, PacketAttributes const &);
+
+		// the sort criteria applied in the ForEachPacketFace function
+		bool operator<(PacketAttributes const & lhs, PacketAttributes const & rhs)
+		{
+			return lhs.min_range < rhs.min_range;
+		}
+
+		// calls function with the index of each ray in mask
+		template <typename Function>
+		void ForEachRay(RayMask mask, Function function)
+		{
+			for (auto ray_index = 0; mask != 0; ++ ray_index, mask >>= 1)
+			{
+				if (mask & 1)
+				{
+					function(ray_index);
+				}
+			}
+		}
+
+		// true iff the ray passes through the pyramid before it ends;
+		// equivalent to the tests applied in ForEachFace
+		bool IsInRange(Range const & range, Scalar length)
+		{
+			return range[1] > 0 && range[0] < range[1] && range[0] < length;
+		}
+
+		// given attributes with the side attributes of the rays in mask filled out,
+		// calculate the ranges and which of those rays pass through the pyramid
+		void GeneratePacketAttributesRanges(PacketUniforms const & uniforms, RayMask mask, PacketAttributes & attributes)
+		{
+			attributes.mask = 0;
+			attributes.min_range = std::numeric_limits<Scalar>::max();
+
+			ForEachRay(mask, [& uniforms, & attributes] (int ray_index)
+			{
+				auto & range = attributes.ranges[ray_index];
+				range = GenerateRange(attributes.sides[ray_index]);
+
+				if (IsInRange(range, uniforms.lengths[ray_index]))
+				{
+					attributes.mask |= RayMask(1) << ray_index;
+					attributes.min_range = std::min(attributes.min_range, range[0]);
+				}
+			});
+		}
+
+		// fill out attributes for the rays in mask
+		void GeneratePacketAttributes(PacketUniforms const & uniforms, RayMask mask, PacketAttributes & attributes, Node const * node, form::Point const & a, form::Point const & b, form::Point const & c)
+		{
+			attributes.node = node;
+			attributes.surface = Triangle3(static_cast<Vector3>(a.pos), static_cast<Vector3>(b.pos), static_cast<Vector3>(c.pos));
+
+			for (int side_index0 = 0; side_index0 != 3; ++ side_index0)
+			{
+				const auto side_index1 = TriMod(side_index0 + 1);
+				const auto side_index2 = TriMod(side_index0 + 2);
+
+				const auto & p = attributes.surface.points[side_index2];
+				const auto & q = attributes.surface.points[side_index1];
+				const auto plane = GenerateSidePlane(Triangle3(p, q, uniforms.center));
+
+				ForEachRay(mask, [& uniforms, & attributes, & plane, side_index0] (int ray_index)
+				{
+					attributes.sides[ray_index][side_index0] = GenerateSideAttributes(uniforms.rays[ray_index], plane);
+				});
+			}
+
+			GeneratePacketAttributesRanges(uniforms, mask, attributes);
+		}
+
+		// as above with a little less known information
+		void GeneratePacketAttributes(PacketUniforms const & uniforms, RayMask mask, PacketAttributes & attributes, Node const & node)
+		{
+			GeneratePacketAttributes(uniforms, mask, attributes, & node, ref(node.GetCorner(0)), ref(node.GetCorner(1)), ref(node.GetCorner(2)));
+		}
+
+		// as ForEachFace except that function is called on each pyramid
+		// through which any of the rays in the packet pass
+		template <typename Iterator>
+		void ForEachPacketFace(Iterator begin, Iterator end, PacketUniforms & uniforms, ForEachPacketFaceFunction function)
+		{
+			std::sort(begin, end);
+
+			for (auto i = begin; i != end; ++ i)
+			{
+				PacketAttributes & attributes = * i;
+
+				// drop rays which were cut short by contact with earlier pyramids
+				ForEachRay(attributes.mask, [& uniforms, & attributes] (int ray_index)
+				{
+					if (attributes.ranges[ray_index][0] >= uniforms.lengths[ray_index])
+					{
+						attributes.mask &= ~ (RayMask(1) << ray_index);
+					}
+				});
+
+				if (attributes.mask == 0)
+				{
+					continue;
+				}
+
+				(* function)(uniforms, attributes);
+			}
+		}
+
+		// as DoFace for each ray in the packet
+		void DoPacketFace(PacketUniforms & uniforms, PacketAttributes const & leaf_attributes)
+		{
+			Triangle3 const & side = leaf_attributes.surface;
+			Plane3 plane(side);
+
+			ForEachRay(leaf_attributes.mask, [& uniforms, & leaf_attributes, & plane] (int ray_index)
+			{
+				auto const & range = leaf_attributes.ranges[ray_index];
+				auto & length = uniforms.lengths[ray_index];
+				const auto side_attributes = GenerateSideAttributes(uniforms.rays[ray_index], plane);
+
+				if (side_attributes.dot_product > 0 // only register entry - not exit
+				&& side_attributes.intersection >= range[0]	// within the volume covered by the node
+				&& side_attributes.intersection < range[1]
+				&& side_attributes.intersection <= length	// within the overall range
+				&& side_attributes.intersection >= 0)
+				{
+					auto & result = uniforms.results[ray_index];
+					result = std::min(result, RayCastResult(static_cast<form::Vector3>(plane.normal), side_attributes.intersection, leaf_attributes.node));
+
+					// further contacts are of no use beyond this one
+					length = result.GetDistance();
+				}
+			});
+		}
+
+		// as DoLeaf for each ray in the packet
+		void DoPacketLeaf(PacketUniforms & uniforms, PacketAttributes const & attributes)
+		{
+			std::array<PacketAttributes, 4> children;
+			auto children_begin = std::begin(children);
+			auto children_end = std::begin(children);
+			ForEachNodeFace(* attributes.node, [& uniforms, & attributes, & children_end] (form::Point const & a, form::Point const & b, form::Point const & c, form::Vector3 const &, form::Scalar)
+			{
+				GeneratePacketAttributes(uniforms, attributes.mask, * children_end, attributes.node, a, b, c);
+				++ children_end;
+			});
+			ASSERT(children_end >= std::begin(children));
+			ASSERT(children_end <= std::end(children));
+
+			ForEachPacketFace(children_begin, children_end, uniforms, & DoPacketFace);
+		}
+
+		// as Recurse for each ray in the packet
+		void RecursePacket(PacketUniforms & uniforms, PacketAttributes const & attributes)
+		{
+			const auto & node = ref(attributes.node);
+			auto children = node.GetChildren();
+			if (children == nullptr)
+			{
+				DoPacketLeaf(uniforms, attributes);
+				return;
+			}
+
+			auto mask = attributes.mask;
+			PacketAttributes child_attributes[4];
+
+			// the center child node contains entirely novel edges
+			GeneratePacketAttributes(uniforms, mask, child_attributes[3], children[3]);
+
+			// but each of the outer three children 
+			// are some combination of the parent and the center child
+			for (auto child_index0 = 0; child_index0 != 3; ++ child_index0)
+			{
+				auto child_index1 = TriMod(child_index0 + 1);
+				auto child_index2 = TriMod(child_index0 + 2);
+
+				auto & child_attribute = child_attributes[child_index0];
+				auto const & center_attribute = child_attributes[3];
+
+				child_attribute.node = children + child_index0;
+
+				child_attribute.surface.points[child_index0] = attributes.surface.points[child_index0];
+				child_attribute.surface.points[child_index1] = center_attribute.surface.points[child_index2];
+				child_attribute.surface.points[child_index2] = center_attribute.surface.points[child_index1];
+
+				ForEachRay(mask, [&] (int ray_index)
+				{
+					auto & sides = child_attribute.sides[ray_index];
+					sides[child_index0] = center_attribute.sides[ray_index][child_index0];
+					sides[child_index0].dot_product *= -1;
+					sides[child_index1] = attributes.sides[ray_index][child_index1];
+					sides[child_index2] = attributes.sides[ray_index][child_index2];
+				});
+
+				GeneratePacketAttributesRanges(uniforms, mask, child_attribute);
+			}
+
+			ForEachPacketFace(std::begin(child_attributes), std::end(child_attributes), uniforms, & RecursePacket);
+		}
+
+		// inserts two zero bits between each of the lower 10 bits of value
+		std::uint32_t SpreadBits(std::uint32_t value)
+		{
+			value &= 0x3ff;
+			value = (value | (value << 16)) & 0x30000ff;
+			value = (value | (value << 8)) & 0x300f00f;
+			value = (value | (value << 4)) & 0x30c30c3;
+			value = (value | (value << 2)) & 0x9249249;
+			return value;
+		}
+
+		// position along a Z-order curve through the given bounds;
+		// used to gather rays which start close together into the same packet
+		std::uint32_t GetPacketKey(Vector3 const & position, Vector3 const & lower, Vector3 const & scale)
+		{
+			std::uint32_t key = 0;
+			for (auto axis = 0; axis != 3; ++ axis)
+			{
+				auto quantized = static_cast<std::uint32_t>((position[axis] - lower[axis]) * scale[axis]);
+				key |= SpreadBits(quantized) << axis;
+			}
+
+			return key;
+		}
 	}
 }
 
@@ -340,6 +610,12 @@ RayCastResult form::CastRay(Polyhedron const & polyhedron, Ray3 const & ray, Sca
 	CRAG_VERIFY_UNIT(ray.direction, .0001f);
 	CRAG_VERIFY_OP(length, >=, 0.f);
 	
+	auto root_node_ptr = polyhedron.GetRootNode();
+	if (! root_node_ptr)
+	{
+		return RayCastResult();
+	}
+	
 	// generate uniforms
 	auto polyhedron_center = static_cast<Vector3>(polyhedron.GetShape().center);
 	impl::Uniforms uniforms = 
@@ -352,7 +628,7 @@ RayCastResult form::CastRay(Polyhedron const & polyhedron, Ray3 const & ray, Sca
 	// generate child attributes
 	impl::Attributes child_attributes[4];
 	{
-		auto & root_node = polyhedron.GetRootNode();
+		auto & root_node = * root_node_ptr;
 		auto children = root_node.GetChildren();
 		if (children != nullptr)
 		{
@@ -389,3 +665,95 @@ RayCastResult form::CastRay(Polyhedron const & polyhedron, Ray3 const & ray, Sca
 	return impl::ForEachFace(std::begin(child_attributes), std::end(child_attributes), uniforms, & impl::Recurse);
 #endif
 }
+
+////////////////////////////////////////////////////////////////////////////////
+// CastRays implementation
+
+void form::CastRays(Polyhedron const & polyhedron, Ray3 const * rays, Scalar const * lengths, RayCastResult * results, int num_rays)
+{
+	std::fill(results, results + num_rays, RayCastResult());
+
+	auto root_node_ptr = polyhedron.GetRootNode();
+	if (! root_node_ptr || num_rays == 0)
+	{
+		return;
+	}
+
+	// order the rays by their starting points
+	auto lower = rays[0].position;
+	auto upper = rays[0].position;
+	std::for_each(rays, rays + num_rays, [& lower, & upper] (Ray3 const & ray)
+	{
+		CRAG_VERIFY_UNIT(ray.direction, .0001f);
+
+		for (auto axis = 0; axis != 3; ++ axis)
+		{
+			lower[axis] = std::min(lower[axis], ray.position[axis]);
+			upper[axis] = std::max(upper[axis], ray.position[axis]);
+		}
+	});
+
+	Vector3 scale;
+	for (auto axis = 0; axis != 3; ++ axis)
+	{
+		auto range = upper[axis] - lower[axis];
+		scale[axis] = (range > 0) ? Scalar(0x3ff) / range : Scalar(0);
+	}
+
+	std::vector<std::pair<std::uint32_t, int>> keys(num_rays);
+	for (auto ray_index = 0; ray_index != num_rays; ++ ray_index)
+	{
+		keys[ray_index] = std::make_pair(impl::GetPacketKey(rays[ray_index].position, lower, scale), ray_index);
+	}
+
+	std::sort(std::begin(keys), std::end(keys));
+
+	// cast each packet of consecutive rays
+	auto & root_node = * root_node_ptr;
+	auto children = root_node.GetChildren();
+
+	impl::PacketUniforms uniforms;
+	uniforms.center = static_cast<impl::Vector3>(polyhedron.GetShape().center);
+
+	for (auto packet_begin = 0; packet_begin < num_rays; packet_begin += impl::max_packet_size)
+	{
+		auto packet_size = std::min(impl::max_packet_size, num_rays - packet_begin);
+		for (auto ray_index = 0; ray_index != packet_size; ++ ray_index)
+		{
+			auto index = keys[packet_begin + ray_index].second;
+			CRAG_VERIFY_OP(lengths[index], >=, 0.f);
+
+			uniforms.rays[ray_index] = static_cast<impl::Ray3>(rays[index]);
+			uniforms.lengths[ray_index] = lengths[index];
+			uniforms.results[ray_index] = RayCastResult();
+		}
+
+		auto mask = (impl::RayMask(1) << packet_size) - 1;
+
+		impl::PacketAttributes child_attributes[4];
+		if (children != nullptr)
+		{
+			for (auto child_index = 0; child_index != 4; ++ child_index)
+			{
+				GeneratePacketAttributes(uniforms, mask, child_attributes[child_index], children[child_index]);
+			}
+		}
+		else
+		{
+			GeneratePacketAttributes(uniforms, mask, child_attributes[0], & root_node, * root_node.GetCorner(0), * root_node.GetMidPoint(2), * root_node.GetMidPoint(1));
+			GeneratePacketAttributes(uniforms, mask, child_attributes[1], & root_node, * root_node.GetCorner(1), * root_node.GetMidPoint(0), * root_node.GetMidPoint(2));
+			GeneratePacketAttributes(uniforms, mask, child_attributes[2], & root_node, * root_node.GetCorner(2), * root_node.GetMidPoint(1), * root_node.GetMidPoint(0));
+			GeneratePacketAttributes(uniforms, mask, child_attributes[3], & root_node, * root_node.GetMidPoint(0), * root_node.GetMidPoint(1), * root_node.GetMidPoint(2));
+		}
+
+		impl::ForEachPacketFace(std::begin(child_attributes), std::end(child_attributes), uniforms, & impl::RecursePacket);
+
+		for (auto ray_index = 0; ray_index != packet_size; ++ ray_index)
+		{
+			auto const & result = uniforms.results[ray_index];
+			CRAG_VERIFY(result);
+
+			results[keys[packet_begin + ray_index].second] = result;
+		}
+	}
+}
@@ -20,4 +20,8 @@ namespace form
 	// performs a ray cast on a polyhedron; ray must have unit direction 
 	// and if no contact is found, length is max for Scalar
 	RayCastResult CastRay(Polyhedron const & polyhedron, Ray3 const & ray, Scalar length);
+
+	// performs num_rays ray casts on a polyhedron as above; rays which start
+	// close together are cast in packets, each of which traverses the nodes once
+	void CastRays(Polyhedron const & polyhedron, Ray3 const * rays, Scalar const * lengths, RayCastResult * results, int num_rays);
 }
@@ -43,6 +43,16 @@ namespace
 	STAT (mesh_generation, bool, .206f);
 	STAT (dynamic_space, bool, .206f);
 	STAT (form_changed_gfx, bool, 0);
+	STAT (form_point_occupancy, float, .206f);
+	STAT (form_point_fragmentation, float, .206f);
+	
+	// If true, meshes are patched with the faces of changed nodes
+	// rather than regenerated from scratch.
+	CONFIG_DEFINE(form_mesh_patching, false);
+	
+	// If true, meshes share vertices between faces, use a compact vertex format
+	// and are divided into chunks; takes precedence over form_mesh_patching.
+	CONFIG_DEFINE(form_mesh_indexed, false);
 
 	// the maximum size of formation-related buffers is limited by the maximum
 	// value allowed in GLES index buffers (which are 16 in some cases)
@@ -53,6 +63,40 @@ namespace
 	auto const max_num_nodes = max_num_tris >> 1;
 	auto const max_num_quaterne = max_num_nodes >> 2;
 	auto const min_num_quaterne = std::min(1024, max_num_quaterne);
+	
+	// indexed meshes are divided into chunks which each respect the limit and
+	// so are limited instead by the capacity of the node and point buffers and
+	// by the memory they take up front, roughly 150MB at the desired maximum
+	auto const max_desired_num_chunked_quaterne = int(max_desired_num_verts >> 2);
+	
+	// patched meshes reserve room for the most faces a node can have;
+	// their vertices aren't indexed and so are limited only by memory
+	auto const max_num_patched_verts = uintmax_t(max_num_nodes) * form::Mesh::num_verts_per_slot;
+	auto const max_patched_mesh_size = uintmax_t(128) << 20;
+	
+	bool IsMeshPatchingEnabled()
+	{
+		if (! form_mesh_patching)
+		{
+			return false;
+		}
+		
+		auto patched_mesh_size = max_num_patched_verts * sizeof(form::Mesh::Vertex);
+		if (patched_mesh_size > max_patched_mesh_size)
+		{
+			ERROR_MESSAGE("form_mesh_patching ignored; a patched mesh would take %ju bytes", patched_mesh_size);
+			return false;
+		}
+		
+		return true;
+	}
+	
+	int GetMaxNumQuaterne()
+	{
+		return form_mesh_indexed
+			? std::min(max_desired_num_chunked_quaterne, Surrounding::GetMaxCapacity())
+			: max_num_quaterne;
+	}
 }
 
 
@@ -62,18 +106,29 @@ namespace
 Engine::Engine()
 : quit_flag(false)
 , enable_mesh_generation(true)
+, _mesh_buffer(std::make_shared<MeshBuffer>())
 , mesh_generation_time(app::GetTime())
 , _enable_adjust_num_quaterna(true)
 , _requested_num_quaterne(0)
 , _pending_space_request(false)
-, _lod_parameters({ Vector3::Zero(), 0.f })
-, _scene(min_num_quaterne, max_num_quaterne)
+, _lod_parameters({ Vector3::Zero(), 0.f, Vector3::Zero() })
+, _scene(min_num_quaterne, GetMaxNumQuaterne())
 {
-	for (int num_meshes = 3; num_meshes > 0; -- num_meshes)
+	auto is_mesh_patching_enabled = ! form_mesh_indexed && IsMeshPatchingEnabled();
+	for (auto & mesh : * _mesh_buffer)
 	{
-		auto mesh = std::make_shared<Mesh>();
-		mesh->Reserve(max_num_verts, max_num_tris);
-		_meshes.push(mesh);
+		if (form_mesh_indexed)
+		{
+			mesh.EnableIndexing();
+		}
+		else if (is_mesh_patching_enabled)
+		{
+			mesh.EnablePatching(max_num_nodes);
+		}
+		else
+		{
+			mesh.Reserve(max_num_verts, max_num_tris);
+		}
 	}
 }
 
@@ -103,11 +158,6 @@ void Engine::OnRemoveFormation(Formation & formation)
 	_scene.RemoveFormation(formation);
 }
 
-void Engine::OnSetMesh(std::shared_ptr<Mesh> const & mesh)
-{
-	_meshes.push(mesh);
-}
-
 void Engine::operator() (gfx::SetLodParametersEvent const & event)
 {
 	_lod_parameters = event.parameters;
@@ -118,6 +168,10 @@ void Engine::operator() (gfx::SetSpaceEvent const & event)
 	_pending_space_request = true;
 
 	_lod_parameters.center = geom::Convert(_lod_parameters.center, _space, event.space);
+	for (auto & secondary : _secondary_lod_parameters)
+	{
+		secondary.center = geom::Convert(secondary.center, _space, event.space);
+	}
 	_space = event.space;
 }
 
@@ -126,6 +180,11 @@ geom::Space const & Engine::GetSpace() const
 	return _space;
 }
 
+void Engine::SetSecondaryLodParameters(gfx::LodParametersVector const & secondary_lod_parameters)
+{
+	_secondary_lod_parameters = secondary_lod_parameters;
+}
+
 void Engine::EnableAdjustNumQuaterna(bool enabled)
 {
 	_enable_adjust_num_quaterna = enabled;
@@ -163,8 +222,8 @@ void Engine::Run(Daemon::MessageQueue & message_queue)
 {
 	FUNCTION_NO_REENTRY;
 	
-	// create the mesh used to pass results to the gfx thread
-	_mesh.CreateObject();
+	// create the object which renders the meshes on the gfx thread
+	_mesh.CreateObject(_mesh_buffer);
 	
 	while (! quit_flag) 
 	{
@@ -206,7 +265,7 @@ void Engine::TickScene()
 {
 	PROFILE_TIMER_BEGIN(t);
 	
-	if (_scene.Tick(_lod_parameters))
+	if (_scene.Tick(_lod_parameters, _secondary_lod_parameters))
 	{
 		PROFILE_SAMPLE(scene_tick_per_quaterna, PROFILE_TIMER_READ(t) / _scene.GetSurrounding().GetNumQuaternaUsed());
 		PROFILE_SAMPLE(scene_tick_period, PROFILE_TIMER_READ(t));
@@ -217,6 +276,8 @@ void Engine::TickScene()
 		}
 
 		STAT_SET(form_changed_gfx, true);
+		STAT_SET(form_point_occupancy, float(_scene.GetSurrounding().GetPoints().GetSize()) / _scene.GetSurrounding().GetPoints().GetCapacity());
+		STAT_SET(form_point_fragmentation, _scene.GetSurrounding().GetPoints().GetFragmentation());
 	}
 	else
 	{
@@ -237,7 +298,7 @@ void Engine::AdjustNumQuaterna()
 	}
 	
 	// limit the range of quaterne counts
-	Clamp(_requested_num_quaterne, min_num_quaterne, max_num_quaterne);
+	Clamp(_requested_num_quaterne, min_num_quaterne, GetMaxNumQuaterne());
 	
 	// apply the recommended number
 	Surrounding & active_buffer = _scene.GetSurrounding();
@@ -246,20 +307,17 @@ void Engine::AdjustNumQuaterna()
 
 void Engine::GenerateMesh()
 {
-	// get an available mesh
-	std::shared_ptr<Mesh> mesh = PopMesh();
-	if (! mesh)
+	_scene.GenerateMesh(_mesh_buffer->GetBack(), _space);
+	
+	// hand it to the gfx::Surrounding object; if the previous mesh is still
+	// waiting to be picked up, the notification already sent will suffice
+	if (_mesh_buffer->Publish())
 	{
-		return;
+		_mesh.Call([] (gfx::Surrounding & surrounding) {
+			surrounding.OnMeshPublished();
+		});
 	}
 	
-	_scene.GenerateMesh(* mesh, _space);
-	
-	// send it to the gfx::Surrounding object
-	_mesh.Call([mesh] (gfx::Surrounding & surrounding) {
-		surrounding.SetMesh(mesh);
-	});
-	
 	// record timing information
 	::core::Time t = app::GetTime();
 	::core::Time last_mesh_generation_period = t - mesh_generation_time;
@@ -278,18 +336,6 @@ void Engine::GenerateMesh()
 	PROFILE_SAMPLE(mesh_generation_period, last_mesh_generation_period);
 }
 
-std::shared_ptr<Mesh> Engine::PopMesh()
-{
-	if (_meshes.empty())
-	{
-		return nullptr;
-	}
-	
-	auto mesh = _meshes.top();
-	_meshes.pop();
-	return mesh;
-}
-
 void Engine::OnSpaceReset()
 {
 	_scene.OnSpaceReset(_space, _lod_parameters);
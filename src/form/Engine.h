@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include "form/Mesh.h"
 #include "form/Scene.h"
 
 #include "gfx/LodParameters.h"
@@ -35,7 +36,6 @@ namespace form
 	// forward declarations
 	
 	class Object;
-	class Mesh;
 	
 	// form::Daemon type
 	class Engine;
@@ -73,10 +73,13 @@ namespace form
 		void OnQuit();
 		void OnAddFormation(Formation & formation);
 		void OnRemoveFormation(Formation & formation);
-		void OnSetMesh(std::shared_ptr<Mesh> const & mesh);
 		void operator() (gfx::SetLodParametersEvent const & event) final;
 		void operator() (gfx::SetSpaceEvent const & event) final;
 		geom::Space const & GetSpace() const;
+		
+		// additional viewpoints, e.g. of spectators, which share the node budget;
+		// their centers are relative to the current space
+		void SetSecondaryLodParameters(gfx::LodParametersVector const & secondary_lod_parameters);
 
 		void EnableAdjustNumQuaterna(bool enabled);
 		void OnSetRecommendedNumQuaterne(int recommented_num_quaterne);
@@ -96,7 +99,6 @@ namespace form
 		void Tick();
 		void TickScene();
 		void GenerateMesh();
-		std::shared_ptr<Mesh> PopMesh();
 		
 		void AdjustNumQuaterna();
 		
@@ -111,7 +113,8 @@ namespace form
 		bool quit_flag;
 		bool enable_mesh_generation;
 		
-		std::stack<std::shared_ptr<Mesh>> _meshes;
+		// meshes are generated into the back buffer and rendered from the front
+		std::shared_ptr<MeshBuffer> _mesh_buffer;
 		
 		core::Time mesh_generation_time;
 		
@@ -121,6 +124,7 @@ namespace form
 		bool _pending_space_request;
 
 		gfx::LodParameters _lod_parameters;
+		gfx::LodParametersVector _secondary_lod_parameters;
 		geom::Space _space;
 		Scene _scene;
 	};
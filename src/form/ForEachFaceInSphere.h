@@ -8,6 +8,7 @@
 //
 
 #include "Polyhedron.h"
+#include "SphereQueryHint.h"
 #include "ForEachNodeFace.h"
 #include "ForEachChildNode.h"
 
@@ -22,6 +23,11 @@ namespace form
 	template <typename FUNCTOR>
 	void ForEachFaceInSphere(Polyhedron const &, Sphere3 const &, FUNCTOR);
 
+	// as above but begins the search from the node remembered by hint,
+	// if it is still valid, and updates hint to help the next query
+	template <typename FUNCTOR>
+	void ForEachFaceInSphere(Polyhedron const &, Sphere3 const &, FUNCTOR, SphereQueryHint &);
+
 	////////////////////////////////////////////////////////////////////////////////
 	// helper classes and functions
 
@@ -35,6 +41,63 @@ namespace form
 		&& Intersects(Plane3(Triangle3(pyramid_tip, pyramid_base.points[2], pyramid_base.points[1])), sphere);
 	}
 
+	// true iff sphere lies wholly within the projection
+	inline bool ContainsProjection(Vector3 const & pyramid_tip, Triangle3 const & pyramid_base, Sphere3 const & sphere)
+	{
+		auto contains = [&] (Vector3 const & a, Vector3 const & b)
+		{
+			return Distance(Plane3(Triangle3(pyramid_tip, a, b)), sphere.center) <= - sphere.radius;
+		};
+		
+		return contains(pyramid_base.points[0], pyramid_base.points[2])
+		&& contains(pyramid_base.points[1], pyramid_base.points[0])
+		&& contains(pyramid_base.points[2], pyramid_base.points[1]);
+	}
+	
+	// false if any corner of node is missing
+	inline bool GetNodeSurface(Node const & node, Triangle3 & surface)
+	{
+		for (auto index = 0; index != 3; ++ index)
+		{
+			auto corner = node.GetCorner(index);
+			if (! corner)
+			{
+				return false;
+			}
+			
+			surface.points[index] = corner->pos;
+		}
+		
+		return true;
+	}
+	
+	// returns the node at or above the one in hint whose projection contains
+	// sphere and sets surface to its surface, or returns null
+	inline Node const * FindEntryNode(SphereQueryHint const & hint, Vector3 const & polyhedron_center, Sphere3 const & sphere, Triangle3 & surface)
+	{
+		auto node = hint.GetNode();
+		if (! node || ! GetNodeSurface(* node, surface) || surface != hint.GetSurface())
+		{
+			return nullptr;
+		}
+		
+		// the root node is handled separately
+		for (; node->GetParent(); node = node->GetParent())
+		{
+			if (ContainsProjection(polyhedron_center, surface, sphere))
+			{
+				return node;
+			}
+			
+			if (! GetNodeSurface(* node->GetParent(), surface))
+			{
+				return nullptr;
+			}
+		}
+		
+		return nullptr;
+	}
+
 	////////////////////////////////////////////////////////////////////////////////
 	////////////////////////////////////////////////////////////////////////////////
 	// ForEachFaceInSphere implementation
@@ -48,15 +111,23 @@ namespace form
 		: _sphere(sphere)
 		, _polyhedron_center(polyhedron_center)
 		, _poly_functor(poly_functor)
+		, _contained_node(nullptr)
 		{
 		}
 
-		void operator() (Node const & node, Triangle3 const & surface) const
+		// is_contained is true iff the projection of node is known to contain the sphere
+		void operator() (Node const & node, Triangle3 const & surface, bool is_contained = false) const
 		{
 			ASSERT(surface.points[0] == node.GetCorner(0)->pos);
 			ASSERT(surface.points[1] == node.GetCorner(1)->pos);
 			ASSERT(surface.points[2] == node.GetCorner(2)->pos);
 
+			if (is_contained)
+			{
+				_contained_node = & node;
+				_contained_surface = surface;
+			}
+
 			Node const * children = node.GetChildren();
 			if (children == nullptr)
 			{
@@ -87,6 +158,7 @@ namespace form
 			Triangle3 child_surface;
 
 			int center_counter = 0;
+			int inner_counter = 0;
 
 			// For each sub-dividing line that can be drawn between node mid-points,
 			auto test_sub_division = [&] (int sub_division_index)
@@ -109,6 +181,7 @@ namespace form
 
 					// Increment the center_counter; we're within one side of center child.
 					++ center_counter;
+					++ inner_counter;
 				}
 				else
 				{
@@ -125,7 +198,7 @@ namespace form
 					child_surface.points[sub_division_index1] = b;
 					child_surface.points[sub_division_index2] = c;
 
-					(* this)(children[sub_division_index], child_surface);
+					(* this)(children[sub_division_index], child_surface, is_contained && d > r);
 				}
 			};
 
@@ -139,7 +212,20 @@ namespace form
 				child_surface.points[1] = mid_points_pos[1];
 				child_surface.points[2] = mid_points_pos[2];
 
-				(* this)(children[3], child_surface);
+				(* this)(children[3], child_surface, is_contained && inner_counter == 3);
+			}
+		}
+		
+		// the deepest node visited which contains the sphere
+		void UpdateHint(SphereQueryHint & hint) const
+		{
+			if (_contained_node)
+			{
+				hint.Set(_contained_node, _contained_surface);
+			}
+			else
+			{
+				hint.Reset();
 			}
 		}
 
@@ -147,17 +233,42 @@ namespace form
 		Sphere3 _sphere;
 		Vector3 _polyhedron_center;
 		PolyFunctor _poly_functor;
+		mutable Node const * _contained_node;
+		mutable Triangle3 _contained_surface;
 	};
 
 	template <typename POLY_FUNCTOR>
 	void ForEachFaceInSphere(Polyhedron const & polyhedron, Sphere3 const & sphere, POLY_FUNCTOR poly_functor)
+	{
+		SphereQueryHint hint;
+		ForEachFaceInSphere(polyhedron, sphere, poly_functor, hint);
+	}
+
+	template <typename POLY_FUNCTOR>
+	void ForEachFaceInSphere(Polyhedron const & polyhedron, Sphere3 const & sphere, POLY_FUNCTOR poly_functor, SphereQueryHint & hint)
 	{
 		typedef ForEachFaceInSphereFunctor<POLY_FUNCTOR> ForEachFaceInSphereFunctor;
 
+		auto root_node_ptr = polyhedron.GetRootNode();
+		if (! root_node_ptr)
+		{
+			hint.Reset();
+			return;
+		}
+
 		Vector3 const & polyhedron_center = static_cast<Vector3>(polyhedron.GetShape().center);
 		ForEachFaceInSphereFunctor node_functor(sphere, polyhedron_center, poly_functor);
 
-		Node const & root_node = polyhedron.GetRootNode();
+		// no other node can touch the sphere if it is within the projection of this one
+		Triangle3 entry_surface;
+		if (auto entry_node = FindEntryNode(hint, polyhedron_center, sphere, entry_surface))
+		{
+			node_functor(* entry_node, entry_surface, true);
+			node_functor.UpdateHint(hint);
+			return;
+		}
+
+		Node const & root_node = * root_node_ptr;
 		if (! ForEachChildNode(root_node, [&] (Node const & child)
 		{
 			Triangle3 surface;
@@ -168,7 +279,7 @@ namespace form
 			// Slightly inefficient as the same sides have their distance calculated multiple times.
 			if (TouchesProjection(polyhedron_center, surface, sphere))
 			{
-				node_functor(child, surface);
+				node_functor(child, surface, ContainsProjection(polyhedron_center, surface, sphere));
 			}
 		}))
 		{
@@ -192,5 +303,7 @@ namespace form
 			f(* root_node.GetCorner(2), * root_node.GetMidPoint(1), * root_node.GetMidPoint(0));
 			f(* root_node.GetMidPoint(0), * root_node.GetMidPoint(1), * root_node.GetMidPoint(2));
 		}
+		
+		node_functor.UpdateHint(hint);
 	}
 }
@@ -19,12 +19,22 @@
 namespace form
 {
 	
-	// Helper function for ForEachNodeFace function.
-	inline Node::Triplet const * TripletMod(Node::Triplet const * t, Node::Triplet const * last)
+	// Helper functions for ForEachNodeFace function;
+	// points are shared between nodes and are not part of their const state.
+	inline Point & NodeCorner(Node const & node, int index)
 	{
-		assert(t >= last - 2);
-		assert(t < last + 4);
-		return (t <= last) ? t : t - 3;
+		return const_cast<Point &>(* node.GetCorner(index));
+	}
+	
+	inline Point & NodeMidPoint(Node const & node, int index)
+	{
+		return const_cast<Point &>(* node.GetMidPoint(index));
+	}
+	
+	// true iff the mid-point on the given side of the node is part of its faces
+	inline bool HasFaceMidPoint(Node const & node, int index)
+	{
+		return node.GetCousin(index) != nullptr && node.GetMidPoint(index) != nullptr;
 	}
 	
 	
@@ -37,6 +47,22 @@ namespace form
 	}
 	
 	
+	// Returns the number of triangles which ForEachNodeFace passes to its functor.
+	inline int GetNumNodeFaces(Node const & node)
+	{
+		int num_mid_points = 0;
+		for (int index = 0; index != 3; ++ index)
+		{
+			if (HasFaceMidPoint(node, index))
+			{
+				++ num_mid_points;
+			}
+		}
+		
+		return num_mid_points + 1;
+	}
+	
+	
 	// Given a Node, node, calculates its triangles and passes them to functor, f, via
 	// member function AddFace(a, b, c, norm) where a, b and c are the points of a triangle 
 	// and norm is the triangle's normal.
@@ -46,86 +72,88 @@ namespace form
 		// But not required.
 		
 		// Step 1: Determine the number of mid-points and note missing / solitary mid-points.
-		Node::Triplet const * odd_one_out[2] = { nullptr, nullptr };
+		int odd_one_out[2] = { -1, -1 };
 		int num_mid_points = 0;
 		
-		Node::Triplet const * triple = node.triple;
-		Node::Triplet const * t_last = triple + 2;
-		for (Node::Triplet const * t_it = triple; ; ++ t_it)
+		for (int index = 0; index != 3; ++ index)
 		{
-			if (t_it->cousin == nullptr || t_it->mid_point == nullptr)
+			if (! HasFaceMidPoint(node, index))
 			{
-				odd_one_out[false] = t_it;
+				odd_one_out[false] = index;
 			}
 			else 
 			{
-				odd_one_out[true] = t_it;
+				odd_one_out[true] = index;
 				++ num_mid_points;
 			}
-			
-			if (t_it == t_last)
-			{
-				break;
-			}
 		}
 		
+		auto score = node.GetScore();
+		
 		// Step 2: Given the number of mid-points, construct the faces possible from mid-points and corners. 
 		switch (num_mid_points)
 		{
 			case 0: 
 			{
-				assert(odd_one_out[0] != nullptr);
-				assert(odd_one_out[1] == nullptr);
+				assert(odd_one_out[0] != -1);
+				assert(odd_one_out[1] == -1);
 
 				// Only the corners are available. Has the advantage that we know what the normal is.
-				f (* triple[0].corner, * triple[1].corner, * triple[2].corner, node.normal, node.score);
+				f (NodeCorner(node, 0), NodeCorner(node, 1), NodeCorner(node, 2), node.GetNormal(), score);
 			}	break;
 				
 			case 1: 
 			{
-				assert(odd_one_out[0] != nullptr);
-				assert(odd_one_out[1] != nullptr);
+				assert(odd_one_out[0] != -1);
+				assert(odd_one_out[1] != -1);
 				
 				// A single mid-point means that the triangle can be divided in two.
-				Node::Triplet const * midpoint_triplet_0 = odd_one_out[true];
-				Point * midpoint_0 = midpoint_triplet_0->mid_point;
-				Point * corner_0 = midpoint_triplet_0->corner;
+				int midpoint_index_0 = odd_one_out[true];
+				Point & midpoint_0 = NodeMidPoint(node, midpoint_index_0);
+				Point & corner_0 = NodeCorner(node, midpoint_index_0);
 
-				AddFace(* midpoint_0, * corner_0, * TripletMod(midpoint_triplet_0 + 1, t_last)->corner, node.score, f);
-				AddFace(* corner_0, * midpoint_0, * TripletMod(midpoint_triplet_0 + 2, t_last)->corner, node.score, f);
+				AddFace(midpoint_0, corner_0, NodeCorner(node, TriMod(midpoint_index_0 + 1)), score, f);
+				AddFace(corner_0, midpoint_0, NodeCorner(node, TriMod(midpoint_index_0 + 2)), score, f);
 			}	break;
 				
 			case 2: 
 			{
-				assert(odd_one_out[0] != nullptr);
-				assert(odd_one_out[1] != nullptr);
+				assert(odd_one_out[0] != -1);
+				assert(odd_one_out[1] != -1);
 				
 				// Two mid-points means a triangle between them and their common corner
 				// and a quad made from the rest of the node. 
-				Node::Triplet const * midpoint_triplet_0 = odd_one_out[false];
-				Node::Triplet const * midpoint_triplet_1 = TripletMod(midpoint_triplet_0 + 1, t_last);
-				Node::Triplet const * midpoint_triplet_2 = TripletMod(midpoint_triplet_0 + 2, t_last);
+				int midpoint_index_0 = odd_one_out[false];
+				int midpoint_index_1 = TriMod(midpoint_index_0 + 1);
+				int midpoint_index_2 = TriMod(midpoint_index_0 + 2);
 				
-				Point * midpoint_1 = midpoint_triplet_1->mid_point;
-				Point * midpoint_2 = midpoint_triplet_2->mid_point;
+				Point & midpoint_1 = NodeMidPoint(node, midpoint_index_1);
+				Point & midpoint_2 = NodeMidPoint(node, midpoint_index_2);
 				
 				// Generate good triangle.
-				AddFace(* midpoint_triplet_0->corner, * midpoint_2, * midpoint_1, node.score, f);
+				AddFace(NodeCorner(node, midpoint_index_0), midpoint_2, midpoint_1, score, f);
 				
 				// Generate wonky quad.
-				AddFace(* midpoint_triplet_1->corner, * midpoint_triplet_2->corner, * midpoint_triplet_2->mid_point, node.score, f);
-				AddFace(* midpoint_triplet_1->mid_point, * midpoint_triplet_2->mid_point, * midpoint_triplet_2->corner, node.score, f);
+				AddFace(NodeCorner(node, midpoint_index_1), NodeCorner(node, midpoint_index_2), midpoint_2, score, f);
+				AddFace(midpoint_1, midpoint_2, NodeCorner(node, midpoint_index_2), score, f);
 			}	break;
 				
 			case 3: 
 			{
-				assert(odd_one_out[0] == nullptr);
-				assert(odd_one_out[1] != nullptr);
+				assert(odd_one_out[0] == -1);
+				assert(odd_one_out[1] != -1);
+				
+				Point & corner_0 = NodeCorner(node, 0);
+				Point & corner_1 = NodeCorner(node, 1);
+				Point & corner_2 = NodeCorner(node, 2);
+				Point & midpoint_0 = NodeMidPoint(node, 0);
+				Point & midpoint_1 = NodeMidPoint(node, 1);
+				Point & midpoint_2 = NodeMidPoint(node, 2);
 				
-				AddFace(* triple[0].corner, * triple[2].mid_point, * triple[1].mid_point, node.score, f);
-				AddFace(* triple[1].corner, * triple[0].mid_point, * triple[2].mid_point, node.score, f);
-				AddFace(* triple[2].corner, * triple[1].mid_point, * triple[0].mid_point, node.score, f);
-				AddFace(* triple[0].mid_point, * triple[1].mid_point, * triple[2].mid_point, node.score, f);
+				AddFace(corner_0, midpoint_2, midpoint_1, score, f);
+				AddFace(corner_1, midpoint_0, midpoint_2, score, f);
+				AddFace(corner_2, midpoint_1, midpoint_0, score, f);
+				AddFace(midpoint_0, midpoint_1, midpoint_2, score, f);
 			}	break;
 		}
 	}
@@ -11,16 +11,23 @@
 
 #include "form/Formation.h"
 #include "form/Mesh.h"
+#include "form/MidPointCache.h"
 #include "form/Shader.h"
 
 using namespace form;
 
+struct Formation::SharedMidPointCache
+{
+	std::shared_ptr<MidPointCache> owner;
+	std::atomic<MidPointCache *> pointer = { nullptr };
+};
 
 Formation::Formation(int seed, ShaderPtr const & shader, geom::uni::Sphere3 const & shape)
 : _seed(seed)
 , _shader(shader)
 , _shape(shape)
 , _max_radius(_shape.radius)
+, _mid_point_cache(std::make_shared<SharedMidPointCache>())
 {
 }
 
@@ -51,3 +58,15 @@ geom::uni::Scalar Formation::GetMaxRadius() const
 {
 	return _max_radius;
 }
+
+MidPointCache * Formation::GetMidPointCache() const
+{
+	return _mid_point_cache->pointer.load(std::memory_order_acquire);
+}
+
+void Formation::SetMidPointCache(std::shared_ptr<MidPointCache> const & mid_point_cache)
+{
+	ASSERT(! _mid_point_cache->owner);
+	_mid_point_cache->owner = mid_point_cache;
+	_mid_point_cache->pointer.store(mid_point_cache.get(), std::memory_order_release);
+}
@@ -16,12 +16,15 @@ namespace form
 {
 	// forward-declarations
 	class Mesh;
+	class MidPointCache;
 	class Node;
 	class Shader;
 	
 
 	// A formation is an individual element of the formation system.
 	// It contains all the data necessary to create a positioned polyhedron.
+	// Copies of a formation, e.g. those of the form and sim threads,
+	// share a mid-point cache.
 	class Formation
 	{
 	public:
@@ -44,12 +47,24 @@ namespace form
 		
 		void SampleRadius(geom::uni::Scalar sample_radius);
 		geom::uni::Scalar GetMaxRadius() const;
+		
+		// null unless a cache has been opened for this formation;
+		// may be called from any thread
+		MidPointCache * GetMidPointCache() const;
+		
+		// may only be called once for a formation and its copies; callers on
+		// different threads must agree between themselves which of them sets it
+		void SetMidPointCache(std::shared_ptr<MidPointCache> const & mid_point_cache);
 
 	private:
+		struct SharedMidPointCache;
+		
+
 		int _seed;
 		ShaderPtr _shader;
 		geom::uni::Sphere3 _shape;
 		geom::uni::Scalar _max_radius;
+		std::shared_ptr<SharedMidPointCache> _mid_point_cache;
 	};
 
 }
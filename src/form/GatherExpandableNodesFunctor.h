@@ -38,7 +38,7 @@ namespace form
 		// The node version. 
 		void operator() (Node & node)
 		{
-			if (node.score > min_score)
+			if (node.GetScore() > min_score)
 			{
 				if (node.IsExpandable()) 
 				{
@@ -18,6 +18,8 @@
 
 using namespace form;
 
+static_assert(Mesh::max_num_verts_per_chunk - 1 <= std::numeric_limits<gfx::ElementIndex>::max(), "chunks are too big to be indexed");
+
 ////////////////////////////////////////////////////////////////////////////////
 // form::Mesh
 
@@ -37,17 +39,284 @@ void Mesh::Reserve(int max_num_verts, int max_num_tris)
 void Mesh::Clear()
 {
 	_lit_mesh.clear();
+	_chunks.clear();
+	_point_normals.clear();
+	_point_chunk_vertices.clear();
+	_serial = _base_serial = 0;
+	_dirty_ranges.clear();
 }
 
 void Mesh::NormalizeNormals()
 {
-	for (auto & vertex : _lit_mesh)
+	NormalizeNormals(0, GetNumVertices());
+}
+
+void Mesh::NormalizeNormals(int vertex_begin, int vertex_end)
+{
+	CRAG_VERIFY_OP(vertex_begin, <=, vertex_end);
+	CRAG_VERIFY_OP(vertex_end, <=, GetNumVertices());
+	
+	auto vertices = & * std::begin(_lit_mesh);
+	for (auto vertex = vertices + vertex_begin; vertex != vertices + vertex_end; ++ vertex)
 	{
-		Vector3 & norm = vertex.norm;
+		Vector3 & norm = vertex->norm;
 		geom::Normalize(norm);
 	}
 }
 
+#if defined(CRAG_FORM_FLAT_SHADE)
+int Mesh::GetNumVertices() const
+{
+	return static_cast<int>(_lit_mesh.size());
+}
+#else
+int Mesh::GetNumVertices() const
+{
+	return static_cast<int>(_lit_mesh.GetVertices().size());
+}
+#endif
+
+#if defined(CRAG_FORM_FLAT_SHADE)
+void Mesh::EnablePatching(int max_num_slots)
+{
+	_is_patching = true;
+	_lit_mesh.reserve(max_num_slots * num_verts_per_slot);
+	Clear();
+}
+
+bool Mesh::IsPatching() const
+{
+	return _is_patching;
+}
+
+Mesh::Serial Mesh::BeginPatch(int num_slots, Serial serial)
+{
+	ASSERT(_is_patching);
+	ASSERT(serial > _serial);
+	ASSERT(_slot_vertex_index == -1);
+	
+	_base_serial = _serial;
+	_serial = serial;
+	_dirty_ranges.clear();
+
+	// the contents of slots introduced by a resize are
+	// guaranteed to be written because their nodes have changed
+	_lit_mesh.resize(num_slots * num_verts_per_slot);
+	
+	return _base_serial;
+}
+
+void Mesh::BeginSlot(int slot_index)
+{
+	ASSERT(_is_patching);
+	ASSERT(_slot_vertex_index == -1);
+	
+	_slot_vertex_index = slot_index * num_verts_per_slot;
+	_slot_vertex_end = _slot_vertex_index + num_verts_per_slot;
+	CRAG_VERIFY_OP(_slot_vertex_end, <=, static_cast<int>(_lit_mesh.size()));
+	
+	// extend the previous range or start a new one
+	if (! _dirty_ranges.empty() && _dirty_ranges.back().second == _slot_vertex_index)
+	{
+		_dirty_ranges.back().second = _slot_vertex_end;
+	}
+	else
+	{
+		_dirty_ranges.emplace_back(_slot_vertex_index, _slot_vertex_end);
+	}
+}
+
+void Mesh::EndSlot()
+{
+	// pad the remainder of the slot with degenerate triangles
+	Vertex const degenerate =
+	{
+		Vertex::Vector3::Zero(),
+		Vertex::Vector3(1.f, 0.f, 0.f),
+		gfx::Color4b::White()
+	};
+	std::fill(std::begin(_lit_mesh) + _slot_vertex_index, std::begin(_lit_mesh) + _slot_vertex_end, degenerate);
+	
+	_slot_vertex_index = _slot_vertex_end = -1;
+}
+
+Mesh::Serial Mesh::GetSerial() const
+{
+	return _serial;
+}
+
+Mesh::Serial Mesh::GetBaseSerial() const
+{
+	return _base_serial;
+}
+
+Mesh::VertexRangeArray const & Mesh::GetDirtyRanges() const
+{
+	return _dirty_ranges;
+}
+#endif
+
+void Mesh::EnableIndexing()
+{
+	ASSERT(! _is_patching);
+	_is_indexed = true;
+}
+
+bool Mesh::IsIndexed() const
+{
+	return _is_indexed;
+}
+
+int Mesh::GetNumChunks() const
+{
+	return static_cast<int>(_chunks.size());
+}
+
+Mesh::TerrainMesh const & Mesh::GetChunk(int chunk_index) const
+{
+	return _chunks[chunk_index].mesh;
+}
+
+int Mesh::GetChunkNumNodes(int chunk_index) const
+{
+	return _chunks[chunk_index].num_nodes;
+}
+
+Mesh::Serial Mesh::GetChunkSerial(int chunk_index) const
+{
+	return _chunks[chunk_index].serial;
+}
+
+void Mesh::BeginIndexedMesh(int num_chunks)
+{
+	ASSERT(_is_indexed);
+	ASSERT(_chunk_index == -1);
+	
+	_chunks.resize(num_chunks);
+	_point_normals.clear();
+	_point_chunk_vertices.clear();
+}
+
+// Points which are not yet part of the mesh are given an index into the
+// sums of face normals; the sums then include faces from every chunk.
+void Mesh::AddPointNormals(Point & a, Point & b, Point & c, Vertex::Vector3 const & normal)
+{
+	ASSERT(_is_indexed);
+	ASSERT(_chunk_index == -1);
+	ASSERT(NearEqual(MagnitudeSq(normal), 1.f, 0.01f));
+	
+	auto add_corner = [&] (Point & point)
+	{
+		if (point.vertex_index == -1)
+		{
+			point.vertex_index = static_cast<int>(_point_normals.size());
+			_point_normals.push_back(Vertex::Vector3::Zero());
+			_point_chunk_vertices.push_back(-1);
+		}
+		
+		CRAG_VERIFY_OP(point.vertex_index, <, static_cast<int>(_point_normals.size()));
+		_point_normals[point.vertex_index] += normal;
+	};
+	
+	add_corner(a);
+	add_corner(b);
+	add_corner(c);
+}
+
+// Faces in neighboring chunks change the normals of points on the boundary.
+void Mesh::UpdateChunkNormals(int chunk_index, Serial serial)
+{
+	ASSERT(_chunk_index == -1);
+	
+	auto & chunk = _chunks[chunk_index];
+	auto & vertices = chunk.mesh.GetVertices();
+	auto is_changed = false;
+	auto num_vertices = vertices.size();
+	for (auto index = decltype(num_vertices)(0); index != num_vertices; ++ index)
+	{
+		auto norm = GetPointNormal(* chunk.points[index]);
+		if (norm != vertices[index].norm)
+		{
+			vertices[index].norm = norm;
+			is_changed = true;
+		}
+	}
+	
+	if (is_changed)
+	{
+		chunk.serial = serial;
+	}
+}
+
+void Mesh::BeginChunk(int chunk_index, int num_nodes, Serial serial)
+{
+	ASSERT(_chunk_index == -1);
+	CRAG_VERIFY_OP(chunk_index, >=, 0);
+	CRAG_VERIFY_OP(chunk_index, <, GetNumChunks());
+	CRAG_VERIFY_OP(num_nodes, <=, num_nodes_per_chunk);
+	
+	_chunk_index = chunk_index;
+	
+	auto & chunk = _chunks[chunk_index];
+	chunk.mesh.clear();
+	chunk.points.clear();
+	chunk.serial = serial;
+	chunk.num_nodes = num_nodes;
+}
+
+// Points record the vertex of the latest chunk to use them; points which were
+// last given a vertex in a preceding chunk are given another in this chunk.
+void Mesh::AddIndexedFace(Point & a, Point & b, Point & c)
+{
+	ASSERT(_is_indexed);
+	ASSERT(_chunk_index != -1);
+	
+	auto & chunk = _chunks[_chunk_index];
+	auto & vertices = chunk.mesh.GetVertices();
+	auto & indices = chunk.mesh.GetIndices();
+	auto vertex_base = _chunk_index * int(max_num_verts_per_chunk);
+
+	auto add_corner = [&] (Point & point)
+	{
+		CRAG_VERIFY_OP(point.vertex_index, >=, 0);
+		CRAG_VERIFY_OP(point.vertex_index, <, static_cast<int>(_point_chunk_vertices.size()));
+		auto & chunk_vertex = _point_chunk_vertices[point.vertex_index];
+		if (chunk_vertex < vertex_base)
+		{
+			auto num_vertices = static_cast<int>(vertices.size());
+			CRAG_VERIFY_OP(num_vertices, <, max_num_verts_per_chunk);
+			chunk_vertex = vertex_base + num_vertices;
+			
+			vertices.push_back({ point.pos, GetPointNormal(point) });
+			chunk.points.push_back(& point);
+		}
+		
+		auto index = chunk_vertex - vertex_base;
+		CRAG_VERIFY_OP(index, <, static_cast<int>(vertices.size()));
+		ASSERT(point.pos == vertices[index].pos);
+		
+		indices.push_back(static_cast<gfx::ElementIndex>(index));
+	};
+
+	add_corner(a);
+	add_corner(b);
+	add_corner(c);
+}
+
+void Mesh::EndChunk()
+{
+	ASSERT(_chunk_index != -1);
+	
+	_chunk_index = -1;
+}
+
+gfx::TerrainVertex::Normal Mesh::GetPointNormal(Point const & point) const
+{
+	CRAG_VERIFY_OP(point.vertex_index, >=, 0);
+	CRAG_VERIFY_OP(point.vertex_index, <, static_cast<int>(_point_normals.size()));
+	return gfx::TerrainVertex::EncodeNormal(geom::Normalized(_point_normals[point.vertex_index]));
+}
+
 MeshProperties & Mesh::GetProperties()
 {
 	return properties;
@@ -61,14 +330,17 @@ MeshProperties const & Mesh::GetProperties() const
 #if ! defined(CRAG_FORM_FLAT_SHADE)
 Mesh::Vertex & Mesh::GetVertex(Point & point, Color color)
 {
-	if (point.vert == nullptr)
+	auto & vertices = _lit_mesh.GetVertices();
+	if (point.vertex_index == -1)
 	{
-		point.vert = & AddVertex(point, color);
+		AddVertex(point, color);
+		point.vertex_index = static_cast<int>(vertices.size()) - 1;
 	}
 	
-	ASSERT(point.pos == point.vert->pos);
+	auto & vertex = vertices[point.vertex_index];
+	ASSERT(point.pos == vertex.pos);
 	
-	return * point.vert;
+	return vertex;
 }
 
 Mesh::Vertex & Mesh::AddVertex(Point const & p, Color color)
@@ -128,14 +400,25 @@ void Mesh::AddFace(Point const & a, Point const & b, Point const & c, Vertex::Ve
 {
 	auto add_face = [&] (Point const & p)
 	{
-		_lit_mesh.push_back({ 
+		Vertex vertex =
+		{ 
 			p.pos, 
 			normal,
 			gfx::Color4b(color.r,
 						 color.g,
 						 color.b,
 						 color.a)
-		});
+		};
+		
+		if (_slot_vertex_index == -1)
+		{
+			_lit_mesh.push_back(vertex);
+		}
+		else
+		{
+			ASSERT(_slot_vertex_index < _slot_vertex_end);
+			_lit_mesh[_slot_vertex_index ++] = vertex;
+		}
 	};
 	
 	add_face(a);
@@ -143,6 +426,28 @@ void Mesh::AddFace(Point const & a, Point const & b, Point const & c, Vertex::Ve
 	add_face(c);
 }
 
+void Mesh::ResizeFaces(int num_faces)
+{
+	ASSERT(! _is_patching);
+	_lit_mesh.resize(num_faces * 3);
+}
+
+void Mesh::SetFace(int face_index, Point const & a, Point const & b, Point const & c, Vertex::Vector3 const & normal, gfx::Color4b color)
+{
+	CRAG_VERIFY_OP(face_index * 3 + 3, <=, GetNumVertices());
+	
+	auto vertex = & _lit_mesh[face_index * 3];
+	auto set_vertex = [&] (Point const & p)
+	{
+		* vertex = { p.pos, normal, color };
+		++ vertex;
+	};
+	
+	set_vertex(a);
+	set_vertex(b);
+	set_vertex(c);
+}
+
 #endif
 
 Mesh::LitMesh const & Mesh::GetLitMesh() const
@@ -154,6 +459,13 @@ CRAG_VERIFY_INVARIANTS_DEFINE_BEGIN(Mesh, self)
 #if ! defined(CRAG_FORM_FLAT_SHADE)
 	CRAG_VERIFY(self._lit_mesh);
 #endif
+	for (auto & chunk : self._chunks)
+	{
+		CRAG_VERIFY(chunk.mesh);
+		CRAG_VERIFY_EQUAL(chunk.points.size(), chunk.mesh.GetVertices().size());
+		CRAG_VERIFY_OP(chunk.mesh.GetVertices().size(), <=, std::size_t(max_num_verts_per_chunk));
+	}
+	CRAG_VERIFY_EQUAL(self._point_chunk_vertices.size(), self._point_normals.size());
 
 	for (auto & vertex : self._lit_mesh)
 	{
@@ -14,6 +14,9 @@
 
 #include "gfx/Mesh.h"
 #include "gfx/LitVertex.h"
+#include "gfx/TerrainVertex.h"
+
+#include "smp/TripleBuffer.h"
 
 // activates flat-shaded mesh style by adding exta vertices with common normals
 #define CRAG_FORM_FLAT_SHADE
@@ -36,11 +39,82 @@ namespace form
 		typedef gfx::LitMesh LitMesh;
 #endif
 		typedef Vertex::Color Color;
+		typedef gfx::TerrainMesh TerrainMesh;
+		
+		// patching-related types
+		using Serial = std::uint32_t;
+		using VertexRange = std::pair<int, int>;	// [first, second)
+		using VertexRangeArray = std::vector<VertexRange>;
+		
+		// constants
+		enum
+		{
+			max_num_faces_per_slot = 4,
+			num_verts_per_slot = max_num_faces_per_slot * 3,
+			
+			// a leaf node's faces are formed from its 3 corners and 3 mid-points
+			num_nodes_per_chunk = 8192,
+			max_num_verts_per_chunk = num_nodes_per_chunk * 6
+		};
 		
 		// functions
 		void Reserve(int max_num_verts, int max_num_tris);
 		void Clear();
 		void NormalizeNormals();
+		void NormalizeNormals(int vertex_begin, int vertex_end);
+		int GetNumVertices() const;
+		
+		// Patching: each node is given a fixed slot of vertices, so that
+		// the mesh can be brought up to date by rewriting only the slots
+		// of nodes which changed since the mesh was last generated.
+		void EnablePatching(int max_num_slots);
+		bool IsPatching() const;
+		
+		// begins a patch which brings the mesh up to date with serial;
+		// returns the serial of the previous patch or zero if all slots must be written
+		Serial BeginPatch(int num_slots, Serial serial);
+		
+		// faces added between these calls are written to the given slot
+		void BeginSlot(int slot_index);
+		void EndSlot();
+		
+		// the serial of the state which the mesh represents
+		Serial GetSerial() const;
+		
+		// the serial of the state which this patch was applied to, or zero
+		Serial GetBaseSerial() const;
+		
+		// ranges of vertices rewritten by the latest patch
+		VertexRangeArray const & GetDirtyRanges() const;
+		
+		// Indexing: faces share the vertices of their common points and vertices
+		// are stored in the compact TerrainVertex format. The mesh is divided into
+		// chunks, each holding the faces of a fixed range of nodes, so that no chunk
+		// exceeds the limits of ElementIndex and unchanged chunks can be kept.
+		// A point on the boundary between chunks has a vertex in each but the
+		// normals of all faces of the mesh are summed first so that they match.
+		void EnableIndexing();
+		bool IsIndexed() const;
+		
+		int GetNumChunks() const;
+		TerrainMesh const & GetChunk(int chunk_index) const;
+		
+		// the number of nodes and the serial of the state which the chunk represents
+		int GetChunkNumNodes(int chunk_index) const;
+		Serial GetChunkSerial(int chunk_index) const;
+		
+		// begins an update of the indexed mesh; every face of the mesh
+		// is then passed to AddPointNormals before any chunk is begun
+		void BeginIndexedMesh(int num_chunks);
+		void AddPointNormals(Point & a, Point & b, Point & c, Vertex::Vector3 const & normal);
+		
+		// brings the normals of a chunk whose faces are unchanged up to date
+		void UpdateChunkNormals(int chunk_index, Serial serial);
+		
+		// faces added between these calls replace the contents of the given chunk
+		void BeginChunk(int chunk_index, int num_nodes, Serial serial);
+		void AddIndexedFace(Point & a, Point & b, Point & c);
+		void EndChunk();
 		
 		MeshProperties & GetProperties();
 		MeshProperties const & GetProperties() const;
@@ -55,16 +129,49 @@ namespace form
 		void AddFace(Point & a, Point & b, Point & c, Vertex::Vector3 const & normal, gfx::Color4b color);
 #else
 		void AddFace(Point const & a, Point const & b, Point const & c, Vertex::Vector3 const & normal, gfx::Color4b color);
+		
+		// random access to faces; allows disjoint ranges to be written concurrently
+		void ResizeFaces(int num_faces);
+		void SetFace(int face_index, Point const & a, Point const & b, Point const & c, Vertex::Vector3 const & normal, gfx::Color4b color);
 #endif
 
 		LitMesh const & GetLitMesh() const;
 		
 		CRAG_VERIFY_INVARIANTS_DECLARE(Mesh);
 		
-		// variables
 	private:
+		struct Chunk
+		{
+			TerrainMesh mesh;
+			std::vector<Point const *> points;	// the point of each vertex
+			Serial serial = 0;
+			int num_nodes = 0;
+		};
+		
+		gfx::TerrainVertex::Normal GetPointNormal(Point const & point) const;
+		
+		// variables
 		LitMesh _lit_mesh;
 		MeshProperties properties;
+		
+		// indexing
+		bool _is_indexed = false;
+		std::vector<Chunk> _chunks;
+		int _chunk_index = -1;
+		
+		// indexed by Point::vertex_index
+		std::vector<Vertex::Vector3> _point_normals;	// unnormalized sums of face normals
+		std::vector<int> _point_chunk_vertices;	// vertex in the latest chunk to use the point
+		
+		// patching
+		bool _is_patching = false;
+		Serial _serial = 0;
+		Serial _base_serial = 0;
+		VertexRangeArray _dirty_ranges;
+		int _slot_vertex_index = -1;
+		int _slot_vertex_end = -1;
 	};
 	
+	// hands meshes from form::Engine to gfx::Surrounding
+	using MeshBuffer = smp::TripleBuffer<Mesh>;
 }
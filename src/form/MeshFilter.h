@@ -0,0 +1,81 @@
+//
+//  form/MeshFilter.h
+//  crag
+//
+//  Created on 2026-10-18.
+//  This program is distributed under the terms of the GNU General Public License.
+//
+
+#pragma once
+
+#include "defs.h"
+
+namespace form
+{
+	// Selects the faces of a mesh which may be seen by a single observer,
+	// e.g. one of several viewpoints sharing a Surrounding; a face is kept if
+	// its front faces the observer and, optionally, it touches a view cone.
+	// Positions are relative to the same space as the nodes. Hidden faces may
+	// still cast shadows onto visible ones, so a filtered mesh is no good for
+	// generating shadow volumes.
+	class MeshFilter
+	{
+	public:
+		// keeps faces whose fronts face position
+		explicit MeshFilter(Vector3 const & position)
+		: _position(position)
+		, _direction(Vector3::Zero())
+		, _cos_half_angle(-1)
+		, _sin_half_angle(0)
+		{
+		}
+
+		// also discards faces outside the cone from position along direction,
+		// which must be a unit vector; half_angle is in radians
+		MeshFilter(Vector3 const & position, Vector3 const & direction, Scalar half_angle)
+		: _position(position)
+		, _direction(direction)
+		, _cos_half_angle(std::cos(half_angle))
+		, _sin_half_angle(std::sin(half_angle))
+		{
+			CRAG_VERIFY_UNIT(direction, .0001f);
+			ASSERT(half_angle >= 0);
+		}
+
+		Vector3 const & GetPosition() const
+		{
+			return _position;
+		}
+
+		// true iff the face with corners a, b and c and the given normal is kept
+		bool Includes(Vector3 const & a, Vector3 const & b, Vector3 const & c, geom::Vector3f const & normal) const
+		{
+			// back-facing
+			if (DotProduct(normal, _position - a) <= 0)
+			{
+				return false;
+			}
+
+			if (_cos_half_angle <= -1)
+			{
+				return true;
+			}
+
+			// conservatively, the face's bounding sphere is tested against the cone
+			auto center = (a + b + c) / Scalar(3);
+			auto radius_squared = std::max(std::max(DistanceSq(center, a), DistanceSq(center, b)), DistanceSq(center, c));
+
+			auto to_center = center - _position;
+			auto axial_distance = DotProduct(to_center, _direction);
+			auto radial_distance = std::sqrt(std::max(MagnitudeSq(to_center) - Squared(axial_distance), Scalar(0)));
+			auto distance_from_cone = radial_distance * _cos_half_angle - axial_distance * _sin_half_angle;
+			return distance_from_cone <= 0 || Squared(distance_from_cone) <= radius_squared;
+		}
+
+	private:
+		Vector3 _position;
+		Vector3 _direction;
+		Scalar _cos_half_angle;
+		Scalar _sin_half_angle;
+	};
+}
@@ -0,0 +1,342 @@
+//
+//  form/MidPointCache.cpp
+//  crag
+//
+//  Created on 2026-10-18.
+//  This program is distributed under the terms of the GNU General Public License.
+//
+
+#include "pch.h"
+
+#include "MidPointCache.h"
+
+#include "core/app.h"
+
+#if defined(CRAG_OS_WINDOWS) || defined(CRAG_OS_PNACL)
+#define CRAG_FORM_MID_POINT_CACHE_UNSUPPORTED
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace form;
+
+namespace
+{
+	constexpr std::uint32_t magic = 0x63506d4d;	// "MmPc"
+	constexpr std::uint32_t version = 4;
+	constexpr MidPointCache::Key empty_key = 0;
+	
+	// marks an entry whose position is still being written
+	constexpr MidPointCache::Key busy_key = ~ MidPointCache::Key(0);
+	
+	// the number of buckets, starting with its own, in which a key may be stored;
+	// bounds the cost of a search and, once they are all taken, one is evicted
+	constexpr int probe_length = 8;
+	static_assert((probe_length & (probe_length - 1)) == 0, "probe_length must be a power of two");
+	
+	// the direction of a mid-point is quantized to a grid whose spacing is
+	// a fraction of the length of an edge at the given depth; mid-points
+	// of different edges at the same depth fall in different cells
+	constexpr int direction_precision_bits = 4;
+	constexpr int max_direction_bits = 48;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// form::MidPointCache::Header / Entry
+
+struct MidPointCache::Header
+{
+	std::uint32_t magic;
+	std::uint32_t version;
+	Signature signature;
+	std::uint64_t capacity;
+	std::atomic<std::uint64_t> size;
+};
+
+// an entry's position may be overwritten while it is read; a reader checks
+// that the key is unchanged once it has read the position
+struct MidPointCache::Entry
+{
+	std::atomic<Key> key;
+	std::atomic<double> position[3];
+};
+
+static_assert(sizeof(std::atomic<MidPointCache::Key>) == sizeof(MidPointCache::Key), "cache file layout depends on atomic size");
+static_assert(sizeof(std::atomic<double>) == sizeof(double), "cache file layout depends on atomic size");
+
+////////////////////////////////////////////////////////////////////////////////
+// form::MidPointCache member definitions
+
+MidPointCache::MidPointCache(std::string const & filename, Signature signature, int capacity)
+{
+	ASSERT(capacity > 0);
+
+	std::uint64_t rounded_capacity = 1;
+	auto bucket_shift = 64;
+	while (rounded_capacity < std::uint64_t(capacity))
+	{
+		rounded_capacity <<= 1;
+		-- bucket_shift;
+	}
+
+#if defined(CRAG_FORM_MID_POINT_CACHE_UNSUPPORTED)
+	CRAG_UNUSED(filename);
+	CRAG_UNUSED(signature);
+	CRAG_UNUSED(rounded_capacity);
+	CRAG_UNUSED(bucket_shift);
+#else
+	auto mapping_size = sizeof(Header) + sizeof(Entry) * rounded_capacity;
+	void * mapping;
+	if (filename.empty())
+	{
+		mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (mapping == MAP_FAILED)
+		{
+			DEBUG_MESSAGE("failed to allocate mid-point cache; errno=%d", errno);
+			return;
+		}
+	}
+	else
+	{
+		auto path = app::GetStatePath(filename);
+		auto file = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+		if (file == -1)
+		{
+			DEBUG_MESSAGE("failed to open mid-point cache, %s; errno=%d", path.c_str(), errno);
+			return;
+		}
+
+		if (ftruncate(file, mapping_size) != 0)
+		{
+			DEBUG_MESSAGE("failed to resize mid-point cache, %s; errno=%d", path.c_str(), errno);
+			close(file);
+			return;
+		}
+
+		mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+		close(file);
+		if (mapping == MAP_FAILED)
+		{
+			DEBUG_MESSAGE("failed to map mid-point cache, %s; errno=%d", path.c_str(), errno);
+			return;
+		}
+	}
+
+	_mapping = mapping;
+	_mapping_size = mapping_size;
+	_header = static_cast<Header *>(mapping);
+	_entries = reinterpret_cast<Entry *>(_header + 1);
+	_bucket_shift = bucket_shift;
+
+	// a new file is zero-filled and so is already empty apart from its header;
+	// a file written with different parameters must be cleared
+	if (_header->magic != magic
+		|| _header->version != version
+		|| _header->signature != signature
+		|| _header->capacity != rounded_capacity
+		|| _header->size > rounded_capacity)
+	{
+		std::for_each(_entries, _entries + rounded_capacity, [] (Entry & entry)
+		{
+			entry.key.store(empty_key, std::memory_order_relaxed);
+			for (auto & component : entry.position)
+			{
+				component.store(0., std::memory_order_relaxed);
+			}
+		});
+
+		_header->magic = magic;
+		_header->version = version;
+		_header->signature = signature;
+		_header->capacity = rounded_capacity;
+		_header->size = 0;
+	}
+#endif
+
+	CRAG_VERIFY(* this);
+}
+
+MidPointCache::~MidPointCache()
+{
+	CRAG_VERIFY(* this);
+
+#if ! defined(CRAG_FORM_MID_POINT_CACHE_UNSUPPORTED)
+	if (_mapping)
+	{
+		munmap(_mapping, _mapping_size);
+	}
+#endif
+}
+
+CRAG_VERIFY_INVARIANTS_DEFINE_BEGIN(MidPointCache, self)
+	CRAG_VERIFY_EQUAL(self._mapping == nullptr, self._header == nullptr);
+	if (self._header)
+	{
+		CRAG_VERIFY_EQUAL(self._header->magic, magic);
+		CRAG_VERIFY_FALSE(self._header->capacity & (self._header->capacity - 1));
+		CRAG_VERIFY_OP(self._header->size, <=, self._header->capacity);
+		CRAG_VERIFY_EQUAL(self._mapping_size, sizeof(Header) + sizeof(Entry) * self._header->capacity);
+		CRAG_VERIFY_EQUAL(self._header->capacity, std::uint64_t(1) << (64 - self._bucket_shift));
+	}
+CRAG_VERIFY_INVARIANTS_DEFINE_END
+
+bool MidPointCache::IsOpen() const
+{
+	return _header != nullptr;
+}
+
+int MidPointCache::GetSize() const
+{
+	return _header ? static_cast<int>(_header->size.load(std::memory_order_relaxed)) : 0;
+}
+
+MidPointCache::Key MidPointCache::MakeKey(Vector3 const & end_1, Vector3 const & end_2, int depth, int seed_1, int seed_2)
+{
+	ASSERT(depth >= 0);
+	
+	auto direction = end_1 + end_2;
+	auto length = Magnitude(direction);
+	auto scale = (length > 0) ? std::ldexp(1., std::min(depth + direction_precision_bits, max_direction_bits)) / length : 0.;
+	
+	std::int64_t location[4] =
+	{
+		std::llround(direction.x * scale),
+		std::llround(direction.y * scale),
+		std::llround(direction.z * scale),
+		depth
+	};
+	
+	std::uint32_t seeds[2] =
+	{
+		static_cast<std::uint32_t>(std::min(seed_1, seed_2)),
+		static_cast<std::uint32_t>(std::max(seed_1, seed_2))
+	};
+	
+	auto key = CombineSignature(CombineSignature(initial_signature, location), seeds);
+
+	// zero and all-ones are reserved
+	return (key == empty_key || key == busy_key) ? 1 : key;
+}
+
+// FNV-1a
+MidPointCache::Signature MidPointCache::CombineSignature(Signature signature, void const * data, std::size_t num_bytes)
+{
+	auto bytes = static_cast<std::uint8_t const *>(data);
+	for (auto end = bytes + num_bytes; bytes != end; ++ bytes)
+	{
+		signature ^= * bytes;
+		signature *= 0x100000001b3;
+	}
+
+	return signature;
+}
+
+bool MidPointCache::Find(Key key, Vector3 & position) const
+{
+	ASSERT(key != empty_key);
+
+	if (! _header)
+	{
+		return false;
+	}
+
+	auto mask = _header->capacity - 1;
+	auto home_bucket = GetBucket(key);
+	for (auto probe = 0; probe != probe_length; ++ probe)
+	{
+		auto const & entry = _entries[(home_bucket + probe) & mask];
+		auto entry_key = entry.key.load(std::memory_order_acquire);
+		if (entry_key == key)
+		{
+			Vector3 entry_position(
+				entry.position[0].load(std::memory_order_relaxed),
+				entry.position[1].load(std::memory_order_relaxed),
+				entry.position[2].load(std::memory_order_relaxed));
+
+			// the entry may have been evicted while its position was read
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (entry.key.load(std::memory_order_relaxed) != key)
+			{
+				return false;
+			}
+
+			position = entry_position;
+			return true;
+		}
+
+		// entries are never emptied, so the key cannot be further on
+		if (entry_key == empty_key)
+		{
+			return false;
+		}
+	}
+
+	return false;
+}
+
+void MidPointCache::Insert(Key key, Vector3 const & position)
+{
+	ASSERT(key != empty_key);
+
+	if (! _header)
+	{
+		return;
+	}
+
+	// claims the given entry, whose key is expected, and writes key and position to it
+	auto write = [&] (Entry & entry, Key expected_key)
+	{
+		if (! entry.key.compare_exchange_strong(expected_key, busy_key, std::memory_order_relaxed))
+		{
+			return false;
+		}
+
+		// the key is published once the position is written
+		std::atomic_thread_fence(std::memory_order_release);
+		entry.position[0].store(position.x, std::memory_order_relaxed);
+		entry.position[1].store(position.y, std::memory_order_relaxed);
+		entry.position[2].store(position.z, std::memory_order_relaxed);
+		entry.key.store(key, std::memory_order_release);
+		return true;
+	};
+
+	auto mask = _header->capacity - 1;
+	auto home_bucket = GetBucket(key);
+	for (auto probe = 0; probe != probe_length; ++ probe)
+	{
+		auto & entry = _entries[(home_bucket + probe) & mask];
+		auto entry_key = entry.key.load(std::memory_order_acquire);
+		if (entry_key == empty_key && write(entry, empty_key))
+		{
+			_header->size.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		if (entry_key == key)
+		{
+			return;
+		}
+	}
+
+	// every bucket in the run is taken; the key chooses which to evict
+	auto & victim = _entries[(home_bucket + (key & (probe_length - 1))) & mask];
+	auto victim_key = victim.key.load(std::memory_order_relaxed);
+	if (victim_key != busy_key)
+	{
+		// if another thread got there first, the position is not stored
+		write(victim, victim_key);
+	}
+}
+
+// Fibonacci hashing; takes the high bits of the product
+std::size_t MidPointCache::GetBucket(Key key) const
+{
+	if (_bucket_shift == 64)
+	{
+		return 0;
+	}
+	
+	return static_cast<std::size_t>((key * 0x9e3779b97f4a7c15) >> _bucket_shift);
+}
@@ -0,0 +1,94 @@
+//
+//  form/MidPointCache.h
+//  crag
+//
+//  Created on 2026-10-18.
+//  This program is distributed under the terms of the GNU General Public License.
+//
+
+#pragma once
+
+#include "geom/Space.h"
+
+namespace form
+{
+	// A persistent table of mid-point positions belonging to a single Formation;
+	// positions are stored relative to the center of the formation so they
+	// remain valid when the origin changes and between sessions. The table is
+	// a memory-mapped file of fixed capacity using open addressing; a key is
+	// only stored within a short run of buckets from its own and, once that
+	// run is full, inserting the key evicts one of the entries in it.
+	// Find and Insert may be called concurrently, e.g. by the scenes of the
+	// form and sim threads, which share the cache of each formation;
+	// a key inserted by two threads at once may occupy two entries.
+	class MidPointCache
+	{
+		OBJECT_NO_COPY(MidPointCache);
+
+	public:
+		////////////////////////////////////////////////////////////////////////////////
+		// types
+
+		// identifies a mid-point; derived from its location and the seeds which generate it
+		using Key = std::uint64_t;
+
+		// identifies the shader parameters used to generate the positions;
+		// if it differs from that of the file, the file is cleared
+		using Signature = std::uint64_t;
+		static constexpr Signature initial_signature = 0xcbf29ce484222325;
+
+		using Vector3 = geom::uni::Vector3;
+
+		////////////////////////////////////////////////////////////////////////////////
+		// functions
+
+		// capacity is rounded up to a power of two;
+		// if filename is empty, the table is kept in memory only
+		MidPointCache(std::string const & filename, Signature signature, int capacity);
+		~MidPointCache();
+
+		CRAG_VERIFY_INVARIANTS_DECLARE(MidPointCache);
+
+		// false if the file could not be opened or mapped
+		bool IsOpen() const;
+
+		int GetSize() const;
+
+		// the key of the mid-point of the edge between two points relative to
+		// the center of the formation; the seeds alone are too few to tell
+		// every edge apart; the result is the same regardless of the order of
+		// the points and of the seeds
+		static Key MakeKey(Vector3 const & end_1, Vector3 const & end_2, int depth, int seed_1, int seed_2);
+
+		static Signature CombineSignature(Signature signature, void const * data, std::size_t num_bytes);
+
+		template <typename VALUE>
+		static Signature CombineSignature(Signature signature, VALUE const & value)
+		{
+			return CombineSignature(signature, & value, sizeof(value));
+		}
+
+		// returns true and sets position iff key was found
+		bool Find(Key key, Vector3 & position) const;
+
+		// has no effect if key is already present;
+		// may evict another key which hashes to nearby buckets
+		void Insert(Key key, Vector3 const & position);
+
+	private:
+		struct Header;
+		struct Entry;
+
+		std::size_t GetBucket(Key key) const;
+
+		////////////////////////////////////////////////////////////////////////////////
+		// variables
+
+		void * _mapping = nullptr;
+		std::size_t _mapping_size = 0;
+
+		Header * _header = nullptr;
+		Entry * _entries = nullptr;
+		int _bucket_shift = 64;
+	};
+}
@@ -21,41 +21,28 @@
 
 using namespace form;
 
-////////////////////////////////////////////////////////////////////////////////
-// Triplet
-
-form::Node::Triplet::Triplet()
-: corner (nullptr)
-, mid_point (nullptr)
-, cousin (nullptr)
-{
-}
-
-form::Node::Triplet::~Triplet()
-{
-	//ASSERT(corner == nullptr);	// fails on account of the nodes scoped in NodeBuffer::ExpandNode
-	ASSERT(mid_point == nullptr);
-	ASSERT(cousin == nullptr);
-}
-
-
 ////////////////////////////////////////////////////////////////////////////////
 // Node
 
-form::Node::Node()
-: _children (nullptr)
-, _owner ()
-, seed (0)
-, score (0)
+#if defined(CRAG_FORM_COMPACT_NODES)
+form::Node & form::Node::operator=(Node const & rhs)
 {
-	CRAG_VERIFY(* this);
-}
-
-form::Node::~Node()
-{
-	ASSERT(GetChildren() == nullptr);
-	ASSERT(_owner == nullptr);
+	ASSERT(& GetContext() == & rhs.GetContext());
+	
+	_children = rhs._children;
+	_parent = rhs._parent;
+	seed = rhs.seed;
+	depth = rhs.depth;
+	std::copy(std::begin(rhs._triple), std::end(rhs._triple), _triple);
+	
+	SetCenter(rhs.GetCenter());
+	SetArea(rhs.GetArea());
+	SetNormal(rhs.GetNormal());
+	SetScore(rhs.GetScore());
+	
+	return * this;
 }
+#endif
 
 // Makes sure node's three mid-points are non-null or returns false.
 bool form::Node::InitMidPoints(Polyhedron & polyhedron, PointBuffer & point_buffer)
@@ -69,11 +56,10 @@ bool form::Node::InitMidPoints(Polyhedron & polyhedron, PointBuffer & point_buff
 	for (int triplet_index = 0; triplet_index < 3; ++ triplet_index)
 	{
 		// If the mid-point does not already exist,
-		Node::Triplet & t = triple[triplet_index];
-		if (t.mid_point == nullptr)
+		if (GetMidPoint(triplet_index) == nullptr)
 		{
 			// This function shouldn't be called unless all three cousins exist.
-			Node & cousin = ref(t.cousin);
+			Node & cousin = ref(GetCousin(triplet_index));
 
 			// Create the mid-point.
 			Point * new_point = point_buffer.Create();
@@ -87,7 +73,7 @@ bool form::Node::InitMidPoints(Polyhedron & polyhedron, PointBuffer & point_buff
 			}
 
 			// Try and set its value.
-			if (! shader.InitMidPoint(polyhedron, ref(this), ref(t.cousin), triplet_index, ref(new_point)))
+			if (! shader.InitMidPoint(polyhedron, ref(this), cousin, triplet_index, ref(new_point)))
 			{
 				// If this failed, free it up and return.
 				
@@ -107,69 +93,117 @@ bool form::Node::InitMidPoints(Polyhedron & polyhedron, PointBuffer & point_buff
 			// The mid-point was successfully allocated and initialized.
 			
 			// Assign the mid-point to this node and the cousin.
-			t.mid_point = cousin.triple[triplet_index].mid_point = new_point;
+			SetMidPoint(triplet_index, new_point);
+			cousin.SetMidPoint(triplet_index, new_point);
 		}
 	}
 	
 	return success;
 }
 
-// This step in the initialization of a node is performed 
-// before it is determined that the node can be expanded.
-bool form::Node::InitChildCorners(Node const & parent, Node * children)
+// Like InitMidPoints except that the new mid-points are calculated later.
+bool form::Node::RequestMidPoints(Polyhedron & polyhedron, PointBuffer & point_buffer, MidPointRequestVector & requests)
 {
-	ASSERT(parent.GetChildren() == nullptr);
-	
-	Node::Triplet const * parent_triple = parent.triple;
-	
-	Node * child = children;
-	Node::Triplet * child_triple;
-	
-	child_triple = child->triple;
-	child_triple[0].corner = parent_triple[0].corner;
-	child_triple[1].corner = parent_triple[2].mid_point;
-	child_triple[2].corner = parent_triple[1].mid_point;
-	if (! child->InitScoreParameters())
+	for (int triplet_index = 0; triplet_index < 3; ++ triplet_index)
 	{
-		return false;
+		if (GetMidPoint(triplet_index) != nullptr)
+		{
+			continue;
+		}
+		
+		Point * new_point = point_buffer.Create();
+		if (new_point == nullptr)
+		{
+			return false;
+		}
+		
+		Node & cousin = ref(GetCousin(triplet_index));
+		SetMidPoint(triplet_index, new_point);
+		cousin.SetMidPoint(triplet_index, new_point);
+		
+		requests.push_back(MidPointRequest { & polyhedron, this, & cousin, triplet_index, new_point, false });
 	}
 	
-	++ child;
+	return true;
+}
+
+void form::Node::FulfillMidPointRequests(MidPointRequestVector & requests, PointBuffer & point_buffer)
+{
+	std::sort(std::begin(requests), std::end(requests), [] (MidPointRequest const & lhs, MidPointRequest const & rhs)
+	{
+		return lhs.polyhedron < rhs.polyhedron;
+	});
 	
-	child_triple = child->triple;
-	child_triple[0].corner = parent_triple[2].mid_point;
-	child_triple[1].corner = parent_triple[1].corner;
-	child_triple[2].corner = parent_triple[0].mid_point;
-	if (! child->InitScoreParameters())
+	auto requests_begin = requests.data();
+	auto requests_end = requests_begin + requests.size();
+	for (auto batch_begin = requests_begin; batch_begin != requests_end; )
 	{
-		return false;
+		auto & polyhedron = ref(batch_begin->polyhedron);
+		auto batch_end = std::find_if(batch_begin, requests_end, [& polyhedron] (MidPointRequest const & request)
+		{
+			return request.polyhedron != & polyhedron;
+		});
+		
+		Shader const & shader = polyhedron.GetFormation().GetShader();
+		shader.InitMidPoints(polyhedron, batch_begin, batch_end);
+		
+		batch_begin = batch_end;
 	}
 	
-	++ child;
+	// as in InitMidPoints, failed mid-points are removed;
+	// the nodes were mutable when they made their requests
+	for (auto & request : requests)
+	{
+		if (! request.result)
+		{
+			const_cast<Node *>(request.a)->SetMidPoint(request.index, nullptr);
+			const_cast<Node *>(request.b)->SetMidPoint(request.index, nullptr);
+			point_buffer.Destroy(request.mid_point);
+		}
+	}
+}
+
+// This step in the initialization of a node is performed 
+// before it is determined that the node can be expanded.
+bool form::Node::CanInitChildCorners(Node const & parent)
+{
+	ASSERT(parent.GetChildren() == nullptr);
 	
-	child_triple = child->triple;
-	child_triple[0].corner = parent_triple[1].mid_point;
-	child_triple[1].corner = parent_triple[0].mid_point;
-	child_triple[2].corner = parent_triple[2].corner;
-	if (! child->InitScoreParameters())
+	for (auto child_index = 0; child_index != 4; ++ child_index)
 	{
-		return false;
+		Point * child_corners[3];
+		parent.GetChildCorners(child_index, child_corners);
+		
+		Triangle3 surface(child_corners[0]->pos, child_corners[1]->pos, child_corners[2]->pos);
+		if (geom::Area(surface) == 0)
+		{
+			return false;
+		}
 	}
 	
-	++ child;
+	return true;
+}
+
+void form::Node::InitChildCorners(Node const & parent, Node * children)
+{
+	ASSERT(CanInitChildCorners(parent));
 	
-	child_triple = child->triple;
-	child_triple[0].corner = parent_triple[0].mid_point;
-	child_triple[1].corner = parent_triple[1].mid_point;
-	child_triple[2].corner = parent_triple[2].mid_point;
-	if (! child->InitScoreParameters())
+	for (auto child_index = 0; child_index != 4; ++ child_index)
 	{
-		return false;
+		Point * child_corners[3];
+		parent.GetChildCorners(child_index, child_corners);
+		
+		Node & child = children[child_index];
+		child.SetCorner(0, child_corners[0]);
+		child.SetCorner(1, child_corners[1]);
+		child.SetCorner(2, child_corners[2]);
+		
+		auto initialized = child.InitScoreParameters();
+		ASSERT(initialized);
+		static_cast<void>(initialized);
 	}
 	
-	ASSERT(parent.triple[0].corner == children[0].triple[0].corner);
-	
-	return true;
+	ASSERT(parent.GetCorner(0) == children[0].GetCorner(0));
 }
 
 // This gets called when the local origin is changed.
@@ -181,62 +215,103 @@ void form::Node::Reinit(Polyhedron & polyhedron, PointBuffer & point_buffer)
 	// Make sure all mid-points exist.
 	for (int triplet_index = 0; triplet_index < 3; ++ triplet_index)
 	{
-		Node::Triplet & t = triple[triplet_index];
-		if (t.cousin != nullptr)
+		Node * cousin = GetCousin(triplet_index);
+		Point * mid_point = GetMidPoint(triplet_index);
+		if (cousin != nullptr)
 		{
-			if (t.mid_point != nullptr)
+			if (mid_point != nullptr)
 			{
-				Node & cousin = ref(t.cousin);
-				if (& cousin > this)
+				if (cousin > this)
 				{
-					Point & mid_point = ref(t.mid_point);
-					shader.InitMidPoint(polyhedron, * this, cousin, triplet_index, mid_point);
+					shader.InitMidPoint(polyhedron, * this, * cousin, triplet_index, * mid_point);
 				}
 			}
 		}
 		else 
 		{
-			if (t.mid_point != nullptr)
+			if (mid_point != nullptr && GetChildren() == nullptr)
 			{
 				// There's a mid-point but the cousin used to calculate it has since been destroyed.
 				// There's no easy way to calculate the new position (except maybe delta it).
-				// So just remove it instead.
-				point_buffer.Destroy(t.mid_point);
-				t.mid_point = nullptr;
-				
-				ASSERT(GetChildren() == nullptr);
+				// So just remove it instead - unless it's the corner of a child,
+				// in which case, it keeps the position it was translated to.
+				point_buffer.Destroy(mid_point);
+				SetMidPoint(triplet_index, nullptr);
 			}
 		}
 	}
 	
-	geom::Vector3f const & a = ref(triple[0].corner).pos;
-	geom::Vector3f const & b = ref(triple[1].corner).pos;
-	geom::Vector3f const & c = ref(triple[2].corner).pos;
-	center = (a + b + c) / 3.f;
+	geom::Vector3f const & a = ref(GetCorner(0)).pos;
+	geom::Vector3f const & b = ref(GetCorner(1)).pos;
+	geom::Vector3f const & c = ref(GetCorner(2)).pos;
+	SetCenter((a + b + c) / 3.f);
 }
 
 bool form::Node::InitScoreParameters()
 {
-	Triangle3 surface(ref(triple[0].corner).pos, ref(triple[1].corner).pos, ref(triple[2].corner).pos);
+	Triangle3 surface(ref(GetCorner(0)).pos, ref(GetCorner(1)).pos, ref(GetCorner(2)).pos);
 	
-	normal = geom::UnitNormal(surface);
+	auto normal = geom::UnitNormal(surface);
 	CRAG_VERIFY(normal);
+	SetNormal(normal);
 
-	area = geom::Area(surface);
+	auto area = geom::Area(surface);
+	SetArea(area);
 	if (area == 0) 
 	{
 		return false;
 	}
 	
-	center = geom::Centroid(surface);
+	SetCenter(geom::Centroid(surface));
 	return true;
 }
 
+void form::Node::Clear()
+{
+	_children = NodeLink();
+#if defined(CRAG_FORM_COMPACT_NODES)
+	_parent = NodeLink();
+#else
+	_owner = nullptr;
+#endif
+	seed = 0;
+	depth = 0;
+	std::fill(std::begin(_triple), std::end(_triple), Triplet { PointLink(), PointLink(), NodeLink() });
+	
+	SetCenter(Vector3::Zero());
+	SetArea(0);
+	SetNormal(Vector3::Zero());
+	SetScore(0);
+}
+
+#if defined(CRAG_FORM_COMPACT_NODES)
+void form::Node::SetCenter(Vector3 const & center)
+{
+	auto & score_data = GetContext().score_data;
+	score_data.center[0][_index] = center.x;
+	score_data.center[1][_index] = center.y;
+	score_data.center[2][_index] = center.z;
+}
+
+void form::Node::SetNormal(Vector3 const & normal)
+{
+	auto & score_data = GetContext().score_data;
+	score_data.normal[0][_index] = normal.x;
+	score_data.normal[1][_index] = normal.y;
+	score_data.normal[2][_index] = normal.z;
+}
+#endif
+
 void form::Node::SetChildren(Node * c) 
 { 
 	CRAG_VERIFY(* this);
 
+#if defined(CRAG_FORM_COMPACT_NODES)
+	ASSERT(c == nullptr || ((c - GetBase()) & 3) == 0);
+	_children = c ? Index(((c - GetBase()) >> 2) + 1) : Index();
+#else
 	_children = c;
+#endif
 
 	CRAG_VERIFY(* this);
 }
@@ -244,9 +319,13 @@ void form::Node::SetChildren(Node * c)
 void form::Node::SetParent(Node * parent) 
 { 
 	CRAG_VERIFY(* this);
-	CRAG_VERIFY_EQUAL(_owner.find<Polyhedron>(), nullptr);
+	CRAG_VERIFY_EQUAL(GetPolyhedron(), nullptr);
 
+#if defined(CRAG_FORM_COMPACT_NODES)
+	_parent = ToLink(parent);
+#else
 	_owner = parent; 
+#endif
 
 	CRAG_VERIFY(* this);
 }
@@ -254,24 +333,58 @@ void form::Node::SetParent(Node * parent)
 void form::Node::SetPolyhedron(Polyhedron * polyhedron) 
 { 
 	CRAG_VERIFY(* this);
-	CRAG_VERIFY_EQUAL(_owner.find<Node>(), nullptr);
-
+	CRAG_VERIFY_EQUAL(GetParent(), nullptr);
+
+#if defined(CRAG_FORM_COMPACT_NODES)
+	auto & context = GetContext();
+	auto root_index = static_cast<int>(_index) - context.root_begin;
+	CRAG_VERIFY_OP(root_index, >=, 0);
+	context.polyhedra[root_index] = polyhedron;
+#else
 	_owner = polyhedron; 
+#endif
 
 	CRAG_VERIFY(* this);
 }
 
 void form::Node::SetCousin(int index, Node & cousin)
 {
-	Triplet & this_triplet = triple[index];
-	Triplet & that_triplet = cousin.triple[index];
+	Triplet & this_triplet = _triple[index];
+	Triplet & that_triplet = cousin._triple[index];
+
+	ASSERT((! GetCousin(index) && ! cousin.GetCousin(index)) || (GetCousin(index)->GetCousin(index) == this));
+	ASSERT(! GetMidPoint(index));
+	
+	this_triplet.cousin = ToLink(& cousin);
+	that_triplet.cousin = cousin.ToLink(this);
+	this_triplet.mid_point = ToLink(cousin.GetMidPoint(index));
+}
 
-	ASSERT((this_triplet.cousin == nullptr && that_triplet.cousin == nullptr) || (this_triplet.cousin->triple[index].cousin == this));
-	ASSERT(this_triplet.mid_point == nullptr);
+void form::Node::DetachCousin(int index)
+{
+	Node & cousin = ref(GetCousin(index));
+	ASSERT(cousin.GetCousin(index) == this);
+	ASSERT(cousin.GetMidPoint(index) == GetMidPoint(index));
 	
-	this_triplet.cousin = & cousin;
-	that_triplet.cousin = this;
-	this_triplet.mid_point = that_triplet.mid_point;
+	_triple[index].cousin = NodeLink();
+	_triple[index].mid_point = PointLink();
+	cousin._triple[index].cousin = NodeLink();
+}
+
+void form::Node::RepairCousin(int index)
+{
+	Node & cousin = ref(GetCousin(index));
+	cousin._triple[index].cousin = cousin.ToLink(this);
+}
+
+void form::Node::SetCorner(int index, Point * corner)
+{
+	_triple[index].corner = ToLink(corner);
+}
+
+void form::Node::SetMidPoint(int index, Point * mid_point)
+{
+	_triple[index].mid_point = ToLink(mid_point);
 }
 
 int form::Node::GetChildSeed(int child_index) const
@@ -287,16 +400,16 @@ void form::Node::GetChildCorners(int child_index, Point * child_corners[3]) cons
 		for (int index_offset = 1; index_offset <= 2; ++ index_offset)
 		{
 			Point * & child_corner = child_corners[TriMod(child_index + index_offset)];
-			child_corner = triple[TriMod(child_index + (3 - index_offset))].mid_point;
+			child_corner = const_cast<Point *>(GetMidPoint(TriMod(child_index + (3 - index_offset))));
 		}
 		
-		child_corners[child_index] = triple[child_index].corner;
+		child_corners[child_index] = const_cast<Point *>(GetCorner(child_index));
 	}
 	else
 	{
-		child_corners[0] = triple[0].mid_point;
-		child_corners[1] = triple[1].mid_point;
-		child_corners[2] = triple[2].mid_point;
+		child_corners[0] = const_cast<Point *>(GetMidPoint(0));
+		child_corners[1] = const_cast<Point *>(GetMidPoint(1));
+		child_corners[2] = const_cast<Point *>(GetMidPoint(2));
 	}
 	
 	ASSERT(child_corners[0] != nullptr);
@@ -305,18 +418,20 @@ void form::Node::GetChildCorners(int child_index, Point * child_corners[3]) cons
 }
 
 CRAG_VERIFY_INVARIANTS_DEFINE_BEGIN(Node, self)
-	static_assert(sizeof(Node) == 80 || sizeof(Node) == 128, "Node may not be ideally packed");
+#if defined(CRAG_FORM_COMPACT_NODES)
+	static_assert(sizeof(Node) == 56, "Node may not be ideally packed");
+#else
+	static_assert(sizeof(Node) == 84 || sizeof(Node) == 128, "Node may not be ideally packed");
 	CRAG_VERIFY(self._children);
 	CRAG_VERIFY(self._owner);
+#endif
 
-	auto parent = self._owner.find<Node>();
-	auto polyhedron = self._owner.find<Polyhedron>();
+	auto parent = self.GetParent();
+	auto polyhedron = self.GetPolyhedron();
 	CRAG_VERIFY_OP(! parent, ||, ! polyhedron);
 	
 	if (parent) 
 	{
-		CRAG_VERIFY_FALSE(polyhedron);
-		
 		auto children = parent->GetChildren();
 		if (children)
 		{
@@ -324,24 +439,23 @@ CRAG_VERIFY_INVARIANTS_DEFINE_BEGIN(Node, self)
 			CRAG_VERIFY_EQUAL(children + child_index, & self);
 			CRAG_VERIFY_TRUE(child_index >= 0 && child_index < 4);
 			CRAG_VERIFY_EQUAL(self.seed, parent->GetChildSeed(child_index));
+			CRAG_VERIFY_EQUAL(self.depth, parent->depth + 1);
 
 			for (int i = 0; i < 3; ++ i) 
 			{
-				Node::Triplet const & t = self.triple[i];
-				CRAG_VERIFY_TRUE(t.corner);
+				CRAG_VERIFY_TRUE(self.GetCorner(i));
 	
-				Node const * cousin = t.cousin;
+				Node const * cousin = self.GetCousin(i);
 				if (cousin != nullptr) 
 				{
-					Node::Triplet const & ct = cousin->triple[i];
-					CRAG_VERIFY_EQUAL(t.mid_point, ct.mid_point);
-					CRAG_VERIFY_EQUAL(ct.cousin, & self);
+					CRAG_VERIFY_EQUAL(self.GetMidPoint(i), cousin->GetMidPoint(i));
+					CRAG_VERIFY_EQUAL(cousin->GetCousin(i), & self);
 				}
 			}
 
-			CRAG_VERIFY_OP(self.area, >, 0);
-			CRAG_VERIFY_NEARLY_EQUAL(MagnitudeSq(self.normal), 1.f, .001f);
-			CRAG_VERIFY_OP(self.score, >=, 0);
+			CRAG_VERIFY_OP(self.GetArea(), >, 0);
+			CRAG_VERIFY_NEARLY_EQUAL(MagnitudeSq(self.GetNormal()), 1.f, .001f);
+			CRAG_VERIFY_OP(self.GetScore(), >=, 0);
 		}
 	}
 CRAG_VERIFY_INVARIANTS_DEFINE_END
@@ -10,6 +10,8 @@
 #pragma once
 
 #include "form/defs.h"
+#include "form/Point.h"
+#include "form/Shader.h"
 
 #include "core/pointer_union.h"
 
@@ -20,6 +22,32 @@ namespace form
 	class PointBuffer;
 	class Polyhedron;
 	
+	// structure-of-arrays storage of the Node values read and written
+	// during scoring; indexed by node index; keeps the scoring pass
+	// from dragging topology through the cache
+	struct NodeScoreData
+	{
+		float * center[3];
+		float * area;
+		float * normal[3];
+		float * leaf;	// 1 if node has no children, otherwise 0
+		float * score;
+	};
+	
+#if defined(CRAG_FORM_COMPACT_NODES)
+	// everything a compact Node needs to turn its indices into pointers;
+	// NodeBuffer stores it immediately before its first node
+	struct NodeContext
+	{
+		Point * points;
+		NodeScoreData score_data;
+		
+		// polyhedra of the root nodes, which follow the other nodes
+		int root_begin;
+		Polyhedron * polyhedra[max_num_root_nodes];
+	};
+#endif
+	
 	
 	// This is easily one of the most important classes in the formation system. 
 	// You can think of it as a triangle with corners represented by the three corner instances.
@@ -30,67 +58,158 @@ namespace form
 	// Think of the four triangles of the Zelda Triforce,
 	// the forth (children[3]) being the upside-down center triangle.
 	
+	// Nodes only exist inside a NodeBuffer; with CRAG_FORM_COMPACT_NODES,
+	// they store their own index within it and use it to locate the 
+	// NodeContext with which the rest of their indices are resolved.
+	
 	class Node
 	{
+#if defined(CRAG_FORM_COMPACT_NODES)
+		friend class NodeBuffer;
+		
+		// zero represents null; otherwise one plus the index of the target
+		using Index = std::uint32_t;
+		
+		using NodeLink = Index;
+		using PointLink = Index;
+#else
+		using NodeLink = Node *;
+		using PointLink = Point *;
+#endif
+		
 	public:
 		////////////////////////////////////////////////////////////////////////////////
 		// functions
 		
-		Node();
-		~Node();
-
+#if defined(CRAG_FORM_COMPACT_NODES)
+		// copying would lose the node's index; assignment keeps it
+		Node(Node const &) = delete;
+		Node & operator=(Node const & rhs);
+#endif
+		
 		// Ensures all three mid-points are allocated and calculated.
 		bool InitMidPoints(Polyhedron & polyhedron, PointBuffer & point_buffer);
-		static bool InitChildCorners(Node const & parent, Node * children);
+		
+		// Allocates any missing mid-points and appends requests to calculate them;
+		// new mid-points are shared with cousins straight away so that each is
+		// requested once; returns false if the point buffer is exhausted.
+		bool RequestMidPoints(Polyhedron & polyhedron, PointBuffer & point_buffer, MidPointRequestVector & requests);
+		
+		// Calculates the requested mid-points, one batch per polyhedron;
+		// mid-points which cannot be calculated are freed; requests are reordered.
+		static void FulfillMidPointRequests(MidPointRequestVector & requests, PointBuffer & point_buffer);
+		
+		// True iff all four children would have non-zero area.
+		static bool CanInitChildCorners(Node const & parent);
+		static void InitChildCorners(Node const & parent, Node * children);
 
 		// Calls InitMidPoints and recalcs the center position.
 		void Reinit(Polyhedron & polyhedron, PointBuffer & point_buffer);
 		
 		bool InitScoreParameters();
 		
-		bool HasChildren() const { return GetChildren() != nullptr; }
+		// returns an unused node to the state of a zeroed node
+		void Clear();
+		
+		bool HasChildren() const { return _children != NodeLink(); }
 		bool IsRecyclable() const { return ! HasChildren(); }
-		bool IsInUse() const { return _owner != nullptr; }
+		bool IsInUse() const { return GetParent() != nullptr || GetPolyhedron() != nullptr; }
 		bool IsLeaf() const { return ! HasChildren(); }
 		
 		bool HasAllCousins() const
 		{
 			// Make sure all three cousins are available.
-			//return triple[0].cousin != nullptr && triple[1].cousin != nullptr && triple[2].cousin != nullptr;
-			return (size_t(triple[0].cousin) * size_t(triple[1].cousin) * size_t(triple[2].cousin)) != 0;
+			return _triple[0].cousin != NodeLink() && _triple[1].cousin != NodeLink() && _triple[2].cousin != NodeLink();
 		}
 
 		bool IsExpandable() const
 		{
-			ASSERT(score > 0);
+			ASSERT(GetScore() > 0);
 			return ! HasChildren() && HasAllCousins() /*&& score != 0*/;
 		}
 		
-		Node * GetChildren()
+#if defined(CRAG_FORM_COMPACT_NODES)
+		// children come in quaterna-aligned groups of four
+		// so the index of their quaterna is stored
+		Node * GetChildren() { return _children ? GetBase() + ((_children - 1) << 2) : nullptr; }
+		Node const * GetChildren() const { return const_cast<Node &>(* this).GetChildren(); }
+		
+		Node * GetParent() { return ToNode(_parent); }
+		Node const * GetParent() const { return ToNode(_parent); }
+		
+		Polyhedron * GetPolyhedron() { return const_cast<Polyhedron *>(static_cast<Node const &>(* this).GetPolyhedron()); }
+		Polyhedron const * GetPolyhedron() const
 		{
-			return _children;
+			auto & context = GetContext();
+			auto root_index = static_cast<int>(_index) - context.root_begin;
+			return (root_index >= 0) ? context.polyhedra[root_index] : nullptr;
 		}
+		
+		Point * GetCorner(int index) { return ToPoint(_triple[index].corner); }
+		Point const * GetCorner(int index) const { return ToPoint(_triple[index].corner); }
+		
+		Point * GetMidPoint(int index) { return ToPoint(_triple[index].mid_point); }
+		Point const * GetMidPoint(int index) const { return ToPoint(_triple[index].mid_point); }
+		
+		Node * GetCousin(int index) { return ToNode(_triple[index].cousin); }
+		Node const * GetCousin(int index) const { return ToNode(_triple[index].cousin); }
+		
+		// score parameters and score are stored in the score data of NodeBuffer
+		Vector3 GetCenter() const { auto & d = GetContext().score_data; return Vector3(d.center[0][_index], d.center[1][_index], d.center[2][_index]); }
+		float GetArea() const { return GetContext().score_data.area[_index]; }
+		Vector3 GetNormal() const { auto & d = GetContext().score_data; return Vector3(d.normal[0][_index], d.normal[1][_index], d.normal[2][_index]); }
+		float GetScore() const { return GetContext().score_data.score[_index]; }
+		
+		void SetCenter(Vector3 const & center);
+		void SetArea(float area) { GetContext().score_data.area[_index] = area; }
+		void SetNormal(Vector3 const & normal);
+		void SetScore(float score) { GetContext().score_data.score[_index] = score; }
+#else
+		Node * GetChildren() { return _children; }
 		Node const * GetChildren() const { return _children; }
-		void SetChildren(Node * c);
 		
 		Node * GetParent() { return _owner.find<Node>(); }
 		Node const * GetParent() const { return _owner.find<Node>(); }
-		void SetParent(Node * p);
 		
 		Polyhedron * GetPolyhedron() { return _owner.find<Polyhedron>(); }
 		Polyhedron const * GetPolyhedron() const { return _owner.find<Polyhedron>(); }
-		void SetPolyhedron(Polyhedron * p);
 		
-		Point const * GetCorner(int index) const { return triple[index].corner; }
-		Point * GetCorner(int index) { return triple[index].corner; }
+		Point * GetCorner(int index) { return _triple[index].corner; }
+		Point const * GetCorner(int index) const { return _triple[index].corner; }
 		
-		Point const * GetMidPoint(int index) const { return triple[index].mid_point; }
-		Point * GetMidPoint(int index) { return triple[index].mid_point; }
+		Point * GetMidPoint(int index) { return _triple[index].mid_point; }
+		Point const * GetMidPoint(int index) const { return _triple[index].mid_point; }
 		
-		Node const * GetCousin(int index) const { return triple[index].cousin; }
-		Node * GetCousin(int index) { return triple[index].cousin; }
+		Node * GetCousin(int index) { return _triple[index].cousin; }
+		Node const * GetCousin(int index) const { return _triple[index].cousin; }
+		
+		Vector3 const & GetCenter() const { return _center; }
+		float GetArea() const { return _area; }
+		Vector3 const & GetNormal() const { return _normal; }
+		float GetScore() const { return _score; }
+		
+		void SetCenter(Vector3 const & center) { _center = center; }
+		void SetArea(float area) { _area = area; }
+		void SetNormal(Vector3 const & normal) { _normal = normal; }
+		void SetScore(float score) { _score = score; }
+#endif
+		
+		void SetChildren(Node * c);
+		void SetParent(Node * p);
+		void SetPolyhedron(Polyhedron * p);
+		
+		void SetCorner(int index, Point * corner);
+		void SetMidPoint(int index, Point * mid_point);
+		
+		// makes node and cousin each other's cousin and shares cousin's mid-point
 		void SetCousin(int index, Node & cousin);
 		
+		// makes node and its cousin strangers again; the cousin keeps the mid-point
+		void DetachCousin(int index);
+		
+		// once node has been copied to a new location, points its cousin at the copy
+		void RepairCousin(int index);
+		
 		int GetChildSeed(int child_index) const;
 		void GetChildCorners(int child_index, Point * child_corners[3]) const;
 		void GetChildNeighbours(int child_index, Node * child_neighbours[3]) const;
@@ -98,9 +217,47 @@ namespace form
 		CRAG_VERIFY_INVARIANTS_DECLARE(Node);
 
 	private:
+#if defined(CRAG_FORM_COMPACT_NODES)
+		NodeContext & GetContext() const
+		{
+			return const_cast<NodeContext *>(reinterpret_cast<NodeContext const *>(GetBase()))[-1];
+		}
+		Node * GetBase() const { return const_cast<Node *>(this) - _index; }
+		
+		Node * ToNode(NodeLink link) const { return link ? GetBase() + (link - 1) : nullptr; }
+		NodeLink ToLink(Node const * node) const { return node ? NodeLink(node - GetBase() + 1) : NodeLink(); }
+		
+		Point * ToPoint(PointLink link) const { return link ? GetContext().points + (link - 1) : nullptr; }
+		PointLink ToLink(Point const * point) const { return point ? PointLink(point - GetContext().points + 1) : PointLink(); }
+#else
+		static Node * ToNode(NodeLink link) { return link; }
+		static NodeLink ToLink(Node * node) { return node; }
+		
+		static Point * ToPoint(PointLink link) { return link; }
+		static PointLink ToLink(Point * point) { return point; }
+#endif
+		
 		////////////////////////////////////////////////////////////////////////////////
 		// variables
 
+		struct Triplet
+		{
+			PointLink corner;
+			PointLink mid_point;
+			NodeLink cousin;
+		};	// 12	/	24	/	12
+
+#if defined(CRAG_FORM_COMPACT_NODES)
+		Index _index;			//	 4
+		Index _children;		//	 4	(quaterna)
+		NodeLink _parent;		//	 4
+	public:
+		int seed;				//	 4
+		int depth;				//	 4	(zero at the root)
+	private:
+		Triplet _triple[3];		//	36	56
+	};	// 56
+#else
 		Node * _children;
 
 		typedef ::crag::core::pointer_union<Node, Polyhedron> PointerUnion;
@@ -108,24 +265,16 @@ namespace form
 		static_assert(sizeof(decltype(_owner)) == sizeof(void*), "Bad assumption about pointer size");
 	public:
 		int seed;				//  4	/	4
-
-		struct Triplet
-		{
-			Triplet();
-			~Triplet();
-			
-			Point * corner;
-			Point * mid_point;
-			Node * cousin;
-		};	// 12	/	24
-		
-		Triplet triple[3];		// 36	/	72 72
+		int depth;				//  4	/	4	(zero at the root)
+	private:
+		Triplet _triple[3];		// 36	/	72 72
 
 		// The score parameters - variables which affect the node's score.
-		Vector3 center;			// 12	/	12
-		float area;				//  4	/	 4
-		Vector3 normal;			// 12	/	12
+		Vector3 _center;		// 12	/	12
+		float _area;			//  4	/	 4
+		Vector3 _normal;		// 12	/	12
 		
-		float score;			//  4	/	 4 32
-	};	// 80	/	128
+		float _score;			//  4	/	 4 32
+	};	// 84	/	128
+#endif
 }
@@ -9,18 +9,91 @@
 
 #include "pch.h"
 
-#include "Node.h"
 #include "NodeBuffer.h"
 #include "Point.h"
+#include "PointBuffer.h"
 
 using namespace form;
 
+////////////////////////////////////////////////////////////////////////////////
+// file-local definitions
+
+namespace
+{
+	// number of float arrays in NodeBuffer::ScoreData
+	constexpr auto num_score_arrays = static_cast<int>(sizeof(NodeBuffer::ScoreData) / sizeof(float *));
+	
+	// alignment and padding of each score array; suits SSE
+	constexpr auto score_array_alignment = 16;
+	constexpr auto score_array_granularity = score_array_alignment / static_cast<int>(sizeof(float));
+	
+	int GetScoreArrayStride(int max_num_nodes)
+	{
+		return (max_num_nodes + score_array_granularity - 1) & ~ (score_array_granularity - 1);
+	}
+	
+#if defined(CRAG_FORM_COMPACT_NODES)
+	// nodes are immediately preceded by their context
+	constexpr auto nodes_offset = (static_cast<int>(sizeof(NodeContext)) + 127) & ~ 127;
+#else
+	constexpr auto nodes_offset = 0;
+#endif
+
+	Node * AllocateNodes(int num_nodes)
+	{
+		auto buffer = reinterpret_cast<char *>(Allocate(nodes_offset + static_cast<int>(sizeof(Node)) * num_nodes, 128));
+		auto nodes = reinterpret_cast<Node *>(buffer + nodes_offset);
+		ZeroArray(nodes, num_nodes);
+		return nodes;
+	}
+	
+	void FreeNodes(Node * nodes)
+	{
+		Free(reinterpret_cast<char *>(nodes) - nodes_offset);
+	}
+	
+	NodeBuffer::ScoreData AllocateScoreData(int max_num_nodes)
+	{
+		auto stride = GetScoreArrayStride(max_num_nodes);
+		auto num_floats = stride * num_score_arrays;
+		auto buffer = reinterpret_cast<float *>(Allocate(static_cast<int>(sizeof(float)) * num_floats, score_array_alignment));
+		ZeroArray(buffer, num_floats);
+		
+		NodeBuffer::ScoreData score_data;
+		auto arrays = reinterpret_cast<float * *>(& score_data);
+		for (auto array_index = 0; array_index != num_score_arrays; ++ array_index)
+		{
+			arrays[array_index] = buffer + stride * array_index;
+		}
+		
+		return score_data;
+	}
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // form::NodeBuffer member definitions
 
 #if defined(CRAG_VERIFY_ENABLED)
 CRAG_VERIFY_INVARIANTS_DEFINE_BEGIN(NodeBuffer, object)
 	CRAG_VERIFY_ARRAY_POINTER(object._nodes_used_end, object._nodes, object._nodes_end);
+	
+	auto spare_nodes_end = object._nodes_end + num_spare_nodes;
+	for (auto spare_node = object._nodes_end; spare_node != spare_nodes_end; ++ spare_node)
+	{
+		CRAG_VERIFY_FALSE(spare_node->IsInUse());
+	}
+	
+	auto roots_begin = object.GetRoots();
+	auto roots_end = roots_begin + max_num_root_nodes;
+	for (auto root = roots_begin; root != roots_end; ++ root)
+	{
+		CRAG_VERIFY_FALSE(root->GetParent());
+		if (root->GetPolyhedron())
+		{
+			CRAG_VERIFY(* root);
+		}
+	}
 CRAG_VERIFY_INVARIANTS_DEFINE_END
 
 void NodeBuffer::VerifyUsed(Node const & node) const
@@ -41,11 +114,22 @@ void NodeBuffer::VerifyUsed(Node const & node) const
 
 	for (int i = 0; i < 3; ++ i)
 	{
-		Node::Triplet const & t = node.triple[i];
-		CRAG_VERIFY_TRUE(t.corner);
+		CRAG_VERIFY_TRUE(node.GetCorner(i));
 	}
 
-	CRAG_VERIFY_OP(node.score, >, 0);
+	CRAG_VERIFY_OP(node.GetScore(), >, 0);
+
+	// score data must mirror node
+	auto index = core::get_index(_nodes, node);
+#if ! defined(CRAG_FORM_COMPACT_NODES)
+	for (int axis = 0; axis < 3; ++ axis)
+	{
+		CRAG_VERIFY_EQUAL(_score_data.center[axis][index], node.GetCenter()[axis]);
+		CRAG_VERIFY_EQUAL(_score_data.normal[axis][index], node.GetNormal()[axis]);
+	}
+	CRAG_VERIFY_EQUAL(_score_data.area[index], node.GetArea());
+#endif
+	CRAG_VERIFY_EQUAL(_score_data.leaf[index] != 0, node.IsLeaf());
 }
 
 void NodeBuffer::VerifyUnused(Node const & node) const
@@ -59,24 +143,42 @@ void NodeBuffer::VerifyUnused(Node const & node) const
 
 	CRAG_VERIFY_FALSE(node.GetParent());
 	CRAG_VERIFY_FALSE(node.HasChildren());
-	CRAG_VERIFY_EQUAL(node.score, 0);
+	CRAG_VERIFY_EQUAL(node.GetScore(), 0);
 
 	for (int i = 0; i < 3; ++ i)
 	{
-		Node::Triplet const & t = node.triple[i];
-		CRAG_VERIFY_FALSE(t.corner);
-		CRAG_VERIFY_FALSE(t.mid_point);
-		CRAG_VERIFY_FALSE(t.cousin);
+		CRAG_VERIFY_FALSE(node.GetCorner(i));
+		CRAG_VERIFY_FALSE(node.GetMidPoint(i));
+		CRAG_VERIFY_FALSE(node.GetCousin(i));
 	}
 }
 #endif
 
-NodeBuffer::NodeBuffer(int max_num_nodes)
-: _nodes(reinterpret_cast<Node *>(Allocate(static_cast<int>(sizeof(Node)) * max_num_nodes, 128)))
+NodeBuffer::NodeBuffer(int max_num_nodes, PointBuffer & point_buffer)
+: _nodes(AllocateNodes(max_num_nodes + num_spare_nodes + max_num_root_nodes))
 , _nodes_used_end(_nodes)
 , _nodes_end(_nodes + max_num_nodes)
+, _score_data(AllocateScoreData(max_num_nodes + num_spare_nodes + max_num_root_nodes))
+, _change_serials(reinterpret_cast<ChangeSerial *>(Allocate(static_cast<int>(sizeof(ChangeSerial)) * max_num_nodes)))
+, _change_serial(1)
 {
-	ZeroArray(_nodes, max_num_nodes);
+	ZeroArray(_change_serials, max_num_nodes);
+
+#if defined(CRAG_FORM_COMPACT_NODES)
+	auto & context = reinterpret_cast<NodeContext *>(_nodes)[-1];
+	context.points = point_buffer.GetBase();
+	context.score_data = _score_data;
+	context.root_begin = max_num_nodes + num_spare_nodes;
+	std::fill(std::begin(context.polyhedra), std::end(context.polyhedra), nullptr);
+	
+	auto num_nodes = max_num_nodes + num_spare_nodes + max_num_root_nodes;
+	for (auto index = 0; index != num_nodes; ++ index)
+	{
+		_nodes[index]._index = index;
+	}
+#else
+	static_cast<void>(point_buffer);
+#endif
 
 	CRAG_VERIFY(* this);
 }
@@ -86,7 +188,9 @@ NodeBuffer::~NodeBuffer()
 	CRAG_VERIFY(* this);
 
 	//delete nodes;
-	Free(_nodes);
+	FreeNodes(_nodes);
+	Free(_score_data.center[0]);
+	Free(_change_serials);
 }
 
 void NodeBuffer::Clear()
@@ -110,29 +214,125 @@ void NodeBuffer::Pop(int num_nodes)
 	_nodes_used_end = new_nodes_used_end;
 }
 
-void NodeBuffer::ResetNodeOrigins(Vector3 const & origin_delta)
+Node * NodeBuffer::CreateRoot(Polyhedron & polyhedron)
+{
+	auto roots_begin = GetRoots();
+	auto roots_end = roots_begin + max_num_root_nodes;
+	auto root = std::find_if(roots_begin, roots_end, [] (Node const & node)
+	{
+		return ! node.IsInUse();
+	});
+	
+	if (root == roots_end)
+	{
+		DEBUG_BREAK("too many polyhedra");
+		return nullptr;
+	}
+	
+	root->SetPolyhedron(& polyhedron);
+	return root;
+}
+
+void NodeBuffer::DestroyRoot(Node & root)
+{
+	CRAG_VERIFY_ARRAY_ELEMENT(& root, GetRoots(), GetRoots() + max_num_root_nodes);
+	ASSERT(! root.HasChildren());
+	
+	root.SetPolyhedron(nullptr);
+	root.Clear();
+}
+
+Node * NodeBuffer::GetSpareNodes()
+{
+	return _nodes_end;
+}
+
+Node * NodeBuffer::GetRoots() const
+{
+	return _nodes_end + num_spare_nodes;
+}
+
+void NodeBuffer::ResetNodeOrigins()
 {
 	for (Node * node = _nodes; node != _nodes_used_end; ++ node)
 	{
-		Node::Triplet * triple = node->triple;
-		for (int i = 0; i < 3; ++ i)
+		if (! node->IsInUse())
+		{
+			continue;
+		}
+		
+		auto center = (node->GetCorner(0)->pos + node->GetCorner(1)->pos + node->GetCorner(2)->pos) / 3.f;
+		node->SetCenter(center);
+		
+		auto index = core::get_index(_nodes, * node);
+#if ! defined(CRAG_FORM_COMPACT_NODES)
+		for (int axis = 0; axis < 3; ++ axis)
 		{
-			Node::Triplet & t = triple[i];
-			if (t.mid_point != nullptr)
-			{
-				// We only want to increment each mid-point once, 
-				// but it's often pointed to by two nodes.
-				// This is an arbitrary test to ensure it's only incremented for one node.
-				// Note that if cousin is null, the condition still passes. 
-				if (node > t.cousin)
-				{
-					t.mid_point->pos -= origin_delta;
-				}
-			}
+			_score_data.center[axis][index] = center[axis];
 		}
+#endif
 		
-		node->center += origin_delta;
+		// all positions have changed
+		_change_serials[index] = _change_serial;
+	}
+}
+
+void NodeBuffer::OnNodeChanged(Node const & node)
+{
+	if (& node < _nodes || & node >= _nodes_end)
+	{
+		// probably a polyhedron's root node or a spare node
+		return;
+	}
+	
+	auto index = core::get_index(_nodes, node);
+#if ! defined(CRAG_FORM_COMPACT_NODES)
+	for (int axis = 0; axis < 3; ++ axis)
+	{
+		_score_data.center[axis][index] = node.GetCenter()[axis];
+		_score_data.normal[axis][index] = node.GetNormal()[axis];
 	}
+	_score_data.area[index] = node.GetArea();
+	_score_data.score[index] = node.GetScore();
+#endif
+	_score_data.leaf[index] = node.IsLeaf() ? 1.f : 0.f;
+	
+	_change_serials[index] = _change_serial;
+}
+
+NodeBuffer::ScoreData const & NodeBuffer::GetScoreData() const
+{
+	return _score_data;
+}
+
+NodeBuffer::ChangeSerial NodeBuffer::GetChangeSerial() const
+{
+	return _change_serial;
+}
+
+NodeBuffer::ChangeSerial NodeBuffer::GetChangeSerial(int index) const
+{
+	CRAG_VERIFY_OP(index, <, GetCapacity());
+	return _change_serials[index];
+}
+
+void NodeBuffer::IncrementChangeSerial()
+{
+	++ _change_serial;
+}
+
+void NodeBuffer::ApplyScores(int begin_index, int end_index)
+{
+	CRAG_VERIFY_OP(begin_index, <=, end_index);
+	CRAG_VERIFY_OP(end_index, <=, GetSize());
+	
+#if ! defined(CRAG_FORM_COMPACT_NODES)
+	auto scores = _score_data.score;
+	for (auto index = begin_index; index != end_index; ++ index)
+	{
+		_nodes[index].SetScore(scores[index]);
+	}
+#endif
 }
 
 bool NodeBuffer::IsEmpty() const
@@ -145,6 +345,15 @@ int NodeBuffer::GetSize() const
 	return core::get_index(_nodes, * _nodes_used_end);
 }
 
+int NodeBuffer::GetMaxCapacity()
+{
+	constexpr auto max_int = std::numeric_limits<int>::max();
+	auto max_num_nodes = std::min(
+		(max_int - nodes_offset) / static_cast<int>(sizeof(Node)),
+		max_int / (static_cast<int>(sizeof(float)) * num_score_arrays) - score_array_granularity);
+	return max_num_nodes - num_spare_nodes - max_num_root_nodes;
+}
+
 int NodeBuffer::GetCapacity() const
 {
 	return core::get_index(_nodes, * _nodes_end);
@@ -9,19 +9,31 @@
 
 #pragma once
 
-#include "defs.h"
+#include "Node.h"
 
 namespace form
 {
 	// forward-declarations
-	class Node;
+	class PointBuffer;
+	class Polyhedron;
 	
 	// Node store of variable size with a top limit;
-	// used by Surrounding to store all the trees necessary to generate a mesh
+	// used by Surrounding to store all the trees necessary to generate a mesh;
+	// the root nodes of the trees are stored after the other nodes
+	// and a spare group of nodes
 	class NodeBuffer
 	{
 		OBJECT_NO_COPY (NodeBuffer);
 	public:
+		using ChangeSerial = std::uint32_t;
+		
+		// without CRAG_FORM_COMPACT_NODES, a copy of the Node members
+		// which are read and written during scoring
+		using ScoreData = NodeScoreData;
+		
+		// size of the spare group of nodes
+		static constexpr int num_spare_nodes = 4;
+		
 #if defined(CRAG_VERIFY_ENABLED)
 		CRAG_VERIFY_INVARIANTS_DECLARE(NodeBuffer);
 		void VerifyUsed(Node const & n) const;
@@ -29,14 +41,43 @@ namespace form
 #endif
 		
 		// Member functions
-		NodeBuffer(int max_num_nodes);
+		NodeBuffer(int max_num_nodes, PointBuffer & point_buffer);
 		~NodeBuffer();
 		
+		// the largest max_num_nodes whose buffers can be sized in an int
+		static int GetMaxCapacity();
+		
 		void Clear();
 		void Push(int num_nodes);
 		void Pop(int num_nodes);
 		
-		void ResetNodeOrigins(Vector3 const & origin_delta);
+		// returns a root node belonging to polyhedron or null if there are none left
+		Node * CreateRoot(Polyhedron & polyhedron);
+		void DestroyRoot(Node & root);
+		
+		// unused nodes outside of the buffer through which
+		// groups of nodes in the buffer can be exchanged
+		Node * GetSpareNodes();
+		
+		// recalculates the centers of all nodes after their points have moved
+		void ResetNodeOrigins();
+		
+		// copies node's score parameters, leaf state and score into score data
+		// and stamps it with the current change serial; must be called whenever
+		// any of those or the node's faces change; ignores root nodes
+		void OnNodeChanged(Node const & node);
+		
+		// serial numbers identifying the order in which nodes changed;
+		// used to regenerate only the parts of a mesh which are out of date
+		ChangeSerial GetChangeSerial() const;
+		ChangeSerial GetChangeSerial(int index) const;
+		void IncrementChangeSerial();
+		
+		ScoreData const & GetScoreData() const;
+		
+		// copies scores in range [begin_index, end_index) from score data to nodes;
+		// with CRAG_FORM_COMPACT_NODES, the nodes already read them from there
+		void ApplyScores(int begin_index, int end_index);
 		
 		bool IsEmpty() const;
 		int GetSize() const;
@@ -50,13 +91,21 @@ namespace form
 		Node * end();
 
 	private:
+		Node * GetRoots() const;
+		
 		////////////////////////////////////////////////////////////////////////////////
 		// variables
 
-		// The fixed-size array of node groups, used and unused.
-		Node * const _nodes;	// [max_num_nodes]
+		// The fixed-size array of node groups, used and unused,
+		// followed by the spare nodes and then the roots.
+		Node * const _nodes;	// [max_num_nodes + num_spare_nodes + max_num_root_nodes]
 		
 		Node * _nodes_used_end;			// end of buffer of actually used nodes
-		Node const * const _nodes_end;
+		Node * const _nodes_end;
+		
+		ScoreData _score_data;
+		
+		ChangeSerial * const _change_serials;	// [max_num_nodes]
+		ChangeSerial _change_serial;
 	};
 }
@@ -18,11 +18,11 @@ using namespace form;
 
 Point::Point()
 : pos(Vector3::Zero())
-, vert(nullptr)
+, vertex_index(-1)
 {
 }
 
 CRAG_VERIFY_INVARIANTS_DEFINE_BEGIN(Point, self)
 	CRAG_VERIFY(self.pos);
-	CRAG_VERIFY(self.vert);
+	CRAG_VERIFY_OP(self.vertex_index, >=, -1);
 CRAG_VERIFY_INVARIANTS_DEFINE_END
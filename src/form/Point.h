@@ -30,6 +30,6 @@ namespace form
 		
 		// attributes
 		Vector3 pos;
-		Vertex * vert;
+		int vertex_index;	// in the mesh being generated; -1 if not yet added
 	};
 }
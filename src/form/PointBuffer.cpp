@@ -30,7 +30,16 @@ void form::PointBuffer::ClearPointers()
 {
 	_pool.for_each_activated([] (Point & point)
 	{
-		point.vert = nullptr;
+		point.vertex_index = -1;
+	});
+}
+
+void PointBuffer::ResetOrigin(geom::Vector3d const & origin_delta)
+{
+	// position overlaps the free list links of unallocated points
+	_pool.for_each_allocated([& origin_delta] (Point & point)
+	{
+		point.pos = static_cast<Point::Vector3>(static_cast<geom::Vector3d>(point.pos) - origin_delta);
 	});
 }
 
@@ -45,6 +54,52 @@ void PointBuffer::Destroy(Point * ptr)
 	_pool.destroy(ptr);
 }
 
+void PointBuffer::Destroy(std::vector<Point *> & points)
+{
+	// the free list is LIFO so the highest addresses are freed first
+	std::sort(std::begin(points), std::end(points), std::greater<Point *>());
+	
+	for (auto point : points)
+	{
+		_pool.destroy(point);
+	}
+	
+	points.clear();
+}
+
+int PointBuffer::GetSize() const
+{
+	return _pool.size();
+}
+
+int PointBuffer::GetCapacity() const
+{
+	return _pool.capacity();
+}
+
+// allows for the pool rounding its allocation up to a whole number of pages
+int PointBuffer::GetMaxCapacity()
+{
+	constexpr auto max_page_size = 1 << 16;
+	return (std::numeric_limits<int>::max() - max_page_size) / static_cast<int>(sizeof(Point));
+}
+
+float PointBuffer::GetFragmentation() const
+{
+	auto activated_size = _pool.activated_size();
+	if (activated_size == 0)
+	{
+		return 0;
+	}
+	
+	return float(activated_size - _pool.size()) / activated_size;
+}
+
+Point * PointBuffer::GetBase() const
+{
+	return & _pool[0];
+}
+
 #if defined(CRAG_VERIFY_ENABLED)
 void PointBuffer::VerifyAllocatedElement(Point const & element) const
 {
@@ -24,9 +24,31 @@ namespace form
 		bool IsEmpty() const;
 		void ClearPointers();
 		
+		// moves every point so that it is relative to an origin which is
+		// displaced by origin_delta; calculated in double precision
+		void ResetOrigin(geom::Vector3d const & origin_delta);
+		
 		Point * Create();
 		void Destroy(Point * ptr);
 		
+		// destroys every point in points and empties it; points are freed such
+		// that points which are adjacent in the buffer are allocated together
+		// next time, e.g. the mid-points of a node
+		void Destroy(std::vector<Point *> & points);
+		
+		int GetSize() const;
+		int GetCapacity() const;
+		
+		// the largest max_num_verts whose buffer can be sized in an int
+		static int GetMaxCapacity();
+		
+		// the proportion of points up to the furthest allocated point
+		// which are free; zero if the allocated points are tightly packed
+		float GetFragmentation() const;
+		
+		// the first point in the buffer, allocated or otherwise
+		Point * GetBase() const;
+		
 #if defined(CRAG_VERIFY_ENABLED)
 		void VerifyAllocatedElement(Point const & element) const;
 		CRAG_VERIFY_INVARIANTS_DECLARE(PointBuffer);
@@ -25,22 +25,22 @@ namespace
 	{
 		Point * corner = root_points[0];
 
-		root_node.triple[0].corner = corner;
-		root_node.triple[1].corner = corner;
-		root_node.triple[2].corner = corner;
+		root_node.SetCorner(0, corner);
+		root_node.SetCorner(1, corner);
+		root_node.SetCorner(2, corner);
 		
-		root_node.center = geom::Vector3f::Zero();
-		root_node.area = 0;
-		root_node.normal = geom::Vector3f::Zero();
-		root_node.score = std::numeric_limits<float>::max();
+		root_node.SetCenter(geom::Vector3f::Zero());
+		root_node.SetArea(0);
+		root_node.SetNormal(geom::Vector3f::Zero());
+		root_node.SetScore(std::numeric_limits<float>::max());
 	
 		root_node.seed = init_seed;
+		root_node.depth = 0;
 	
 		for (int i = 0; i < 3; ++ i)
 		{
-			Node::Triplet & t = root_node.triple[i];
-			t.mid_point = root_points[i + 1];
-			t.cousin = & root_node;
+			root_node.SetCousin(i, root_node);
+			root_node.SetMidPoint(i, root_points[i + 1]);
 		}
 	
 		// At this point, the four verts still need setting up.
@@ -50,25 +50,23 @@ namespace
 	{
 		ASSERT(! root_node.HasChildren());
 	
-		points.Destroy(root_node.triple[0].corner);
+		points.Destroy(root_node.GetCorner(0));
 	
 		for (int i = 0; i < 3; ++ i) {
-			root_node.triple[i].corner = nullptr;
+			root_node.SetCorner(i, nullptr);
 		
-			points.Destroy(root_node.triple[i].mid_point);
-			root_node.triple[i].mid_point = nullptr;
-		
-			root_node.triple[i].cousin = nullptr;
+			points.Destroy(root_node.GetMidPoint(i));
+			root_node.DetachCousin(i);
 		}
 	}
 
-	void GetRootNodePoints(Node const & root_node, Point * points[4])
+	void GetRootNodePoints(Node & root_node, Point * points[4])
 	{
 		// TODO: Verify would include check that {points[0] == (triple[1]} == triple[2])
-		points[0] = root_node.triple[0].corner;
-		points[1] = root_node.triple[0].mid_point;
-		points[2] = root_node.triple[1].mid_point;
-		points[3] = root_node.triple[2].mid_point;
+		points[0] = root_node.GetCorner(0);
+		points[1] = root_node.GetMidPoint(0);
+		points[2] = root_node.GetMidPoint(1);
+		points[3] = root_node.GetMidPoint(2);
 	}
 }
 
@@ -91,18 +89,18 @@ Polyhedron * form::GetPolyhedron(Node & node)
 
 Polyhedron::Polyhedron(Formation & formation)
 : _shape(formation.GetShape())
+, _root_node(nullptr)
 , _formation(formation)
 {
-	_root_node.SetPolyhedron(this);
-	
 	CRAG_VERIFY(* this);
 }
 
 Polyhedron::Polyhedron(Polyhedron const & rhs)
 : _shape(rhs._shape)
+, _root_node(nullptr)
 , _formation(rhs._formation)
 {
-	_root_node.SetPolyhedron(this);
+	ASSERT(! rhs._root_node);
 
 	CRAG_VERIFY(* this);
 }
@@ -110,17 +108,23 @@ Polyhedron::Polyhedron(Polyhedron const & rhs)
 Polyhedron::~Polyhedron()
 {
 	CRAG_VERIFY(* this);
-	
-	_root_node.SetPolyhedron(nullptr);
+	ASSERT(! _root_node);
 }
 
 CRAG_VERIFY_INVARIANTS_DEFINE_BEGIN(Polyhedron, self)
-	CRAG_VERIFY(self._root_node);
-	CRAG_VERIFY_EQUAL(self._root_node.GetPolyhedron(), & self);
+	if (self._root_node)
+	{
+		CRAG_VERIFY(* self._root_node);
+		CRAG_VERIFY_EQUAL(self._root_node->GetPolyhedron(), & self);
+	}
 CRAG_VERIFY_INVARIANTS_DEFINE_END
 
-void Polyhedron::Init(geom::Space const & space, PointBuffer & point_buffer)
+void Polyhedron::Init(geom::Space const & space, PointBuffer & point_buffer, Node & root_node)
 {
+	ASSERT(! _root_node);
+	ASSERT(root_node.GetPolyhedron() == this);
+	_root_node = & root_node;
+	
 	// Initialize the shader.
 	_shape.center = space.AbsToRel<double>(_formation.GetShape().center);
 	Shader const & shader = _formation.GetShader();
@@ -139,12 +143,16 @@ void Polyhedron::Init(geom::Space const & space, PointBuffer & point_buffer)
 	shader.InitRootPoints(* this, root_points);	
 
 	// Initialize the root node with the points
-	InitRootNode(_root_node, _formation.GetSeed(), root_points);
+	InitRootNode(root_node, _formation.GetSeed(), root_points);
 }
 
-void Polyhedron::Deinit(PointBuffer & point_buffer)
+Node & Polyhedron::Deinit(PointBuffer & point_buffer)
 {
-	DeinitRootNode(_root_node, point_buffer);
+	auto & root_node = ref(_root_node);
+	DeinitRootNode(root_node, point_buffer);
+	
+	_root_node = nullptr;
+	return root_node;
 }
 
 geom::uni::Sphere3 const & Polyhedron::GetShape() const
@@ -162,7 +170,12 @@ Formation const & Polyhedron::GetFormation() const
 	return _formation;
 }
 
-Node const & Polyhedron::GetRootNode() const
+Node const * Polyhedron::GetRootNode() const
+{
+	return _root_node;
+}
+
+Node * Polyhedron::GetRootNode()
 {
 	return _root_node;
 }
@@ -173,35 +186,14 @@ void Polyhedron::SetSpace(geom::Space const & space)
 	_shape.center = space.AbsToRel<double>(shape.center);
 	_shape.radius = shape.radius;
 	
+	if (! _root_node)
+	{
+		return;
+	}
+	
 	Point * root_points[4];
-	GetRootNodePoints(_root_node, root_points);
+	GetRootNodePoints(* _root_node, root_points);
 
 	Shader const & shader = _formation.GetShader();
 	shader.InitRootPoints(* this, root_points);
 }
-
-bool Polyhedron::ResetSpace(Node & node, PointBuffer & point_buffer, int depth)
-{
-	Node * children = node.GetChildren();
-	if (children == nullptr)
-	{
-		return false;
-	}
-	
-	if (depth == 0)
-	{
-		children[0].Reinit(* this, point_buffer);
-		children[1].Reinit(* this, point_buffer);
-		children[2].Reinit(* this, point_buffer);
-		children[3].Reinit(* this, point_buffer);
-		return true;
-	}
-	else 
-	{
-		-- depth;
-		return	ResetSpace(children[0], point_buffer, depth)
-			|	ResetSpace(children[1], point_buffer, depth)
-			|	ResetSpace(children[2], point_buffer, depth)
-			|	ResetSpace(children[3], point_buffer, depth);
-	}
-}
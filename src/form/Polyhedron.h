@@ -36,18 +36,20 @@ namespace form
 		
 		CRAG_VERIFY_INVARIANTS_DECLARE(Polyhedron);
 		
-		void Init(geom::Space const & space, PointBuffer & point_buffer);
-		void Deinit(PointBuffer & point_buffer);
+		// root_node is provided by the NodeBuffer of the Surrounding
+		void Init(geom::Space const & space, PointBuffer & point_buffer, Node & root_node);
+		Node & Deinit(PointBuffer & point_buffer);
 
 		geom::uni::Sphere3 const & GetShape() const;
 		Formation & GetFormation();
 		Formation const & GetFormation() const;
-		Node const & GetRootNode() const;
+		
+		// null unless initialized
+		Node const * GetRootNode() const;
+		Node * GetRootNode();
 		
 		void SetSpace(geom::Space const & space);
 	private:
-		bool ResetSpace(Node & node, PointBuffer & point_buffer, int depth);
-		
 		enum 
 		{
 			NUM_ROOT_VERTICES = 4
@@ -55,7 +57,7 @@ namespace form
 		
 	public:
 		geom::uni::Sphere3 _shape;
-		Node _root_node;	// Exists purely so that all 'real' nodes have a parent.
+		Node * _root_node;	// Exists purely so that all 'real' nodes have a parent.
 		Formation & _formation;
 	};
 }
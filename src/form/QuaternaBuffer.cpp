@@ -13,8 +13,27 @@
 
 #include "Quaterna.h"
 
+#include "core/ConfigEntry.h"
+
 using namespace form;
 
+////////////////////////////////////////////////////////////////////////////////
+// file-local definitions
+
+namespace
+{
+	// If true, Sort exploits the order left by the previous sort.
+	CONFIG_DEFINE(quaterna_sort_incremental, true);
+	
+	// If more than this proportion of quaterne are out of order, sort them all.
+	CONFIG_DEFINE(quaterna_sort_incremental_max_unsorted, .25f);
+	
+	bool IsHigherScoring(Quaterna const & lhs, Quaterna const & rhs)
+	{
+		return lhs.parent_score > rhs.parent_score;
+	}
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // QuaternaBuffer member definitions
 
@@ -61,7 +80,7 @@ void QuaternaBuffer::UpdateScores()
 	for (auto & q : * this)
 	{
 		Node * parent = q.nodes[0].GetParent();
-		q.parent_score = (parent != nullptr) ? parent->score : -1;
+		q.parent_score = (parent != nullptr) ? parent->GetScore() : -1;
 	}
 	
 	// This basically says: "as far as I know, none of the quaterne are sorted."
@@ -77,13 +96,87 @@ void QuaternaBuffer::Sort()
 		return;
 	}
 
-	std::sort(_quaterne, _quaterne_used_end, [] (Quaterna const & lhs, Quaterna const & rhs) {
-		return lhs.parent_score > rhs.parent_score;
-	});
+	if (quaterna_sort_incremental)
+	{
+		SortIncremental();
+	}
+	else
+	{
+		std::sort(_quaterne, _quaterne_used_end, IsHigherScoring);
+	}
 	
 	_quaterne_sorted_end = _quaterne_used_end;
 }
 
+// Between ticks, most scores change a little and the order barely changes.
+// Pull out enough quaterne to leave the rest in order, sort those and merge.
+// Cost is O(n + k log k) where k is the number of quaterne pulled out.
+void QuaternaBuffer::SortIncremental()
+{
+	auto num_quaterne = size();
+	auto max_num_unsorted = static_cast<int>(num_quaterne * quaterna_sort_incremental_max_unsorted);
+	
+	// Compact the in-order quaterne toward the front. Whenever one is out of order
+	// with its predecessor, both are pulled out. At most, this takes twice as many
+	// as strictly necessary, but a single stray high score can't pull out all the rest.
+	_unsorted.clear();
+	auto sorted_end = _quaterne;
+	for (auto i = _quaterne; i != _quaterne_used_end; ++ i)
+	{
+		if (sorted_end != _quaterne && IsHigherScoring(* i, sorted_end [- 1]))
+		{
+			-- sorted_end;
+			_unsorted.push_back(* sorted_end);
+			_unsorted.push_back(* i);
+			
+			if (static_cast<int>(_unsorted.size()) > max_num_unsorted)
+			{
+				// too much has changed; give up
+				std::copy(std::begin(_unsorted), std::end(_unsorted), sorted_end);
+				std::sort(_quaterne, _quaterne_used_end, IsHigherScoring);
+				_unsorted.clear();
+				return;
+			}
+		}
+		else
+		{
+			* sorted_end = * i;
+			++ sorted_end;
+		}
+	}
+	
+	if (_unsorted.empty())
+	{
+		return;
+	}
+	
+	std::sort(std::begin(_unsorted), std::end(_unsorted), IsHigherScoring);
+	
+	// merge from the back so nothing in the sorted range is overwritten before it's moved
+	auto destination = _quaterne_used_end;
+	auto sorted_source = sorted_end;
+	auto unsorted_source = std::end(_unsorted);
+	while (unsorted_source != std::begin(_unsorted))
+	{
+		-- destination;
+		if (sorted_source != _quaterne && IsHigherScoring(unsorted_source [- 1], sorted_source [- 1]))
+		{
+			-- sorted_source;
+			* destination = * sorted_source;
+		}
+		else
+		{
+			-- unsorted_source;
+			* destination = * unsorted_source;
+		}
+	}
+	
+	ASSERT(destination == sorted_source);
+	ASSERT(std::is_sorted(_quaterne, _quaterne_used_end, IsHigherScoring));
+	
+	_unsorted.clear();
+}
+
 // Find the (known) lowest-scoring quaterna in used.
 float QuaternaBuffer::GetLowestSortedScore() const
 {
@@ -66,6 +66,9 @@ namespace form
 		Quaterna const * end() const;
 		
 	private:
+		void SortIncremental();
+		
+
 		////////////////////////////////////////////////////////////////////////////////
 		// variables
 		
@@ -74,5 +77,8 @@ namespace form
 		Quaterna * _quaterne_sorted_end;			// end of the range the we know is sorted
 		Quaterna * _quaterne_used_end;			// end of buffer of actually used quaterna
 		Quaterna const * const _quaterne_end;
+		
+		// used by SortIncremental to hold out-of-order quaterne
+		std::vector<Quaterna> _unsorted;
 	};
 }
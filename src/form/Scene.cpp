@@ -14,11 +14,80 @@
 
 #include "Mesh.h"
 
+#include "form/Formation.h"
+#include "form/MidPointCache.h"
 #include "form/Surrounding.h"
 #include "form/Polyhedron.h"
+#include "form/Shader.h"
+
+#include "sim/defs.h"
+
+#include "core/ConfigEntry.h"
 
 using namespace form;
 
+namespace
+{
+	// If true, mid-point positions are stored in a file per formation
+	// and retrieved when the same mid-points are next needed.
+	CONFIG_DEFINE(form_mid_point_cache, false);
+	CONFIG_DEFINE(form_mid_point_cache_capacity, 1 << 20);
+	
+	// If true, formations without a mid-point cache file are given one in memory
+	// so that the scenes of the form and sim threads share mid-point positions
+	// and neither thread derives a mid-point which the other already has.
+	// Mid-points evicted from the table are derived by each thread separately
+	// and, after a change of origin, may differ slightly.
+	// The sim thread only has a scene when formation physics is enabled.
+#if defined(CRAG_SIM_FORMATION_PHYSICS)
+	CONFIG_DEFINE(form_shared_mid_point_cache, true);
+#else
+	CONFIG_DEFINE(form_shared_mid_point_cache, false);
+#endif
+	CONFIG_DEFINE(form_shared_mid_point_cache_capacity, 1 << 18);
+	
+	// If true, a change of space translates existing nodes and then re-derives
+	// their mid-points one level per tick; otherwise, nodes are rebuilt.
+	CONFIG_DEFINE(form_reorigin_in_place, true);
+	
+	// scenes on different threads add the same formations
+	std::mutex mid_point_cache_mutex;
+	
+	void OpenMidPointCache(Formation & formation)
+	{
+		std::lock_guard<std::mutex> lock(mid_point_cache_mutex);
+		
+		if (formation.GetMidPointCache())
+		{
+			return;
+		}
+		
+		auto signature = formation.GetShader().GetMidPointCacheSignature(formation);
+		if (! signature)
+		{
+			return;
+		}
+		
+		std::shared_ptr<MidPointCache> mid_point_cache;
+		if (form_mid_point_cache)
+		{
+			char filename[64];
+			snprintf(filename, sizeof(filename), "mid_points_%08x.cache", static_cast<unsigned>(formation.GetSeed()));
+			
+			mid_point_cache = std::make_shared<MidPointCache>(filename, signature, form_mid_point_cache_capacity);
+		}
+		else
+		{
+			mid_point_cache = std::make_shared<MidPointCache>(std::string(), signature, form_shared_mid_point_cache_capacity);
+		}
+		
+		if (mid_point_cache->IsOpen())
+		{
+			formation.SetMidPointCache(mid_point_cache);
+		}
+	}
+}
+
 /////////////////////////////////////////////////////////////////
 // Scene
 
@@ -68,6 +137,12 @@ Surrounding const & Scene::GetSurrounding() const
 // Change the local co-ordinate system so that 0,0,0 in local space is o in global space.
 void Scene::OnSpaceReset(geom::Space const & space, gfx::LodParameters const & lod_parameters)
 {
+	if (form_reorigin_in_place)
+	{
+		ReoriginFormations(space);
+		return;
+	}
+	
 	auto num_quaterna = _surrounding->GetNumQuaternaUsed();
 
 	// The difficult bit: fix all our data which relied on the old space.
@@ -99,6 +174,12 @@ void Scene::SetPaused(bool paused)
 void Scene::AddFormation(Formation & formation, geom::Space const & space)
 {
 	ASSERT(formation_map.find(& formation) == formation_map.end());
+	
+	if (form_mid_point_cache || form_shared_mid_point_cache)
+	{
+		OpenMidPointCache(formation);
+	}
+	
 	FormationMap::iterator i = formation_map.insert(formation_map.begin(), FormationPair(& formation, Polyhedron(formation)));
 	InitPolyhedron(* i, space);
 	
@@ -129,14 +210,19 @@ Polyhedron const * Scene::GetPolyhedron(Formation const & formation) const
 	}
 }
 
-bool Scene::Tick(gfx::LodParameters const & lod_parameters)
+bool Scene::Tick(gfx::LodParameters const & lod_parameters, gfx::LodParametersVector const & secondary_lod_parameters)
 {
 	CRAG_VERIFY(lod_parameters);
 	CRAG_VERIFY_FALSE(_is_paused);
 	
-	bool changed = _surrounding->Tick(lod_parameters);
+	bool changed = _surrounding->Tick(lod_parameters, secondary_lod_parameters);
 	TickModels();
 	
+	if (_reinit_depth != -1)
+	{
+		changed |= ReinitPolyhedra();
+	}
+	
 	if (! changed)
 	{
 		_is_settled = true;
@@ -147,7 +233,11 @@ bool Scene::Tick(gfx::LodParameters const & lod_parameters)
 
 void Scene::GenerateMesh(Mesh & mesh, geom::Space const & space) const
 {
-	mesh.Clear();
+	// patched and indexed meshes keep the parts which are still current
+	if (! mesh.IsPatching() && ! mesh.IsIndexed())
+	{
+		mesh.Clear();
+	}
 	_surrounding->ResetMeshPointers();
 	
 	_surrounding->GenerateMesh(mesh);
@@ -157,6 +247,18 @@ void Scene::GenerateMesh(Mesh & mesh, geom::Space const & space) const
 	properties._num_quaterne = _surrounding->GetNumQuaternaUsed();
 }
 
+void Scene::GenerateMesh(Mesh & mesh, geom::Space const & space, MeshFilter const & filter) const
+{
+	mesh.Clear();
+	_surrounding->ResetMeshPointers();
+	
+	_surrounding->GenerateMesh(mesh, & filter);
+	
+	MeshProperties & properties = mesh.GetProperties();
+	properties._space = space;
+	properties._num_quaterne = _surrounding->GetNumQuaternaUsed();
+}
+
 // Currently just updates the formation_map contents.
 void Scene::TickModels()
 {
@@ -178,6 +280,8 @@ void Scene::ResetPolyhedronSpaces(geom::Space const & space)
 
 void Scene::ResetFormations(geom::Space const & space)
 {
+	_reinit_depth = -1;
+	
 	for (auto & pair : formation_map) 
 	{
 		DeinitPolyhedron(pair);
@@ -193,14 +297,67 @@ void Scene::ResetFormations(geom::Space const & space)
 	_is_settled = false;
 }
 
+// Translates all points in place. The translation is performed in double
+// precision but the error in the original, single-precision positions remains.
+// This is then corrected by re-deriving mid-points level by level.
+void Scene::ReoriginFormations(geom::Space const & space)
+{
+	if (formation_map.empty())
+	{
+		return;
+	}
+	
+	// all polyhedra share the same space, so any one of them gives the delta
+	auto const & polyhedron = formation_map.begin()->second;
+	auto const & old_center = polyhedron.GetShape().center;
+	auto new_center = space.AbsToRel<double>(polyhedron.GetFormation().GetShape().center);
+	auto origin_delta = old_center - new_center;
+	
+	_surrounding->ResetNodeOrigins(origin_delta);
+	
+	// root points are derived from scratch
+	ResetPolyhedronSpaces(space);
+	
+	_reinit_depth = 0;
+	_is_settled = false;
+}
+
+// re-derives one level of each polyhedron; returns true if any nodes changed
+bool Scene::ReinitPolyhedra()
+{
+	ASSERT(_reinit_depth >= 0);
+	
+	auto changed = false;
+	for (auto & pair : formation_map)
+	{
+		Polyhedron & polyhedron = pair.second;
+		auto root_node = polyhedron.GetRootNode();
+		if (root_node)
+		{
+			changed |= _surrounding->ReinitNodes(* root_node, polyhedron, _reinit_depth);
+		}
+	}
+	
+	if (changed)
+	{
+		++ _reinit_depth;
+	}
+	else
+	{
+		_reinit_depth = -1;
+	}
+	
+	return changed;
+}
+
 void Scene::TickPolyhedron(Polyhedron & polyhedron)
 {
-	Node & root_node = polyhedron._root_node;
+	auto root_node = polyhedron.GetRootNode();
 	
-	if (root_node.IsExpandable()) 
+	if (root_node && root_node->IsExpandable()) 
 	{
 		CRAG_VERIFY(* this);
-		_surrounding->ExpandNode(root_node);
+		_surrounding->ExpandNode(* root_node);
 		CRAG_VERIFY(* this);
 	}
 }
@@ -212,7 +369,14 @@ void Scene::InitPolyhedron(FormationPair & pair, geom::Space const & space)
 
 	PointBuffer & points = _surrounding->GetPoints();
 	
-	polyhedron.Init(space, points);
+	auto root_node = _surrounding->CreateRootNode(polyhedron);
+	if (! root_node)
+	{
+		// the formation is left out of the scene
+		return;
+	}
+	
+	polyhedron.Init(space, points, * root_node);
 }
 
 void Scene::DeinitPolyhedron(FormationPair & pair)
@@ -220,11 +384,15 @@ void Scene::DeinitPolyhedron(FormationPair & pair)
 	Polyhedron & polyhedron = pair.second;
 	
 	// Collapse the root node by fair means or foul.
-	Node & root_node = polyhedron._root_node;
+	auto root_node = polyhedron.GetRootNode();
+	if (! root_node)
+	{
+		return;
+	}
 
-	_surrounding->CollapseNodes(root_node);
-	ASSERT(! root_node.HasChildren());
+	_surrounding->CollapseNodes(* root_node);
+	ASSERT(! root_node->HasChildren());
 
 	// Continue deinitialization somewhere a bit calmer.
-	polyhedron.Deinit(_surrounding->GetPoints());
+	_surrounding->DestroyRootNode(polyhedron.Deinit(_surrounding->GetPoints()));
 }
@@ -11,21 +11,19 @@
 
 #include "form/Polyhedron.h"
 
+#include "gfx/LodParameters.h"
+
 namespace geom
 {
 	class Space;
 }
 
-namespace gfx
-{
-	struct LodParameters;
-}
-
 namespace form
 {
 	class Formation;
 	class Polyhedron;
 	class Mesh;
+	class MeshFilter;
 	class Surrounding;
 	
 	// A representation (view?) of all the existing formations.
@@ -66,8 +64,14 @@ namespace form
 		void RemoveFormation(Formation const & formation);
 		Polyhedron const * GetPolyhedron(Formation const & formation) const;
 		
-		bool Tick(gfx::LodParameters const & lod_parameters);
+		// nodes are scored against the primary LOD center
+		// and any secondary LOD centers, e.g. of additional viewpoints
+		bool Tick(gfx::LodParameters const & lod_parameters, gfx::LodParametersVector const & secondary_lod_parameters = gfx::LodParametersVector());
 		void GenerateMesh(Mesh & mesh, geom::Space const & space) const;
+		
+		// generates the part of the mesh seen by one observer, e.g. that of a
+		// secondary LOD center; mesh must be neither patching nor indexed
+		void GenerateMesh(Mesh & mesh, geom::Space const & space, MeshFilter const & filter) const;
 	private:
 		
 		///////////////////////////////////////////////////////
@@ -76,6 +80,8 @@ namespace form
 		void TickModels();
 		void ResetPolyhedronSpaces(geom::Space const & space);
 		void ResetFormations(geom::Space const & space);
+		void ReoriginFormations(geom::Space const & space);
+		bool ReinitPolyhedra();
 
 		void TickPolyhedron(Polyhedron & model);
 
@@ -92,6 +98,10 @@ namespace form
 		
 		bool _is_settled = false;
 		bool _is_paused = false;
+		
+		// depth of nodes whose mid-points are next to be re-derived
+		// following an in-place change of space; -1 if there are none
+		int _reinit_depth = -1;
 	};
 
 }
@@ -11,10 +11,24 @@
 
 namespace form
 {
+	class Formation;
 	class Node;
 	class Point;
 	class Polyhedron;
 	
+	// a mid-point to be positioned on the edge shared by cousins, a and b
+	struct MidPointRequest
+	{
+		Polyhedron * polyhedron;
+		Node const * a;
+		Node const * b;
+		int index;
+		Point * mid_point;
+		bool result;	// set by Shader::InitMidPoints
+	};
+	
+	using MidPointRequestVector = std::vector<MidPointRequest>;
+	
 	// As with most things called shader, has absolutely FA to do with shade.
 	// Tesselates a shape given two/four surrounding points.
 	// Instance per form::Formation per form::Scene.
@@ -24,5 +38,19 @@ namespace form
 		virtual ~Shader() { }
 		virtual void InitRootPoints(form::Polyhedron & polyhedron, form::Point * points[]) const = 0;
 		virtual bool InitMidPoint(Polyhedron & polyhedron, Node const & a, Node const & b, int index, Point & mid_point) const = 0;
+		
+		// positions a batch of mid-points which all belong to polyhedron;
+		// override to calculate them together rather than one at a time
+		virtual void InitMidPoints(Polyhedron & polyhedron, MidPointRequest * begin, MidPointRequest * end) const
+		{
+			for (auto request = begin; request != end; ++ request)
+			{
+				request->result = InitMidPoint(polyhedron, * request->a, * request->b, request->index, * request->mid_point);
+			}
+		}
+		
+		// identifies the parameters which determine the mid-points of formation;
+		// zero indicates that mid-points should not be cached
+		virtual std::uint64_t GetMidPointCacheSignature(Formation const &) const { return 0; }
 	};
 }
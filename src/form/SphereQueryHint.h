@@ -0,0 +1,53 @@
+//
+//  form/SphereQueryHint.h
+//  crag
+//
+//  Created on 2026-10-18.
+//  This program is distributed under the terms of the GNU General Public License.
+//
+
+#pragma once
+
+#include "defs.h"
+
+namespace form
+{
+	////////////////////////////////////////////////////////////////////////////////
+	// forward-declarations
+
+	class Node;
+
+	// the deepest node whose projection wholly contained the sphere of a
+	// previous query; a subsequent query for a nearby sphere, e.g. around the
+	// same slow-moving body, can begin there rather than at the root node;
+	// the node may since have been moved, collapsed or re-used, so its surface
+	// is kept to check that it still represents the same part of the polyhedron
+	class SphereQueryHint
+	{
+	public:
+		void Reset()
+		{
+			_node = nullptr;
+		}
+		
+		Node const * GetNode() const
+		{
+			return _node;
+		}
+		
+		Triangle3 const & GetSurface() const
+		{
+			return _surface;
+		}
+		
+		void Set(Node const * node, Triangle3 const & surface)
+		{
+			_node = node;
+			_surface = surface;
+		}
+
+	private:
+		Node const * _node = nullptr;
+		Triangle3 _surface;
+	};
+}
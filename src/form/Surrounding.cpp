@@ -14,10 +14,14 @@
 #include "ForEachNodeFace.h"
 #include "GatherExpandableNodesFunctor.h"
 #include "Mesh.h"
+#include "MeshFilter.h"
 #include "Polyhedron.h"
 
 #include "gfx/LodParameters.h"
 
+#include "smp/ThreadPool.h"
+
+#include "core/app.h"
 #include "core/ConfigEntry.h"
 
 #if defined(CRAG_DEBUG)
@@ -37,7 +41,9 @@
 
 using namespace form;
 
-CONFIG_DECLARE (profile_mode, bool);
+// If true, systems hold their workload steady so that runs can be compared;
+// defined here because every program which runs the formation system links this file.
+CONFIG_DEFINE(profile_mode, false);
 
 ////////////////////////////////////////////////////////////////////////////////
 // file-local definitions
@@ -48,6 +54,68 @@ namespace
 	// It is useful for eliminating the adaptive quaterne count algorithm during debugging.
 	CONFIG_DEFINE(profile_num_quaterne, 6400);
 
+	// If true, node scores are calculated by multiple threads.
+	CONFIG_DEFINE(node_score_parallelization, true);
+	
+	// smallest batch of nodes worth handing to a scoring thread
+	constexpr auto min_nodes_per_score_job = 1024;
+	
+	// If true, mesh faces are generated by multiple threads.
+	CONFIG_DEFINE(mesh_generation_parallelization, true);
+	
+	// smallest batch of nodes worth handing to a mesh generation thread
+	constexpr auto min_nodes_per_mesh_job = 1024;
+	
+	// number of jobs per thread; >1 evens out uneven progress
+	constexpr auto num_jobs_per_thread = 4;
+	
+	// seconds spent expanding nodes per tick before the remaining candidates
+	// are left for the next tick; bounds the time between form thread messages;
+	// if zero, all candidates are tried in a single tick
+	CONFIG_DEFINE(node_expansion_time_budget, .005);
+	
+	// number of expansion candidates whose mid-points are calculated together;
+	// the time budget is checked between batches
+	constexpr auto expansion_batch_size = 64;
+	
+	// If true, the nodes of quaterne are periodically moved so that their
+	// order in memory follows a Z-order curve through their centers.
+	CONFIG_DEFINE(node_compaction, true);
+	
+	// number of changed ticks between compaction passes
+	CONFIG_DEFINE(node_compaction_period, 8);
+	
+	// most quaterne whose nodes are moved by a single compaction pass
+	CONFIG_DEFINE(node_compaction_max_swaps, 256);
+	
+	// number of bits per axis in a compaction key
+	constexpr auto compaction_key_bits = 21;
+	
+	// inserts two zero bits between each of the lower 21 bits of value
+	std::uint64_t SpreadBits(std::uint64_t value)
+	{
+		value &= 0x1fffff;
+		value = (value | (value << 32)) & 0x1f00000000ffff;
+		value = (value | (value << 16)) & 0x1f0000ff0000ff;
+		value = (value | (value << 8)) & 0x100f00f00f00f00f;
+		value = (value | (value << 4)) & 0x10c30c30c30c30c3;
+		value = (value | (value << 2)) & 0x1249249249249249;
+		return value;
+	}
+	
+	// interleaves the quantized coordinates of position within the given bounds
+	std::uint64_t GetMortonKey(Vector3 const & position, Vector3 const & lower, Vector3 const & scale)
+	{
+		std::uint64_t key = 0;
+		for (auto axis = 0; axis != 3; ++ axis)
+		{
+			auto quantized = static_cast<std::uint64_t>((position[axis] - lower[axis]) * scale[axis]);
+			key |= SpreadBits(quantized) << axis;
+		}
+		
+		return key;
+	}
+
 	bool QuaternaSortUnused(Quaterna const & lhs, Quaterna const & rhs)
 	{
 		return lhs.nodes < rhs.nodes;
@@ -68,18 +136,17 @@ namespace
 		}
 
 		// Repair cousin pointers.
-		Node::Triplet * triple = child.triple;
 		for (int i = 0; i < 3; ++ i) {
-			Node * cousin = triple[i].cousin;
+			Node * cousin = child.GetCousin(i);
 			if (cousin != nullptr) {
-				ASSERT(cousin->triple[i].cousin != nullptr);
-				ASSERT(cousin->triple[i].cousin != & child);
-				cousin->triple[i].cousin = & child;
+				ASSERT(cousin->GetCousin(i) != nullptr);
+				ASSERT(cousin->GetCousin(i) != & child);
+				child.RepairCousin(i);
 			}
 		}
 	}
 
-	void SubstituteChildren(Node * substitute, Node * original)
+	void SubstituteChildren(NodeBuffer & node_buffer, Node * substitute, Node * original)
 	{
 		Node * parent = original->GetParent();
 	
@@ -111,10 +178,28 @@ namespace
 			substitute[3] = original[3];
 		}
 	
-		ZeroArray(original, 4);
+		for (auto child_index = 0; child_index != 4; ++ child_index)
+		{
+			original[child_index].Clear();
+		}
+		
+		for (auto child_index = 0; child_index != 4; ++ child_index)
+		{
+			node_buffer.OnNodeChanged(substitute[child_index]);
+			node_buffer.OnNodeChanged(original[child_index]);
+		}
+	}
+
+	// exchanges the nodes of two quaterne by way of an unused quad of nodes
+	void SwapQuaternaNodes(NodeBuffer & node_buffer, Quaterna & a, Quaterna & b, Node * spare)
+	{
+		SubstituteChildren(node_buffer, spare, a.nodes);
+		SubstituteChildren(node_buffer, a.nodes, b.nodes);
+		SubstituteChildren(node_buffer, b.nodes, spare);
+		std::swap(a.nodes, b.nodes);
 	}
 
-	void FixUpDecreasedNodes(Quaterna * begin, Quaterna * end, int old_num_quaterne, Node const & new_nodes_used_end)
+	void FixUpDecreasedNodes(NodeBuffer & node_buffer, Quaterna * begin, Quaterna * end, int old_num_quaterne, Node const & new_nodes_used_end)
 	{
 		Quaterna * old_quaterne_used_end = begin + old_num_quaterne;
 		ASSERT(old_quaterne_used_end > end);
@@ -147,7 +232,7 @@ namespace
 				}
 				while (substitute_nodes < & new_nodes_used_end);
 
-				SubstituteChildren(unused_nodes, substitute_nodes);
+				SubstituteChildren(node_buffer, unused_nodes, substitute_nodes);
 				std::swap(used_quaterna->nodes, unused_quaterna->nodes);
 			}
 		
@@ -168,18 +253,49 @@ namespace
 // Surrounding functions
 
 Surrounding::Surrounding(int max_num_quaterne)
-: _node_buffer(max_num_quaterne * num_nodes_per_quaterna)
+: point_buffer(max_num_quaterne * num_verts_per_quaterna)
+, _node_buffer(max_num_quaterne * num_nodes_per_quaterna, point_buffer)
 , _quaterna_buffer(max_num_quaterne)
 , _target_num_quaterne(std::min(profile_mode ? profile_num_quaterne : 0, static_cast<int>(max_num_quaterne)))
-, point_buffer(max_num_quaterne * num_verts_per_quaterna)
+, _expandable_node_index(0)
+, _compaction_bounds({{ Vector3::Max(), - Vector3::Max() }})
+, _num_ticks_until_compaction(node_compaction_period)
+, _num_expansions(0)
+, _version(0)
 , _changed(true)
 {
 	InitQuaterna(std::begin(_quaterna_buffer) + _quaterna_buffer.capacity());
 	_expandable_nodes.reserve(max_num_quaterne * num_nodes_per_quaterna);
 
+	if (node_score_parallelization || mesh_generation_parallelization)
+	{
+		_thread_pool = smp::AcquireSharedThreadPool();
+	}
+	
+	if (_thread_pool)
+	{
+		auto max_num_jobs = _thread_pool->GetNumThreads() * num_jobs_per_thread;
+		if (node_score_parallelization)
+		{
+			_node_score_counters.resize(max_num_jobs);
+		}
+		
+		if (mesh_generation_parallelization)
+		{
+			_mesh_job_faces.resize(max_num_jobs + 1);
+		}
+	}
+
 	CRAG_VERIFY(* this);
 }
 
+int Surrounding::GetMaxCapacity()
+{
+	return std::min(
+		NodeBuffer::GetMaxCapacity() / num_nodes_per_quaterna,
+		PointBuffer::GetMaxCapacity() / num_verts_per_quaterna);
+}
+
 Surrounding::~Surrounding()
 {
 	CRAG_VERIFY(* this);
@@ -228,8 +344,8 @@ void Surrounding::VerifyUsed(Quaterna const & q) const
 	Node const * parent = q.nodes[0].GetParent();
 	
 	CRAG_VERIFY_TRUE(parent != nullptr);
-	CRAG_VERIFY_TRUE(parent->score == q.parent_score);
-	CRAG_VERIFY_TRUE(parent->score > 0);
+	CRAG_VERIFY_TRUE(parent->GetScore() == q.parent_score);
+	CRAG_VERIFY_TRUE(parent->GetScore() > 0);
 	
 	for (int i = 0; i < 4; ++ i)
 	{
@@ -294,6 +410,16 @@ int Surrounding::GetNumQuaternaUsed() const
 	return _quaterna_buffer.size();
 }
 
+int Surrounding::GetNumExpansions() const
+{
+	return _num_expansions;
+}
+
+std::uint32_t Surrounding::GetVersion() const
+{
+	return _version;
+}
+
 float Surrounding::GetMinParentScore() const
 {
 	if (_quaterna_buffer.empty())
@@ -339,14 +465,14 @@ void Surrounding::SetTargetNumQuaterna(int target_num_quaterne)
 
 // This is the main tick function for all things 'nodey'.
 // It is also where a considerable amount of the SceneThread's time is spent.
-bool Surrounding::Tick(gfx::LodParameters const & lod_parameters)
+bool Surrounding::Tick(gfx::LodParameters const & lod_parameters, gfx::LodParametersVector const & secondary_lod_parameters)
 {
 	CRAG_VERIFY (lod_parameters);
 	CRAG_VERIFY (* this);
 
 	// Is the new camera ray significantly different to 
 	// the one used to last score the bulk of the node buffer?
-	if (! _changed && ! node_score_functor.IsSignificantlyDifferent(lod_parameters.center))
+	if (! _changed && _expandable_nodes.empty() && ! node_score_functor.IsSignificantlyDifferent(lod_parameters, secondary_lod_parameters))
 	{
 		// if there are no changes to act upon, return false;
 		// caller knows that no new mesh is required
@@ -356,8 +482,9 @@ bool Surrounding::Tick(gfx::LodParameters const & lod_parameters)
 	// reset changed flag; this may get set on again before return
 	DEBUG_SURROUNDING_LOG_CHANGE(_changed, false);
 	
-	UpdateNodeScores(lod_parameters);
+	UpdateNodeScores(lod_parameters, secondary_lod_parameters);
 	UpdateNodes();
+	CompactNodes();
 
 	CRAG_VERIFY(* this);
 	
@@ -369,11 +496,16 @@ void Surrounding::OnReset()
 {
 	ASSERT(point_buffer.IsEmpty());
 	InitQuaterna(std::end(_quaterna_buffer));
+	
+	_expandable_nodes.clear();
 
 	_node_buffer.Clear();
 	
 	_quaterna_buffer.Clear();
+	
+	_compaction_bounds = {{ Vector3::Max(), - Vector3::Max() }};
 
+	++ _version;
 	DEBUG_SURROUNDING_LOG_CHANGE(_changed, true);
 
 	// Half the target number of nodes.
@@ -382,12 +514,62 @@ void Surrounding::OnReset()
 	CRAG_VERIFY(* this);
 }
 
-void Surrounding::ResetNodeOrigins(Vector3 const & origin_delta)
+// translates points in place; positions lose some precision in the process
+// which ReinitNodes can subsequently restore
+void Surrounding::ResetNodeOrigins(geom::Vector3d const & origin_delta)
 {
-	_node_buffer.ResetNodeOrigins(origin_delta);
+	point_buffer.ResetOrigin(origin_delta);
+	_node_buffer.ResetNodeOrigins();
+	
+	for (auto & bound : _compaction_bounds)
+	{
+		bound -= Vector3(origin_delta);
+	}
+	
+	++ _version;
 	DEBUG_SURROUNDING_LOG_CHANGE(_changed, true);
 }
 
+bool Surrounding::ReinitNodes(Node & node, Polyhedron & polyhedron, int depth)
+{
+	Node * children = node.GetChildren();
+	if (children == nullptr)
+	{
+		return false;
+	}
+	
+	if (depth == 0)
+	{
+		for (auto child = children; child != children + 4; ++ child)
+		{
+			child->Reinit(polyhedron, point_buffer);
+			_node_buffer.OnNodeChanged(* child);
+		}
+		
+		++ _version;
+		DEBUG_SURROUNDING_LOG_CHANGE(_changed, true);
+		return true;
+	}
+	
+	-- depth;
+	return ReinitNodes(children[0], polyhedron, depth)
+		| ReinitNodes(children[1], polyhedron, depth)
+		| ReinitNodes(children[2], polyhedron, depth)
+		| ReinitNodes(children[3], polyhedron, depth);
+}
+
+Node * Surrounding::CreateRootNode(Polyhedron & polyhedron)
+{
+	++ _version;
+	return _node_buffer.CreateRoot(polyhedron);
+}
+
+void Surrounding::DestroyRootNode(Node & root_node)
+{
+	++ _version;
+	_node_buffer.DestroyRoot(root_node);
+}
+
 void Surrounding::InitQuaterna(Quaterna const * end)
 {
 	auto n = std::begin(_node_buffer);
@@ -407,14 +589,46 @@ void Surrounding::UpdateNodes()
 	ExpandNodes();
 }
 
-void Surrounding::UpdateNodeScores(gfx::LodParameters const & lod_parameters)
+void Surrounding::UpdateNodeScores(gfx::LodParameters const & lod_parameters, gfx::LodParametersVector const & secondary_lod_parameters)
 {
-	node_score_functor.SetLodParameters(lod_parameters);
+	node_score_functor.SetLodParameters(lod_parameters, secondary_lod_parameters);
 	node_score_functor.ResetCounters();
-	for (auto & node : _node_buffer)
+
+	auto num_nodes = _node_buffer.GetSize();
+	auto max_num_jobs = static_cast<int>(_node_score_counters.size());
+	auto num_jobs = std::min(max_num_jobs, num_nodes / min_nodes_per_score_job);
+	auto const & score_data = _node_buffer.GetScoreData();
+	if (num_jobs <= 1)
 	{
-		node_score_functor(node);
+		CalculateNodeScoreFunctor::Counters counters;
+		counters.Reset();
+		node_score_functor(score_data, 0, num_nodes, counters);
+		_node_buffer.ApplyScores(0, num_nodes);
+		node_score_functor.MergeCounters(counters);
+		return;
 	}
+
+	// each job scores a contiguous range of nodes and
+	// collects its own leaf statistics which are merged afterwards
+	auto score_job = [&] (int job_index)
+	{
+		auto & counters = _node_score_counters[job_index];
+		counters.Reset();
+
+		auto job_begin = num_nodes * job_index / num_jobs;
+		auto job_end = num_nodes * (job_index + 1) / num_jobs;
+		node_score_functor(score_data, job_begin, job_end, counters);
+		_node_buffer.ApplyScores(job_begin, job_end);
+	};
+
+	ASSERT(_thread_pool);
+	_thread_pool->Run(num_jobs, score_job);
+
+	// min/max are order-independent so the result matches the serial pass
+	std::for_each(std::begin(_node_score_counters), std::begin(_node_score_counters) + num_jobs, [&] (CalculateNodeScoreFunctor::Counters const & counters)
+	{
+		node_score_functor.MergeCounters(counters);
+	});
 }
 
 void Surrounding::UpdateQuaterna()
@@ -428,30 +642,186 @@ void Surrounding::UpdateQuaterna()
 
 void Surrounding::ExpandNodes()
 {
-	ASSERT(_expandable_nodes.size() == 0);
-	
-	// Populate vector with nodes which might want expanding.
-	GatherExpandableNodesFunctor gather_functor(* this, _expandable_nodes);
-	for (auto & quaterna : _quaterna_buffer)
+	// Unless candidates remain from a previous tick,
+	// populate vector with nodes which might want expanding.
+	if (_expandable_nodes.empty())
 	{
-		gather_functor(quaterna);
+		GatherExpandableNodesFunctor gather_functor(* this, _expandable_nodes);
+		for (auto & quaterna : _quaterna_buffer)
+		{
+			gather_functor(quaterna);
+		}
+		
+		_expandable_node_index = 0;
 	}
 
-	// Traverse the vector and try and expand the nodes.
+	auto deadline = (node_expansion_time_budget > 0)
+		? app::GetTime() + node_expansion_time_budget
+		: std::numeric_limits<core::Time>::max();
+	
+	// Traverse the vector and try and expand the nodes;
+	// scores may have changed since candidates were gathered so are checked again.
 	auto min_score = GetLowestSortedQuaternaScore();
-	for (auto node : _expandable_nodes)
+	auto num_expandable_nodes = static_cast<int>(_expandable_nodes.size());
+	while (_expandable_node_index != num_expandable_nodes)
 	{
-		if (node->score > min_score
-			&& node->IsExpandable()
-			&& ExpandNode(* node)) 
+		auto batch_end = std::min(_expandable_node_index + expansion_batch_size, num_expandable_nodes);
+		RequestMidPoints(_expandable_node_index, batch_end, min_score);
+		
+		do
 		{
-			min_score = GetLowestSortedQuaternaScore();
+			auto & node = * _expandable_nodes[_expandable_node_index ++];
+			if (node.GetScore() > min_score
+				&& node.IsExpandable()
+				&& ExpandNode(node)) 
+			{
+				min_score = GetLowestSortedQuaternaScore();
+			}
+		}
+		while (_expandable_node_index != batch_end);
+		
+		if (app::GetTime() >= deadline)
+		{
+			// resume from here next tick
+			return;
 		}
 	}
 	
 	_expandable_nodes.clear();
 }
 
+// Over time, recycling of quaterne scatters related nodes across the buffer;
+// this moves the nodes of up to node_compaction_max_swaps quaterne so that
+// node passes, which run through the buffer in order, visit nearby nodes
+// together; repeated passes converge on a Z-ordered buffer.
+void Surrounding::CompactNodes()
+{
+	if (! node_compaction || -- _num_ticks_until_compaction > 0)
+	{
+		return;
+	}
+	
+	_num_ticks_until_compaction = node_compaction_period;
+	
+	auto num_quaterne = _quaterna_buffer.size();
+	if (num_quaterne < 2)
+	{
+		return;
+	}
+	
+	auto quaterne_begin = std::begin(_quaterna_buffer);
+	auto quaterne_end = std::end(_quaterna_buffer);
+	auto nodes_begin = std::begin(_node_buffer);
+	
+	// node centers are quantized within bounds which only grow so that
+	// the keys of nodes which have not changed remain the same
+	auto & lower = _compaction_bounds[0];
+	auto & upper = _compaction_bounds[1];
+	std::for_each(quaterne_begin, quaterne_end, [&] (Quaterna const & quaterna)
+	{
+		if (quaterna.IsInUse())
+		{
+			auto center = quaterna.nodes[0].GetCenter();
+			for (auto axis = 0; axis != 3; ++ axis)
+			{
+				lower[axis] = std::min(lower[axis], center[axis]);
+				upper[axis] = std::max(upper[axis], center[axis]);
+			}
+		}
+	});
+	
+	Vector3 scale;
+	for (auto axis = 0; axis != 3; ++ axis)
+	{
+		auto range = upper[axis] - lower[axis];
+		scale[axis] = (range > 0) ? Scalar((1 << compaction_key_bits) - 1) / range : Scalar(0);
+	}
+	
+	// order quaterne by key; unused quaterne go last
+	_compaction_keys.clear();
+	_compaction_owners.resize(num_quaterne);
+	std::for_each(quaterne_begin, quaterne_end, [&] (Quaterna & quaterna)
+	{
+		auto key = quaterna.IsInUse()
+			? GetMortonKey(quaterna.nodes[0].GetCenter(), lower, scale)
+			: std::numeric_limits<std::uint64_t>::max();
+		_compaction_keys.emplace_back(key, & quaterna);
+		
+		auto slot = (quaterna.nodes - nodes_begin) / num_nodes_per_quaterna;
+		_compaction_owners[slot] = & quaterna;
+	});
+	
+	std::sort(std::begin(_compaction_keys), std::end(_compaction_keys));
+	
+	// give the nth quaterna in key order the nth quad of nodes
+	static_assert(NodeBuffer::num_spare_nodes == num_nodes_per_quaterna, "nodes are swapped by way of the spare nodes");
+	auto spare = _node_buffer.GetSpareNodes();
+	auto num_swaps = 0;
+	for (auto slot = 0; slot != num_quaterne && num_swaps != node_compaction_max_swaps; ++ slot)
+	{
+		auto & quaterna = ref(_compaction_keys[slot].second);
+		auto & displaced = ref(_compaction_owners[slot]);
+		if (& quaterna == & displaced)
+		{
+			continue;
+		}
+		
+		SwapQuaternaNodes(_node_buffer, quaterna, displaced, spare);
+		
+		_compaction_owners[(displaced.nodes - nodes_begin) / num_nodes_per_quaterna] = & displaced;
+		_compaction_owners[slot] = & quaterna;
+		++ num_swaps;
+	}
+	
+	if (num_swaps > 0)
+	{
+		// pending candidates may have moved
+		_expandable_nodes.clear();
+	}
+	
+	CRAG_VERIFY(* this);
+}
+
+// calculates the missing mid-points of a range of expansion candidates in
+// one go so that ExpandNode is left with little more than pointer work
+void Surrounding::RequestMidPoints(int begin_index, int end_index, float min_score)
+{
+	ASSERT(_mid_point_requests.empty());
+	
+	for (auto index = begin_index; index != end_index; ++ index)
+	{
+		auto & node = * _expandable_nodes[index];
+		if (node.GetScore() <= min_score || ! node.IsExpandable())
+		{
+			continue;
+		}
+		
+		auto & polyhedron = ref(GetPolyhedron(node));
+		if (! node.RequestMidPoints(polyhedron, point_buffer, _mid_point_requests))
+		{
+			break;
+		}
+	}
+	
+	if (_mid_point_requests.empty())
+	{
+		return;
+	}
+	
+	Node::FulfillMidPointRequests(_mid_point_requests, point_buffer);
+	
+	// cousins share new mid-points and therefore have new faces
+	for (auto const & request : _mid_point_requests)
+	{
+		_node_buffer.OnNodeChanged(* request.a);
+		_node_buffer.OnNodeChanged(* request.b);
+	}
+	
+	++ _version;
+	_mid_point_requests.clear();
+	DEBUG_SURROUNDING_LOG_CHANGE(_changed, true);
+}
+
 void Surrounding::ResetMeshPointers() 
 {
 	CRAG_VERIFY(* this);
@@ -459,8 +829,34 @@ void Surrounding::ResetMeshPointers()
 	point_buffer.ClearPointers();
 }
 
-void Surrounding::GenerateMesh(Mesh & mesh) 
+void Surrounding::GenerateMesh(Mesh & mesh, MeshFilter const * filter) 
 {
+	// patched and indexed meshes keep faces between calls,
+	// which would be wrong for an observer who has since moved
+	ASSERT(! filter || (! mesh.IsPatching() && ! mesh.IsIndexed()));
+	
+	if (mesh.IsPatching())
+	{
+		PatchMesh(mesh);
+		return;
+	}
+	
+	if (mesh.IsIndexed())
+	{
+		GenerateIndexedMesh(mesh);
+		return;
+	}
+	
+#if defined(CRAG_FORM_FLAT_SHADE)
+	auto max_num_jobs = static_cast<int>(_mesh_job_faces.size()) - 1;
+	auto num_jobs = std::min(max_num_jobs, _node_buffer.GetSize() / min_nodes_per_mesh_job);
+	if (num_jobs > 1)
+	{
+		GenerateMeshParallel(mesh, num_jobs, filter);
+		return;
+	}
+#endif
+	
 	for (auto const & node : _node_buffer)
 	{
 		if (! node.IsLeaf()) 
@@ -468,8 +864,13 @@ void Surrounding::GenerateMesh(Mesh & mesh)
 			continue;
 		}
 		
-		ForEachNodeFace(node, [& mesh] (Point & a, Point & b, Point & c, geom::Vector3f const & normal, float /*score*/)
+		ForEachNodeFace(node, [& mesh, filter] (Point & a, Point & b, Point & c, geom::Vector3f const & normal, float /*score*/)
 		{
+			if (filter && ! filter->Includes(a.pos, b.pos, c.pos, normal))
+			{
+				return;
+			}
+			
 			auto color = Mesh::Vertex::Color::White();
 			
 			mesh.AddFace(a, b, c, normal, color);
@@ -477,8 +878,206 @@ void Surrounding::GenerateMesh(Mesh & mesh)
 	}
 
 #if ! defined(CRAG_FORM_FLAT_SHADE)
-	mesh.NormalizeNormals();
+	auto num_vertices = mesh.GetNumVertices();
+	auto num_normalize_jobs = ! _mesh_job_faces.empty() ? std::min(_thread_pool->GetNumThreads() * num_jobs_per_thread, num_vertices / min_nodes_per_mesh_job) : 0;
+	if (num_normalize_jobs > 1)
+	{
+		auto normalize_job = [&] (int job_index)
+		{
+			mesh.NormalizeNormals(num_vertices * job_index / num_normalize_jobs, num_vertices * (job_index + 1) / num_normalize_jobs);
+		};
+		_thread_pool->Run(num_normalize_jobs, normalize_job);
+	}
+	else
+	{
+		mesh.NormalizeNormals();
+	}
+#endif
+}
+
+// regenerates the chunks of the mesh whose nodes changed since it was last generated
+void Surrounding::GenerateIndexedMesh(Mesh & mesh)
+{
+	auto num_nodes = _node_buffer.GetSize();
+	auto num_chunks = (num_nodes + Mesh::num_nodes_per_chunk - 1) / Mesh::num_nodes_per_chunk;
+	mesh.BeginIndexedMesh(num_chunks);
+	
+	auto serial = _node_buffer.GetChangeSerial();
+	
+	// a point's normal depends on faces which may lie in other chunks
+	for (auto const & node : _node_buffer)
+	{
+		if (node.IsLeaf())
+		{
+			ForEachNodeFace(node, [& mesh] (Point & a, Point & b, Point & c, geom::Vector3f const & normal, float /*score*/)
+			{
+				mesh.AddPointNormals(a, b, c, normal);
+			});
+		}
+	}
+	
+	auto add_face = [& mesh] (Point & a, Point & b, Point & c, geom::Vector3f const & /*normal*/, float /*score*/)
+	{
+		mesh.AddIndexedFace(a, b, c);
+	};
+	
+	for (auto chunk_index = 0; chunk_index != num_chunks; ++ chunk_index)
+	{
+		auto begin = chunk_index * Mesh::num_nodes_per_chunk;
+		auto end = std::min(begin + int(Mesh::num_nodes_per_chunk), num_nodes);
+		
+		if (mesh.GetChunkNumNodes(chunk_index) == end - begin)
+		{
+			auto chunk_serial = mesh.GetChunkSerial(chunk_index);
+			auto is_changed = false;
+			for (auto index = begin; index != end; ++ index)
+			{
+				if (_node_buffer.GetChangeSerial(index) > chunk_serial)
+				{
+					is_changed = true;
+					break;
+				}
+			}
+			
+			if (! is_changed)
+			{
+				mesh.UpdateChunkNormals(chunk_index, serial);
+				continue;
+			}
+		}
+		
+		mesh.BeginChunk(chunk_index, end - begin, serial);
+		
+		for (auto index = begin; index != end; ++ index)
+		{
+			auto const & node = _node_buffer[index];
+			if (node.IsLeaf())
+			{
+				ForEachNodeFace(node, add_face);
+			}
+		}
+		
+		mesh.EndChunk();
+	}
+	
+	// subsequent changes are stamped with a new serial
+	_node_buffer.IncrementChangeSerial();
+}
+
+#if defined(CRAG_FORM_FLAT_SHADE)
+// Faces are written in the same order as the serial pass but by multiple threads.
+// A first pass counts the faces of each job's range of nodes; a prefix sum of the
+// counts gives each job a disjoint range of the mesh to write in a second pass.
+void Surrounding::GenerateMeshParallel(Mesh & mesh, int num_jobs, MeshFilter const * filter)
+{
+	ASSERT(_thread_pool);
+	ASSERT(num_jobs + 1 <= static_cast<int>(_mesh_job_faces.size()));
+	
+	auto num_nodes = _node_buffer.GetSize();
+	auto get_job_begin = [&] (int job_index)
+	{
+		return num_nodes * job_index / num_jobs;
+	};
+	
+	// count
+	auto count_job = [&] (int job_index)
+	{
+		auto num_faces = 0;
+		for (auto index = get_job_begin(job_index), end = get_job_begin(job_index + 1); index != end; ++ index)
+		{
+			auto const & node = _node_buffer[index];
+			if (! node.IsLeaf())
+			{
+				continue;
+			}
+			
+			if (! filter)
+			{
+				num_faces += GetNumNodeFaces(node);
+				continue;
+			}
+			
+			ForEachNodeFace(node, [&] (Point & a, Point & b, Point & c, geom::Vector3f const & normal, float /*score*/)
+			{
+				if (filter->Includes(a.pos, b.pos, c.pos, normal))
+				{
+					++ num_faces;
+				}
+			});
+		}
+		
+		_mesh_job_faces[job_index + 1] = num_faces;
+	};
+	_thread_pool->Run(num_jobs, count_job);
+	
+	// sum
+	_mesh_job_faces[0] = 0;
+	std::partial_sum(std::begin(_mesh_job_faces), std::begin(_mesh_job_faces) + num_jobs + 1, std::begin(_mesh_job_faces));
+	mesh.ResizeFaces(_mesh_job_faces[num_jobs]);
+	
+	// write
+	auto write_job = [&] (int job_index)
+	{
+		auto face_index = _mesh_job_faces[job_index];
+		for (auto index = get_job_begin(job_index), end = get_job_begin(job_index + 1); index != end; ++ index)
+		{
+			auto const & node = _node_buffer[index];
+			if (! node.IsLeaf())
+			{
+				continue;
+			}
+			
+			ForEachNodeFace(node, [&] (Point & a, Point & b, Point & c, geom::Vector3f const & normal, float /*score*/)
+			{
+				if (filter && ! filter->Includes(a.pos, b.pos, c.pos, normal))
+				{
+					return;
+				}
+				
+				mesh.SetFace(face_index, a, b, c, normal, Mesh::Vertex::Color::White());
+				++ face_index;
+			});
+		}
+		
+		ASSERT(face_index == _mesh_job_faces[job_index + 1]);
+	};
+	_thread_pool->Run(num_jobs, write_job);
+}
 #endif
+
+// rewrites the slots of nodes which changed since mesh was last generated
+void Surrounding::PatchMesh(Mesh & mesh)
+{
+	auto num_nodes = _node_buffer.GetSize();
+	auto base_serial = mesh.BeginPatch(num_nodes, _node_buffer.GetChangeSerial());
+	
+	auto add_face = [& mesh] (Point & a, Point & b, Point & c, geom::Vector3f const & normal, float /*score*/)
+	{
+		auto color = Mesh::Vertex::Color::White();
+		
+		mesh.AddFace(a, b, c, normal, color);
+	};
+	
+	for (auto index = 0; index != num_nodes; ++ index)
+	{
+		if (_node_buffer.GetChangeSerial(index) <= base_serial)
+		{
+			continue;
+		}
+		
+		mesh.BeginSlot(index);
+		
+		auto const & node = _node_buffer[index];
+		if (node.IsLeaf())
+		{
+			ForEachNodeFace(node, add_face);
+		}
+		
+		mesh.EndSlot();
+	}
+	
+	// subsequent changes are stamped with a new serial
+	_node_buffer.IncrementChangeSerial();
 }
 
 ///////////////////////////////////////////////////////
@@ -533,7 +1132,7 @@ bool Surrounding::ExpandNode(Node & node)
 	// But also, there's a slim chance that node's parent has a worse score than node's
 	// and we can't end up finding a quaterna that includes node as node's new children
 	// because that would cause a time paradox in the fabric of space.
-	float score = node.score;
+	float score = node.GetScore();
 	
 	// Ok, lets try the end of the sequence of sorted quaterne...
 	
@@ -572,14 +1171,35 @@ bool Surrounding::ExpandNode(Node & node, Quaterna & children_quaterna)
 	
 	// Note that after this point, expansion may fail but the node may have new mid-points.
 	Polyhedron & polyhedron = ref(GetPolyhedron(node));
-	if (! node.InitMidPoints(polyhedron, point_buffer))
+	Point const * previous_mid_points[3] = { node.GetMidPoint(0), node.GetMidPoint(1), node.GetMidPoint(2) };
+	auto mid_points_initialized = node.InitMidPoints(polyhedron, point_buffer);
+	
+	// the node and its cousins share any new mid-points and therefore
+	// have new faces, even if expansion goes on to fail
+	if (previous_mid_points[0] != node.GetMidPoint(0)
+		|| previous_mid_points[1] != node.GetMidPoint(1)
+		|| previous_mid_points[2] != node.GetMidPoint(2))
+	{
+		_node_buffer.OnNodeChanged(node);
+		for (auto triplet_index = 0; triplet_index != 3; ++ triplet_index)
+		{
+			auto cousin = node.GetCousin(triplet_index);
+			if (cousin != nullptr)
+			{
+				_node_buffer.OnNodeChanged(* cousin);
+			}
+		}
+		
+		++ _version;
+	}
+	
+	if (! mid_points_initialized)
 	{
 		return false;
 	}
 	
-	// Work with copy of children until it's certain that expansion is going to work.
-	Node children_copy[4];	
-	if (! Node::InitChildCorners(node, children_copy)) 
+	// Make sure that expansion is going to work before touching the children.
+	if (! Node::CanInitChildCorners(node)) 
 	{
 		// Probably, a child is too small to be represented using float accuracy.
 		return false;
@@ -591,20 +1211,18 @@ bool Surrounding::ExpandNode(Node & node, Quaterna & children_quaterna)
 	{
 		DeinitChildren(worst_children);
 	}
-	ASSERT(worst_children[0].score == 0);
-	ASSERT(worst_children[1].score == 0);
-	ASSERT(worst_children[2].score == 0);
-	ASSERT(worst_children[3].score == 0);
+	ASSERT(worst_children[0].GetScore() == 0);
+	ASSERT(worst_children[1].GetScore() == 0);
+	ASSERT(worst_children[2].GetScore() == 0);
+	ASSERT(worst_children[3].GetScore() == 0);
 	
-	worst_children[0] = children_copy[0];
-	worst_children[1] = children_copy[1];
-	worst_children[2] = children_copy[2];
-	worst_children[3] = children_copy[3];
+	Node::InitChildCorners(node, worst_children);
 
 	node.SetChildren(worst_children);
 	InitChildPointers(node);
+	_node_buffer.OnNodeChanged(node);
 	
-	children_quaterna.parent_score = node.score;
+	children_quaterna.parent_score = node.GetScore();
 	
 	// If Surrounding::Tick iterates over the nodes multiple times, the new-comers need their scores corrected.
 	// To call UpdateNodeScores would be inefficient as it scores every used node. 
@@ -617,6 +1235,26 @@ bool Surrounding::ExpandNode(Node & node, Quaterna & children_quaterna)
 		node_score_functor (children_quaterna.nodes[3]);
 	}
 	
+	_node_buffer.OnNodeChanged(worst_children[0]);
+	_node_buffer.OnNodeChanged(worst_children[1]);
+	_node_buffer.OnNodeChanged(worst_children[2]);
+	_node_buffer.OnNodeChanged(worst_children[3]);
+	
+	// neighbours which gained a cousin may now use a shared mid-point
+	for (auto child = worst_children; child != worst_children + 4; ++ child)
+	{
+		for (auto triplet_index = 0; triplet_index != 3; ++ triplet_index)
+		{
+			auto cousin = child->GetCousin(triplet_index);
+			if (cousin != nullptr)
+			{
+				_node_buffer.OnNodeChanged(* cousin);
+			}
+		}
+	}
+	
+	++ _num_expansions;
+	++ _version;
 	DEBUG_SURROUNDING_LOG_CHANGE(_changed, true);
 	return true;
 }
@@ -661,6 +1299,7 @@ void Surrounding::CollapseNode(Node & node)
 	{
 		DeinitChildren(children);
 		node.SetChildren(nullptr);
+		_node_buffer.OnNodeChanged(node);
 	}
 }
 
@@ -668,7 +1307,6 @@ void Surrounding::CollapseNode(Node & node)
 // Also make sure all children know who their parent is.
 void Surrounding::InitChildPointers(Node & parent_node)
 {
-	Node::Triplet const * parent_triple = parent_node.triple;
 	Node * child_nodes = parent_node.GetChildren();
 	Node & center = child_nodes[3];
 	
@@ -678,8 +1316,8 @@ void Surrounding::InitChildPointers(Node & parent_node)
 
 		// This is the side which the child shares with its sibling in the center.
 		// anteroposterior
-		ASSERT(node.triple[i].corner == parent_triple[i].corner);
-		ASSERT(node.triple[i].mid_point == nullptr);
+		ASSERT(node.GetCorner(i) == parent_node.GetCorner(i));
+		ASSERT(node.GetMidPoint(i) == nullptr);
 		node.SetCousin(i, center);
 		
 		int j = TriMod(i + 1);
@@ -688,8 +1326,8 @@ void Surrounding::InitChildPointers(Node & parent_node)
 		// The other two corners are shared with children of the parent's children.
 
 		// dextrosinister #1
-		ASSERT(node.triple[j].corner == parent_triple[k].mid_point);
-		Node * parent_cousin_j = parent_triple[j].cousin;
+		ASSERT(node.GetCorner(j) == parent_node.GetMidPoint(k));
+		Node * parent_cousin_j = parent_node.GetCousin(j);
 		if (parent_cousin_j != nullptr) {
 			Node * parent_cousin_children_j = parent_cousin_j->GetChildren();
 			if (parent_cousin_children_j != nullptr) {
@@ -698,8 +1336,8 @@ void Surrounding::InitChildPointers(Node & parent_node)
 		}
 		
 		// dextrosinister #2
-		ASSERT(node.triple[k].corner == parent_triple[j].mid_point);
-		Node * parent_cousin_k = parent_triple[k].cousin;
+		ASSERT(node.GetCorner(k) == parent_node.GetMidPoint(j));
+		Node * parent_cousin_k = parent_node.GetCousin(k);
 		if (parent_cousin_k != nullptr) {
 			Node * parent_cousin_children_k = parent_cousin_k->GetChildren();
 			if (parent_cousin_children_k != nullptr) {
@@ -708,62 +1346,68 @@ void Surrounding::InitChildPointers(Node & parent_node)
 		}
 		
 		node.seed = parent_node.GetChildSeed(i);
+		node.depth = parent_node.depth + 1;
 		node.SetParent(& parent_node);
 	}
 	
 	center.seed = parent_node.GetChildSeed(3);
+	center.depth = parent_node.depth + 1;
 	center.SetParent(& parent_node);
 }
 
 void Surrounding::DeinitChildren(Node * children)
 {
-	ASSERT(children->GetParent()->GetChildren() == children);
-	children->GetParent()->SetChildren(nullptr);
+	auto & parent = ref(children->GetParent());
+	ASSERT(parent.GetChildren() == children);
+	parent.SetChildren(nullptr);
+	_node_buffer.OnNodeChanged(parent);
+	++ _version;
 	
 	DeinitNode(children[0]);
 	DeinitNode(children[1]);
 	DeinitNode(children[2]);
 	DeinitNode(children[3]);
+	
+	// the quaterna's mid-points are freed together
+	point_buffer.Destroy(_freed_points);
 }
 
-// Nulls all the relevant pointers, disconnects cousins, frees verts.
+// Nulls all the relevant pointers, disconnects cousins, frees verts;
+// the freeing of verts is completed by DeinitChildren.
 void Surrounding::DeinitNode(Node & node)
 {
 	CollapseNode(node);
 	
 	for (int i = 0; i < 3; ++ i)
 	{
-		Node::Triplet & t = node.triple[i];
+		node.SetCorner(i, nullptr);
 		
-		t.corner = nullptr;
-		
-		if (t.cousin != nullptr)
+		Node * mirror_node = node.GetCousin(i);
+		if (mirror_node != nullptr)
 		{
-			Node::Triplet & mirror = t.cousin->triple[i];
-			ASSERT(mirror.cousin == & node);
-			ASSERT(mirror.mid_point == t.mid_point);
-			
-			t.cousin = nullptr;
-			t.mid_point = nullptr;
+			node.DetachCousin(i);
 			
-			mirror.cousin = nullptr;
+			// without its cousin, the mid-point no longer contributes to its faces
+			_node_buffer.OnNodeChanged(* mirror_node);
 		}
 		else
 		{
 			// there is no cousin
-			if (t.mid_point != nullptr)
+			Point * mid_point = node.GetMidPoint(i);
+			if (mid_point != nullptr)
 			{
 				// and there is a mid-point, so delete it.
-				point_buffer.Destroy(t.mid_point);
-				t.mid_point = nullptr;
+				_freed_points.push_back(mid_point);
+				node.SetMidPoint(i, nullptr);
 			}
 		}
 		
-		ASSERT(t.mid_point == nullptr);
+		ASSERT(node.GetMidPoint(i) == nullptr);
 	}
 	
 	node.SetParent(nullptr);
-	node.score = 0;
+	node.SetScore(0);
+	_node_buffer.OnNodeChanged(node);
 }
 
 void Surrounding::IncreaseNodes(int target_num_quaterne)
@@ -786,6 +1430,9 @@ void Surrounding::DecreaseNodes(int target_num_quaterne)
 {
 	auto old_num_quaterne = _quaterna_buffer.size();
 
+	// nodes are about to be moved so pending candidates may be invalidated
+	_expandable_nodes.clear();
+
 	// First decrease the number of quaterne. This is the bit that sometimes fails.
 	DecreaseQuaterna(target_num_quaterne);
 	
@@ -860,7 +1507,7 @@ void Surrounding::FixUpDecreasedNodes(int old_num_quaterne)
 
 	CRAG_VERIFY_ARRAY_ELEMENT(new_nodes_used_end, std::begin(_node_buffer), old_nodes_used_end);
 	
-	::FixUpDecreasedNodes(std::begin(_quaterna_buffer), std::end(_quaterna_buffer), old_num_quaterne, * new_nodes_used_end);
+	::FixUpDecreasedNodes(_node_buffer, std::begin(_quaterna_buffer), std::end(_quaterna_buffer), old_num_quaterne, * new_nodes_used_end);
 	
 	// revise down the number of nodes in use
 	_node_buffer.Pop(static_cast<int>(old_nodes_used_end - new_nodes_used_end));
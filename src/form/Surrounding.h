@@ -12,6 +12,7 @@
 #include "PointBuffer.h"
 #include "QuaternaBuffer.h"
 #include "NodeBuffer.h"
+#include "Shader.h"
 
 #include "gfx/LodParameters.h"
 
@@ -19,12 +20,19 @@
 
 #include "CalculateNodeScoreFunctor.h"
 
+namespace smp
+{
+	class ThreadPool;
+}
+
 namespace form
 {
 	////////////////////////////////////////////////////////////////////////////////
 	// forward-declarations
 	
 	class Mesh;
+	class MeshFilter;
+	class Polyhedron;
 	class Shader;
 	
 	struct Quaterna;
@@ -51,6 +59,9 @@ namespace form
 		Surrounding(int max_num_quaterne);
 		~Surrounding();
 		
+		// the largest max_num_quaterne which the node and point buffers can hold
+		static int GetMaxCapacity();
+		
 #if defined(CRAG_VERIFY_ENABLED)
 		CRAG_VERIFY_INVARIANTS_DECLARE(Surrounding);
 		void VerifyUsed(Quaterna const & q) const;
@@ -63,6 +74,13 @@ namespace form
 		int GetNumNodesUsed() const;
 		int GetNumQuaternaUsed() const;
 		
+		// running total of successful calls to ExpandNode
+		int GetNumExpansions() const;
+		
+		// incremented whenever the faces of any node change;
+		// nodes which merely move within the buffer don't count
+		std::uint32_t GetVersion() const;
+		
 		// returns 0 if there are none
 		float GetMinParentScore() const;
 		
@@ -73,20 +91,37 @@ namespace form
 		int GetTargetNumQuaterna() const;
 		void SetTargetNumQuaterna(int n);
 		
-		bool Tick(gfx::LodParameters const & lod_parameters);
+		bool Tick(gfx::LodParameters const & lod_parameters, gfx::LodParametersVector const & secondary_lod_parameters = gfx::LodParametersVector());
 		void OnReset();
-		void ResetNodeOrigins(Vector3 const & origin_delta);
+		void ResetNodeOrigins(geom::Vector3d const & origin_delta);
+		
+		// re-derives the mid-points of the descendants of node at the given depth;
+		// returns false if node has no descendants at that depth
+		bool ReinitNodes(Node & node, Polyhedron & polyhedron, int depth);
+		
+		// returns null if there is no room for another root node
+		Node * CreateRootNode(Polyhedron & polyhedron);
+		void DestroyRootNode(Node & root_node);
 	private:
 		void InitQuaterna(Quaterna const * end);
 		
 		void UpdateNodes();
-		void UpdateNodeScores(gfx::LodParameters const & lod_parameters);
+		void UpdateNodeScores(gfx::LodParameters const & lod_parameters, gfx::LodParametersVector const & secondary_lod_parameters);
 		void UpdateQuaterna();
 		void ExpandNodes();
+		void RequestMidPoints(int begin_index, int end_index, float min_score);
+		void CompactNodes();
+		
+		void PatchMesh(Mesh & mesh);
+		void GenerateMeshParallel(Mesh & mesh, int num_jobs, MeshFilter const * filter);
+		void GenerateIndexedMesh(Mesh & mesh);
 	public:
 		
 		void ResetMeshPointers();
-		void GenerateMesh(Mesh & mesh);
+		
+		// if filter is given, only the faces it includes are added
+		// and mesh must be neither patching nor indexed
+		void GenerateMesh(Mesh & mesh, MeshFilter const * filter = nullptr);
 		
 		bool IsChildNode(Node const & node) const;
 		bool IsValidNodePointer(Node const * node) const;
@@ -101,7 +136,6 @@ namespace form
 		void CollapseNodes(Node & root);
 	private:
 		void CollapseNode(Node & node);
-		static bool InitChildGeometry(Node const & parent, Node * children_copy);
 		static void InitChildPointers(Node & parent_node);
 		
 		void DeinitChildren(Node * children);
@@ -116,18 +150,44 @@ namespace form
 		////////////////////////////////////////////////////////////////////////////////
 		// variables
 
+		// Pool of vertices from which to take the corners of nodes.
+		PointBuffer point_buffer;
+		
 		NodeBuffer _node_buffer;
 		
 		QuaternaBuffer _quaterna_buffer;
 		int _target_num_quaterne;
-		// Pool of vertices from which to take the corners of nodes.
-		PointBuffer point_buffer;
 		
 		CalculateNodeScoreFunctor node_score_functor;
+
+		// shared with other systems to spread scoring and mesh generation
+		// across cores; null on single-core systems or if neither is parallelized
+		std::shared_ptr<smp::ThreadPool> _thread_pool;
+		std::vector<CalculateNodeScoreFunctor::Counters> _node_score_counters;
+		
+		// used by GenerateMesh to allot faces to jobs
+		std::vector<int> _mesh_job_faces;
 		
-		// used by ChurnNodes
+		// used by ExpandNodes; candidates which remain when the time budget
+		// runs out are tried in subsequent ticks, starting at the given index
 		NodeVector _expandable_nodes;
+		int _expandable_node_index;
+		
+		// used by ExpandNodes to calculate the mid-points of candidates together
+		MidPointRequestVector _mid_point_requests;
+		
+		// used by DeinitChildren to free mid-points together
+		std::vector<Point *> _freed_points;
+		
+		// used by CompactNodes to order quaterne and to track which
+		// quaterna owns each quad of nodes
+		std::vector<std::pair<std::uint64_t, Quaterna *>> _compaction_keys;
+		std::vector<Quaterna *> _compaction_owners;
+		std::array<Vector3, 2> _compaction_bounds;
+		int _num_ticks_until_compaction;
 		
+		int _num_expansions;
+		std::uint32_t _version;
 		bool _changed;
 	};
 	
@@ -12,6 +12,11 @@
 #include "geom/Ray.h"
 #include "geom/Sphere.h"
 
+// If defined, form::Node refers to nodes and points using 32-bit indices
+// rather than pointers which roughly halves its size on 64-bit systems;
+// comment out for nodes which are easier to inspect in a debugger.
+#define CRAG_FORM_COMPACT_NODES
+
 namespace form
 {
 	// forward-delcares
@@ -27,6 +32,10 @@ namespace form
 	typedef geom::Sphere<Scalar, 3> Sphere3;
 	typedef geom::Triangle<Scalar, 3> Triangle3;
 	
+	// number of root nodes stored by a NodeBuffer in addition to its other
+	// nodes; limits the number of formations a Scene can represent
+	constexpr int max_num_root_nodes = 64;
+	
 	// thread-safe node vector
 	typedef std::vector<Node *> NodeVector;
 }
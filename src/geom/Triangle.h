@@ -46,6 +46,18 @@ namespace geom
 		Array points;
 	};
 
+	template <typename S, int N>
+	bool operator==(Triangle<S, N> const & lhs, Triangle<S, N> const & rhs)
+	{
+		return lhs.points[0] == rhs.points[0] && lhs.points[1] == rhs.points[1] && lhs.points[2] == rhs.points[2];
+	}
+
+	template <typename S, int N>
+	bool operator!=(Triangle<S, N> const & lhs, Triangle<S, N> const & rhs)
+	{
+		return ! (lhs == rhs);
+	}
+
 	template <typename S, int N>
 	Vector<S, N> Centroid(Triangle<S, N> const & t)
 	{
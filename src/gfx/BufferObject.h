@@ -154,14 +154,21 @@ namespace gfx
 		}
 		
 		void BufferSubData(GLsizeiptr num, ELEMENT const * array)
+		{
+			BufferSubData(0, num, array);
+		}
+		
+		void BufferSubData(GLintptr first, GLsizeiptr num, ELEMENT const * array)
 		{
 			CRAG_VERIFY(* this);
 			CRAG_VERIFY_TRUE(IsInitialized());
 			CRAG_VERIFY_TRUE(IsBound());
+			CRAG_VERIFY_OP(first, >= , 0);
 			CRAG_VERIFY_OP(num, >= , 0);
+			GLintptr offset = sizeof(ELEMENT) * first;
 			GLsizeiptr size = sizeof(ELEMENT) * num;
 
-			GL_CALL(glBufferSubData(TARGET, 0, size, array));
+			GL_CALL(glBufferSubData(TARGET, offset, size, array));
 
 			CRAG_VERIFY(* this);
 			CRAG_VERIFY_TRUE(IsInitialized());
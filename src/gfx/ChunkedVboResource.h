@@ -0,0 +1,126 @@
+//
+//  gfx/ChunkedVboResource.h
+//  crag
+//
+//  Created on 2026-10-18.
+//  This program is distributed under the terms of the GNU General Public License.
+//
+
+#pragma once
+
+#include "IndexedVboResource.h"
+
+namespace gfx
+{
+	// a sequence of indexed vertex buffer objects which are drawn together;
+	// allows a mesh to exceed the limits of ElementIndex and
+	// allows chunks to be updated independently of one another
+	template<typename VERTEX, GLenum USAGE>
+	class ChunkedVboResource : public VboResource
+	{
+		////////////////////////////////////////////////////////////////////////////////
+		// types
+	public:
+		typedef VERTEX Vertex;
+		typedef IndexedVboResource<VERTEX, USAGE> Chunk;
+		typedef typename Chunk::Mesh Mesh;
+
+		////////////////////////////////////////////////////////////////////////////////
+		// functions
+
+		// verification
+		CRAG_VERIFY_INVARIANTS_DEFINE_TEMPLATE_BEGIN(ChunkedVboResource, self)
+			for (auto const & chunk : self._chunks)
+			{
+				CRAG_VERIFY(chunk);
+			}
+		CRAG_VERIFY_INVARIANTS_DEFINE_TEMPLATE_END
+
+		// c'tors
+		ChunkedVboResource() = default;
+
+		ChunkedVboResource(ChunkedVboResource && rhs)
+		: _chunks(std::move(rhs._chunks))
+		{
+			CRAG_VERIFY(* this);
+		}
+
+		ChunkedVboResource & operator=(ChunkedVboResource && rhs)
+		{
+			_chunks = std::move(rhs._chunks);
+
+			CRAG_VERIFY(* this);
+			return * this;
+		}
+
+		// set data
+		int GetNumChunks() const
+		{
+			return static_cast<int>(_chunks.size());
+		}
+
+		void SetNumChunks(int num_chunks)
+		{
+			ASSERT(num_chunks >= 0);
+			_chunks.resize(num_chunks);
+		}
+
+		void SetChunk(int chunk_index, Mesh const & mesh)
+		{
+			CRAG_VERIFY_OP(chunk_index, >=, 0);
+			CRAG_VERIFY_OP(chunk_index, <, GetNumChunks());
+
+			auto & chunk = _chunks[chunk_index];
+			if (mesh.GetIndices().empty())
+			{
+				// release the buffers of chunks which are no longer used
+				chunk = Chunk();
+			}
+			else
+			{
+				chunk.Set(mesh);
+			}
+
+			CRAG_VERIFY(* this);
+		}
+
+		// get state
+		bool empty() const
+		{
+			return std::all_of(std::begin(_chunks), std::end(_chunks), [] (Chunk const & chunk)
+			{
+				return chunk.empty();
+			});
+		}
+
+		// rendering; each chunk is bound in turn from within Draw
+		void Activate() const override
+		{
+		}
+
+		void Deactivate() const override
+		{
+		}
+
+		void Draw() const override
+		{
+			for (auto const & chunk : _chunks)
+			{
+				if (chunk.empty())
+				{
+					continue;
+				}
+
+				chunk.Activate();
+				chunk.Draw();
+				chunk.Deactivate();
+			}
+		}
+
+	private:
+		////////////////////////////////////////////////////////////////////////////////
+		// variables
+
+		std::vector<Chunk> _chunks;
+	};
+}
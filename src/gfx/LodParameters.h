@@ -22,12 +22,19 @@ namespace gfx
 		// with minimum range within which detail does not increase
 		Vector3 center;
 		Scalar min_distance;
+		
+		// rate of change of center in units per second; allows detail to be
+		// added ahead of a moving subject
+		Vector3 velocity;
 	};
+	
+	using LodParametersVector = std::vector<LodParameters>;
 
 #if defined(CRAG_VERIFY_ENABLED)
 	inline CRAG_VERIFY_INVARIANTS_DEFINE_BEGIN(LodParameters, self)
 		CRAG_VERIFY(self.center);
 		CRAG_VERIFY(self.min_distance);
+		CRAG_VERIFY(self.velocity);
 	CRAG_VERIFY_INVARIANTS_DEFINE_END
 #endif
 }
@@ -138,6 +138,39 @@ namespace gfx
 			CRAG_VERIFY(* this);
 		}
 
+		// returns true iff Patch can be used to resize the buffer to num_vertices
+		bool IsPatchable(int num_vertices) const
+		{
+			return IsInitialized() && num_vertices <= _max_num_vertices;
+		}
+		
+		// resizes the buffer without reallocating it and
+		// overwrites the given ranges of vertices; ranges are pairs of indices
+		template <typename VertexArray, typename RangeArray>
+		void Patch(VertexArray const & vertices, RangeArray const & ranges)
+		{
+			CRAG_VERIFY(* this);
+			
+			auto num_vertices = static_cast<int>(vertices.size());
+			ASSERT(IsPatchable(num_vertices));
+
+			_vbo.Bind();
+			
+			_num_vertices = num_vertices;
+			
+			auto first = vertices.data();
+			for (auto const & range : ranges)
+			{
+				CRAG_VERIFY_OP(range.first, <=, range.second);
+				CRAG_VERIFY_OP(range.second, <=, _num_vertices);
+				_vbo.BufferSubData(range.first, range.second - range.first, first + range.first);
+			}
+			
+			_vbo.Unbind();
+
+			CRAG_VERIFY(* this);
+		}
+
 		// get state
 		bool empty() const
 		{
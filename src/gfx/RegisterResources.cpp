@@ -179,6 +179,13 @@ namespace
 				{ common_fragment_filename, common_shader_filename, light_common_shader_filename, light_fg_solid_filename, "assets/glsl/poly.frag" });
 		});
 
+		manager.Register<PolyProgram>("TerrainProgram", []()
+		{
+			return MakeProgram<PolyProgram>(
+				{ common_vertex_filename, common_shader_filename, light_common_shader_filename, light_fg_solid_filename, "assets/glsl/terrain.vert" },
+				{ common_fragment_filename, common_shader_filename, light_common_shader_filename, light_fg_solid_filename, "assets/glsl/poly.frag" });
+		});
+
 		manager.Register<ShadowProgram>("ShadowProgram", [] ()
 		{
 			return MakeProgram<ShadowProgram>(
@@ -0,0 +1,103 @@
+//
+//  gfx/TerrainVertex.cpp
+//  crag
+//
+//  Created on 2026-10-18.
+//  This program is distributed under the terms of the GNU General Public License.
+//
+
+#include "pch.h"
+
+#include "TerrainVertex.h"
+
+#include "VertexBufferObject.h"
+
+using namespace gfx;
+
+////////////////////////////////////////////////////////////////////////////////
+// file-local definitions
+
+namespace
+{
+	constexpr auto normal_range = float(std::numeric_limits<std::int16_t>::max());
+	
+	float SignNotZero(float s)
+	{
+		return (s >= 0) ? 1.f : -1.f;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// gfx::TerrainVertex member definitions
+
+CRAG_VERIFY_INVARIANTS_DEFINE_BEGIN(TerrainVertex, self)
+	CRAG_VERIFY(self.pos);
+	CRAG_VERIFY_UNIT(TerrainVertex::DecodeNormal(self.norm), .001f);
+CRAG_VERIFY_INVARIANTS_DEFINE_END
+
+TerrainVertex::Normal TerrainVertex::EncodeNormal(Vector3 const & normal)
+{
+	// project onto the octahedron |x| + |y| + |z| = 1
+	auto l1_norm = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+	ASSERT(l1_norm > 0);
+	
+	auto x = normal.x / l1_norm;
+	auto y = normal.y / l1_norm;
+	
+	// fold the lower hemisphere over the upper
+	if (normal.z < 0)
+	{
+		auto folded_x = (1.f - std::abs(y)) * SignNotZero(x);
+		auto folded_y = (1.f - std::abs(x)) * SignNotZero(y);
+		x = folded_x;
+		y = folded_y;
+	}
+	
+	auto quantize = [] (float s)
+	{
+		return static_cast<std::int16_t>(std::round(Clamped(s, -1.f, 1.f) * normal_range));
+	};
+	
+	return Normal(quantize(x), quantize(y));
+}
+
+TerrainVertex::Vector3 TerrainVertex::DecodeNormal(Normal const & normal)
+{
+	auto x = normal.x / normal_range;
+	auto y = normal.y / normal_range;
+	auto z = 1.f - std::abs(x) - std::abs(y);
+	
+	if (z < 0)
+	{
+		auto unfolded_x = (1.f - std::abs(y)) * SignNotZero(x);
+		auto unfolded_y = (1.f - std::abs(x)) * SignNotZero(y);
+		x = unfolded_x;
+		y = unfolded_y;
+	}
+	
+	return geom::Normalized(Vector3(x, y, z));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// gfx::TerrainVertex GL state helper functions
+
+template <>
+void EnableClientState<TerrainVertex>()
+{
+	GL_CALL(glEnableVertexAttribArray(1));
+	GL_CALL(glEnableVertexAttribArray(2));
+}
+
+template <>
+void DisableClientState<TerrainVertex>()
+{
+	GL_CALL(glDisableVertexAttribArray(2));
+	GL_CALL(glDisableVertexAttribArray(1));
+}
+
+template <>
+void Pointer<TerrainVertex>()
+{
+	gfx::VertexAttribPointer<1, TerrainVertex, geom::Vector<float, 3>, & TerrainVertex::pos>();
+	gfx::VertexAttribPointer<2, TerrainVertex, TerrainVertex::Normal, & TerrainVertex::norm>();
+}
@@ -0,0 +1,37 @@
+//
+//  gfx/TerrainVertex.h
+//  crag
+//
+//  Created on 2026-10-18.
+//  This program is distributed under the terms of the GNU General Public License.
+//
+
+#pragma once
+
+#include "defs.h"
+#include "Mesh.h"
+
+namespace gfx
+{
+	// Compact vertex type used to render form::Surrounding as an indexed mesh;
+	// compared to LitVertex, it has no color and its normal is encoded as two
+	// shorts representing a point on an octahedron; decoded in terrain.vert.
+	struct TerrainVertex
+	{
+		typedef ::gfx::Vector3 Vector3;
+		typedef geom::Vector<std::int16_t, 2> Normal;
+		
+		CRAG_VERIFY_INVARIANTS_DECLARE(TerrainVertex);
+		
+		// conversion between unit vector and octahedral encoding
+		static Normal EncodeNormal(Vector3 const & normal);
+		static Vector3 DecodeNormal(Normal const & normal);
+
+		Vector3 pos;
+		Normal norm;
+	};
+	
+	static_assert(sizeof(TerrainVertex) == 16, "unexpected TerrainVertex padding");
+
+	using TerrainMesh = Mesh<TerrainVertex, ElementIndex>;
+}
@@ -116,6 +116,15 @@ namespace gfx
 		static constexpr int dimension = 1;
 	};
 
+	// signed shorts are normalized to [-1, 1]
+	template <>
+	struct TypeInfo<std::int16_t>
+	{
+		static constexpr GLenum type = GL_SHORT;
+		static constexpr bool normalized = true;
+		static constexpr int dimension = 1;
+	};
+	
 	template <>
 	struct TypeInfo<unsigned char>
 	{
@@ -11,18 +11,15 @@
 
 #include "Surrounding.h"
 
+#include "gfx/ChunkedVboResource.h"
 #include "gfx/Debug.h"
 #include "gfx/Engine.h"
 #include "gfx/GenerateShadowVolumeMesh.h"
+#include "gfx/IndexedVboResource.h"
 #include "gfx/Messages.h"
 #include "gfx/NonIndexedVboResource.h"
 #include "gfx/Program.h"
-
-#if defined(CRAG_FORM_FLAT_SHADE)
-#include "gfx/NonIndexedVboResource.h"
-#else
-#include "gfx/IndexedVboResource.h"
-#endif
+#include "gfx/TerrainVertex.h"
 
 #include "form/Engine.h"
 #include "form/Mesh.h"
@@ -41,21 +38,27 @@ namespace
 {
 	STAT (num_polys, std::size_t, .05f);
 	STAT (num_quats_used, std::size_t, 0.15f);
+	STAT (num_mesh_overwrites, int, .2f);
+	STAT (num_mesh_misses, int, .2f);
 	
 	CONFIG_DEFINE(formation_emission, Color4f(0.0f, 0.0f, 0.0f));
 	CONFIG_DEFINE(formation_ambient, Color4f(0.05f));
 	CONFIG_DEFINE(formation_diffuse, Color4f(0.0f, 0.0f, 0.0f));
 
 	char const * vbo_key = "SurroundingMesh";
+	char const * terrain_vbo_key = "SurroundingTerrainMesh";
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
 // gfx::Surrounding member definitions
 
-Surrounding::Surrounding(Engine & engine)
+Surrounding::Surrounding(Engine & engine, std::shared_ptr<form::MeshBuffer> const & mesh_buffer)
 : Object(engine, Transformation(), Layer::opaque, false)
+, _mesh_buffer(mesh_buffer)
 {
+	ASSERT(_mesh_buffer);
+	
 	auto & resource_manager = engine.GetResourceManager();
 	auto const poly_program = resource_manager.GetHandle<PolyProgram>("PolyProgram");
 	SetProgram(poly_program);
@@ -64,6 +67,10 @@ Surrounding::Surrounding(Engine & engine)
 		return VboResource();
 	});
 	
+	resource_manager.Register<TerrainVboResource>(terrain_vbo_key, [&] () {
+		return TerrainVboResource();
+	});
+	
 	CRAG_VERIFY(* this);
 }
 
@@ -72,10 +79,10 @@ CRAG_VERIFY_INVARIANTS_DEFINE_BEGIN(Surrounding, object)
 	
 	auto vbo_resource_handle = object.GetVboResource();
 
-	CRAG_VERIFY(object._mesh);
-	if (object._mesh)
+	CRAG_VERIFY_TRUE(object._mesh_buffer);
+	if (object._has_mesh)
 	{
-		auto const & mesh = * object._mesh;
+		auto const & mesh = object._mesh_buffer->GetFront();
 		CRAG_VERIFY(mesh);
 	}
 	else
@@ -94,25 +101,9 @@ void Surrounding::UpdateModelViewTransformation(Transformation const & model_vie
 	SetModelViewTransformation(model_view * Transformation(static_cast<Vector3>(offset)));
 }
 
-void Surrounding::SetMesh(std::shared_ptr<form::Mesh> const & mesh)
+void Surrounding::OnMeshPublished()
 {
-	// if there's already a mesh queued up,
-	if (_mesh)
-	{
-		ASSERT(mesh != _mesh);
-		
-		// send it back
-		ReturnMesh(_mesh);
-	}
-	
-	// do some assignment
-	_mesh = mesh;
-	_properties = mesh->GetProperties();
-	
-	if (! GetEngine().GetIsSuspended())
-	{
-		UpdateVbo();
-	}
+	UpdateMesh();
 }
 
 Object::PreRenderResult Surrounding::PreRender()
@@ -123,11 +114,13 @@ Object::PreRenderResult Surrounding::PreRender()
 	Debug::AddBasis(_properties._space.AbsToRel(geom::uni::Vector3::Zero()), 1.);
 #endif
 
+	// pick up the latest mesh even if its notification is still in the queue
+	UpdateMesh();
+	
 	auto vbo_resource_handle = GetVboResource();
 	if (vbo_resource_handle)
 	{
-		auto const & vbo_resource = core::StaticCast<VboResource const>(* vbo_resource_handle);
-		if (vbo_resource.empty() && _mesh)
+		if (IsVboEmpty(* vbo_resource_handle) && _has_mesh)
 		{
 			UpdateVbo();
 		}
@@ -138,15 +131,22 @@ Object::PreRenderResult Surrounding::PreRender()
 
 bool Surrounding::GenerateShadowVolume(Light const & light, ShadowVolume & shadow_volume) const
 {
-	if (! _mesh)
+	auto mesh = GetMesh();
+	if (! mesh)
 	{
 		return true;
 	}
 	
+	// shadow volumes are generated from the lit mesh
+	if (_is_indexed)
+	{
+		return false;
+	}
+	
 	auto gfx_light_position = light.GetModelTransformation().GetTranslation();
 	auto form_light_position = GfxToForm(gfx_light_position);
 
-	auto shadow_volume_mesh = GenerateShadowVolumeMesh(_mesh->GetLitMesh(), form_light_position);
+	auto shadow_volume_mesh = GenerateShadowVolumeMesh(mesh->GetLitMesh(), form_light_position);
 	if (shadow_volume_mesh.empty())
 	{
 		return false;
@@ -174,8 +174,8 @@ void Surrounding::Render(Engine const & renderer) const
 		return;
 	}
 	
-	auto const & vbo_resource = core::StaticCast<VboResource const>(* vbo_resource_handle);
-	if (vbo_resource.empty())
+	auto const & vbo_resource = * vbo_resource_handle;
+	if (IsVboEmpty(vbo_resource))
 	{
 		return;
 	}
@@ -193,9 +193,52 @@ void Surrounding::Render(Engine const & renderer) const
 	CRAG_VERIFY(* this);
 }
 
+void Surrounding::UpdateMesh()
+{
+	auto is_updated = _mesh_buffer->Update();
+	
+	STAT_SET (num_mesh_overwrites, _mesh_buffer->GetNumOverwrites());
+	STAT_SET (num_mesh_misses, _mesh_buffer->GetNumMisses());
+	
+	if (! is_updated)
+	{
+		return;
+	}
+	
+	auto const & mesh = _mesh_buffer->GetFront();
+	_has_mesh = true;
+	_properties = mesh.GetProperties();
+	
+	if (mesh.IsIndexed() && ! _is_indexed)
+	{
+		ASSERT(! GetVboResource());
+		_is_indexed = true;
+		
+		auto & resource_manager = GetEngine().GetResourceManager();
+		SetProgram(resource_manager.GetHandle<PolyProgram>("TerrainProgram"));
+	}
+	ASSERT(mesh.IsIndexed() == _is_indexed);
+	
+	if (! GetEngine().GetIsSuspended())
+	{
+		UpdateVbo();
+	}
+}
+
+form::Mesh const * Surrounding::GetMesh() const
+{
+	return _has_mesh ? & _mesh_buffer->GetFront() : nullptr;
+}
+
 void Surrounding::UpdateVbo()
 {
-	auto const & mesh = * _mesh;
+	if (_is_indexed)
+	{
+		UpdateTerrainVbo();
+		return;
+	}
+	
+	auto const & mesh = _mesh_buffer->GetFront();
 	auto const & lit_mesh = mesh.GetLitMesh();
 	auto const & properties = mesh.GetProperties();
 
@@ -212,7 +255,15 @@ void Surrounding::UpdateVbo()
 
 	auto const & vbo_resource = core::StaticCast<VboResource const>(* vbo_resource_handle);
 	auto & mutable_vbo_resource = const_cast<VboResource &>(vbo_resource);
-	mutable_vbo_resource.Set(lit_mesh);
+	if (IsVboPatchable(mesh, vbo_resource))
+	{
+		mutable_vbo_resource.Patch(lit_mesh, mesh.GetDirtyRanges());
+	}
+	else
+	{
+		mutable_vbo_resource.Set(lit_mesh);
+	}
+	_vbo_serial = mesh.IsPatching() ? mesh.GetSerial() : 0;
 
 	// broadcast that this is the current number of quaterne being displayed;
 	// means that any performance measurements are taken against this load
@@ -228,11 +279,83 @@ void Surrounding::UpdateVbo()
 	STAT_SET (num_quats_used, properties._num_quaterne);
 }
 
-void Surrounding::ReturnMesh(std::shared_ptr<form::Mesh> const & mesh)
+void Surrounding::UpdateTerrainVbo()
 {
-	form::Daemon::Call([mesh] (form::Engine & engine) {
-		engine.OnSetMesh(mesh);
-	});
+	auto const & mesh = _mesh_buffer->GetFront();
+	auto const & properties = mesh.GetProperties();
+
+	// lazily create VBO once it arrives from form::Engine
+	auto vbo_resource_handle = GetVboResource();
+	if (! vbo_resource_handle)
+	{
+		auto & resource_manager = GetEngine().GetResourceManager();
+		vbo_resource_handle = resource_manager.GetHandle<TerrainVboResource>(terrain_vbo_key);
+		ASSERT(vbo_resource_handle);
+		
+		SetVboResource(vbo_resource_handle);
+	}
+
+	auto const & vbo_resource = core::StaticCast<TerrainVboResource const>(* vbo_resource_handle);
+	auto & mutable_vbo_resource = const_cast<TerrainVboResource &>(vbo_resource);
+	
+	// upload only those chunks which differ from the contents of the VBO
+	auto num_chunks = mesh.GetNumChunks();
+	mutable_vbo_resource.SetNumChunks(num_chunks);
+	_chunk_serials.resize(num_chunks, 0);
+	
+	std::size_t num_indices = 0;
+	for (auto chunk_index = 0; chunk_index != num_chunks; ++ chunk_index)
+	{
+		auto const & chunk = mesh.GetChunk(chunk_index);
+		num_indices += chunk.GetIndices().size();
+		
+		auto chunk_serial = mesh.GetChunkSerial(chunk_index);
+		if (chunk_serial == _chunk_serials[chunk_index])
+		{
+			continue;
+		}
+		
+		mutable_vbo_resource.SetChunk(chunk_index, chunk);
+		_chunk_serials[chunk_index] = chunk_serial;
+	}
+	
+	auto num_quaterne = properties._num_quaterne;
+	if (num_quaterne > 0)
+	{
+		gfx::NumQuaterneSetMessage message = { num_quaterne };
+		Daemon::Broadcast(message);
+	}
+	
+	STAT_SET (num_polys, num_indices / 3);
+	STAT_SET (num_quats_used, properties._num_quaterne);
+}
+
+bool Surrounding::IsVboEmpty(gfx::VboResource const & vbo_resource) const
+{
+	if (_is_indexed)
+	{
+		return core::StaticCast<TerrainVboResource const>(vbo_resource).empty();
+	}
+	
+	return core::StaticCast<VboResource const>(vbo_resource).empty();
+}
+
+// true iff the VBO already contains everything in mesh except its dirty ranges
+bool Surrounding::IsVboPatchable(form::Mesh const & mesh, VboResource const & vbo_resource) const
+{
+	if (! mesh.IsPatching())
+	{
+		return false;
+	}
+	
+	// the mesh was patched from a state no newer than that of the VBO
+	auto base_serial = mesh.GetBaseSerial();
+	if (base_serial == 0 || base_serial > _vbo_serial)
+	{
+		return false;
+	}
+	
+	return vbo_resource.IsPatchable(static_cast<int>(mesh.GetLitMesh().size()));
 }
 
 Vector3 Surrounding::GfxToForm(Vector3 const & position) const
@@ -25,6 +25,7 @@ namespace form
 namespace gfx
 {
 	struct LitVertex;
+	struct TerrainVertex;
 	
 	template<typename VERTEX, GLenum USAGE> 
 	class NonIndexedVboResource;
@@ -32,6 +33,9 @@ namespace gfx
 	template<typename VERTEX, GLenum USAGE> 
 	class IndexedVboResource;
 
+	template<typename VERTEX, GLenum USAGE> 
+	class ChunkedVboResource;
+
 	// the graphical representation of form::Surrounding
 	class Surrounding final : public Object
 	{
@@ -41,24 +45,31 @@ namespace gfx
 #else
 		using VboResource = gfx::IndexedVboResource<LitVertex, GL_DYNAMIC_DRAW>;
 #endif
+		using TerrainVboResource = gfx::ChunkedVboResource<TerrainVertex, GL_DYNAMIC_DRAW>;
 		
 	public:
 		// functions
-		Surrounding(Engine & engine);
+		Surrounding(Engine & engine, std::shared_ptr<form::MeshBuffer> const & mesh_buffer);
 		
 		CRAG_VERIFY_INVARIANTS_DECLARE(Surrounding);
 		
 		virtual void UpdateModelViewTransformation(Transformation const & model_view) override;
 
-		void SetMesh(std::shared_ptr<form::Mesh> const & mesh);
+		// called by form::Engine after publishing to an empty mesh buffer
+		void OnMeshPublished();
 		
 	private:
 		PreRenderResult PreRender() override;
 		bool GenerateShadowVolume(Light const & light, ShadowVolume & shadow_volume) const override;
 		void Render(Engine const & renderer) const override;
 		
+		void UpdateMesh();
+		form::Mesh const * GetMesh() const;
+		
 		void UpdateVbo();
-		void ReturnMesh(std::shared_ptr<form::Mesh> const & mesh);
+		void UpdateTerrainVbo();
+		bool IsVboEmpty(gfx::VboResource const & vbo_resource) const;
+		bool IsVboPatchable(form::Mesh const & mesh, VboResource const & vbo_resource) const;
 		
 		Vector3 GfxToForm(Vector3 const & position) const;
 		
@@ -66,10 +77,22 @@ namespace gfx
 		// variables
 		
 		// CPU-side mesh geometry sent from form::Engine
-		std::shared_ptr<form::Mesh> _mesh;
+		std::shared_ptr<form::MeshBuffer> _mesh_buffer;
+		
+		// false until the first mesh is picked up from _mesh_buffer
+		bool _has_mesh = false;
 		
 		// basically, where is our origin
 		form::MeshProperties _properties;
+		
+		// serial of the patched mesh whose contents are in the VBO, or zero
+		form::Mesh::Serial _vbo_serial = 0;
+		
+		// true iff meshes are indexed and rendered using TerrainVboResource
+		bool _is_indexed = false;
+		
+		// serials of the mesh chunks whose contents are in the VBO chunks
+		std::vector<form::Mesh::Serial> _chunk_serials;
 	};
 }
 
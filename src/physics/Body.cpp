@@ -32,6 +32,15 @@ using namespace physics;
 
 namespace
 {
+	// a force or torque which is zero doesn't disturb a sleeping body
+	void WakeIfNonZero(BodyHandle body_handle, Vector3 const & v)
+	{
+		if (v != Vector3::Zero())
+		{
+			dBodyEnable(body_handle);
+		}
+	}
+
 #if defined(CRAG_PHYSICS_BODY_DEBUG)
 	template <bool relative_direction, bool relative_position>
 	void DebugDrawForce(Body const & body, Vector3 const & direction, Vector3 const * position = nullptr)
@@ -77,6 +86,7 @@ Body::Body(Transformation const & transformation, Vector3 const * velocity, Engi
 , _collision_handle(collision_handle)
 , _exception(nullptr)
 , _gravitational_force(Vector3::Zero())
+, _was_sleeping(false)
 {
 	// _body_handle
 	if (velocity != nullptr)
@@ -109,6 +119,12 @@ Body::~Body()
 {
 	if (_body_handle != 0)
 	{
+		// bodies resting on this one must be free to fall
+		if (_collision_handle)
+		{
+			_engine.WakeBodies(_collision_handle);
+		}
+		
 		// destroy all joints associated with the body
 		int num_joints = dBodyGetNumJoints (_body_handle);
 		while (num_joints --)
@@ -130,7 +146,7 @@ Body::~Body()
 
 void Body::PreTick()
 {
-	if (_body_handle)
+	if (_body_handle && ! IsSleeping())
 	{
 		AddForce(_gravitational_force);
 	}
@@ -138,7 +154,19 @@ void Body::PreTick()
 
 void Body::PostTick()
 {
-	SetTransformation(GetGeomTransformation());
+	// a body which slept through the tick hasn't moved
+	auto is_sleeping = IsSleeping();
+	if (is_sleeping && _was_sleeping)
+	{
+		return;
+	}
+	
+	_was_sleeping = is_sleeping;
+	
+	// as SetTransformation but without waking the body
+	auto transformation = GetGeomTransformation();
+	SetGeomTransformation(transformation);
+	Location::SetTransformation(transformation);
 }
 
 bool Body::ObeysGravity() const
@@ -196,6 +224,8 @@ void Body::SetMass(Mass const &) const
 
 void Body::SetTransformation(Transformation const & transformation)
 {
+	Wake();
+	
 	// set ODE value
 	SetGeomTransformation(transformation);
 	
@@ -258,6 +288,19 @@ bool Body::IsMovable() const
 	return _body_handle != 0;
 }
 
+bool Body::IsSleeping() const
+{
+	return _body_handle != 0 && ! dBodyIsEnabled(_body_handle);
+}
+
+void Body::Wake()
+{
+	if (_body_handle != 0)
+	{
+		dBodyEnable(_body_handle);
+	}
+}
+
 void Body::SetLinearDamping(Scalar linear_damping)
 {
 	ASSERT(_body_handle != 0);
@@ -273,12 +316,14 @@ void Body::SetAngularDamping(Scalar angular_damping)
 void Body::AddRelTorque(Vector3 const & torque)
 {
 	ASSERT(_body_handle != 0);
+	WakeIfNonZero(_body_handle, torque);
 	dBodyAddRelTorque(_body_handle, torque.x, torque.y, torque.z);
 }
 
 void Body::AddForce(Vector3 const & force)
 {
 	ASSERT(_body_handle != 0);
+	WakeIfNonZero(_body_handle, force);
 	dBodyAddForce(_body_handle, force.x, force.y, force.z);
 
 	DebugDrawForce<false, false>(* this, force);
@@ -287,12 +332,14 @@ void Body::AddForce(Vector3 const & force)
 void Body::AddTorque(Vector3 const & torque)
 {
 	ASSERT(_body_handle != 0);
+	WakeIfNonZero(_body_handle, torque);
 	dBodyAddTorque(_body_handle, torque.x, torque.y, torque.z);
 }
 
 void Body::AddForceAtPos(Vector3 const & force, Vector3 const & pos)
 {
 	ASSERT(_body_handle != 0);
+	WakeIfNonZero(_body_handle, force);
 	dBodyAddForceAtPos(_body_handle, force.x, force.y, force.z, pos.x, pos.y, pos.z);
 
 	DebugDrawForce<false, false>(* this, force, & pos);
@@ -301,6 +348,7 @@ void Body::AddForceAtPos(Vector3 const & force, Vector3 const & pos)
 void Body::AddForceAtRelPos(Vector3 const & force, Vector3 const & pos)
 {
 	ASSERT(_body_handle != 0);
+	WakeIfNonZero(_body_handle, force);
 	dBodyAddForceAtRelPos(_body_handle, force.x, force.y, force.z, pos.x, pos.y, pos.z);
 
 	DebugDrawForce<false, true>(* this, force, & pos);
@@ -309,6 +357,7 @@ void Body::AddForceAtRelPos(Vector3 const & force, Vector3 const & pos)
 void Body::AddRelForce(Vector3 const & force)
 {
 	ASSERT(_body_handle != 0);
+	WakeIfNonZero(_body_handle, force);
 	dBodyAddRelForce(_body_handle, force.x, force.y, force.z);
 
 	DebugDrawForce<true, false>(* this, force);
@@ -317,6 +366,7 @@ void Body::AddRelForce(Vector3 const & force)
 void Body::AddRelForceAtPos(Vector3 const & force, Vector3 const & pos)
 {
 	ASSERT(_body_handle != 0);
+	WakeIfNonZero(_body_handle, force);
 	dBodyAddRelForceAtPos(_body_handle, force.x, force.y, force.z, pos.x, pos.y, pos.z);
 
 	DebugDrawForce<true, false>(* this, force, & pos);
@@ -325,6 +375,7 @@ void Body::AddRelForceAtPos(Vector3 const & force, Vector3 const & pos)
 void Body::AddRelForceAtRelPos(Vector3 const & force, Vector3 const & pos)
 {
 	ASSERT(_body_handle != 0);
+	WakeIfNonZero(_body_handle, force);
 	dBodyAddRelForceAtRelPos(_body_handle, force.x, force.y, force.z, pos.x, pos.y, pos.z);
 
 	DebugDrawForce<true, true>(* this, force, & pos);
@@ -405,6 +456,11 @@ bool Body::HandleCollisionWithRay(Body & that_body)
 	return true;
 }
 
+bool Body::HandleCollisionWithRays(RayCastQuery const *, RayCastQuery const *, form::RayCastResult *)
+{
+	return false;
+}
+
 void Body::OnContact(Body &)
 {
 }
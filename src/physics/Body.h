@@ -11,11 +11,17 @@
 
 #include "Location.h"
 
+namespace form
+{
+	class RayCastResult;
+}
+
 namespace physics
 {
 	// forward-declarations
 	class Body;
 	class Engine;
+	struct RayCastQuery;
 	
 	void Attach(JointHandle joint, Body const & body1, Body const & body2);
 	bool IsAttached(Body const & body1, Body const & body2);
@@ -55,6 +61,12 @@ namespace physics
 		
 		bool IsMovable() const;
 		
+		// true iff the body is movable but was put to sleep by the engine
+		// after resting for a while; sleeping bodies are woken by contact
+		// with moving bodies, by forces and by changes to their transformation
+		bool IsSleeping() const;
+		void Wake();
+		
 		void SetLinearDamping(Scalar linear_damping);
 		void SetAngularDamping(Scalar angular_damping);
 		
@@ -74,6 +86,11 @@ namespace physics
 		virtual bool HandleCollision(Body & that_body, ContactFunction & contact_function) = 0;
 		virtual bool HandleCollisionWithSolid(Body & body, Sphere3 const & bounding_sphere, ContactFunction & contact_function);
 		virtual bool HandleCollisionWithRay(Body & body);
+		
+		// casts a batch of rays against this body, keeping the nearer of each
+		// result and any contact found; returns false if the rays must instead
+		// be cast one at a time via HandleCollisionWithRay
+		virtual bool HandleCollisionWithRays(RayCastQuery const * begin, RayCastQuery const * end, form::RayCastResult * results);
 
 		virtual void OnContact(Body & that_body);
 
@@ -104,5 +121,6 @@ namespace physics
 	private:
 		Body const * _exception;
 		Vector3 _gravitational_force;
+		bool _was_sleeping;	// as of the previous call to PostTick
 	};
 }
@@ -18,10 +18,14 @@
 #include "core/Roster.h"
 #include "core/Statistics.h"
 
+#include "smp/ThreadPool.h"
+
 #include "gfx/Debug.h"
 
 #include <ode/ode.h>
 
+#include <thread>
+
 #if defined(CRAG_DEBUG)
 //#define DEBUG_CONTACTS
 #endif
@@ -52,7 +56,32 @@ namespace
 
 	CONFIG_DEFINE(linear_damping_threshold, .01f);
 
+	// bodies which move more slowly than the given speeds for the given
+	// number of ticks are put to sleep until something disturbs them
+	CONFIG_DEFINE(physics_sleep, true);
+	CONFIG_DEFINE(physics_sleep_linear_threshold, .01f);
+	CONFIG_DEFINE(physics_sleep_angular_threshold, .01f);
+	CONFIG_DEFINE(physics_sleep_num_ticks, 20);
+
+	// broad-phase collision space used for most geoms;
+	// 0: simple (tests all pairs); 1: hash; 2: sweep-and-prune
+	CONFIG_DEFINE(physics_broadphase, 1);
+	
+	// range of cell sizes (as powers of two) used by the hash space
+	CONFIG_DEFINE(physics_hash_space_min_level, -3);
+	CONFIG_DEFINE(physics_hash_space_max_level, 10);
+	
+	// geoms with a greater bounding radius, e.g. planets, are kept apart in a
+	// simple space and tested against everything else so they don't swamp the
+	// broad-phase space
+	CONFIG_DEFINE(physics_large_geom_radius, 1000.);
+	
+	// narrow-phase collision is divided into jobs of at least this many pairs
+	constexpr auto min_pairs_per_job = 4;
+	constexpr auto num_jobs_per_thread = 4;
+
 	STAT (num_contacts, int, .15f);
+	STAT (num_collision_jobs, int, .15f);
 
 #if defined(CRAG_DEBUG)
 	void odeMessageFunction (int errnum, const char *msg, va_list ap)
@@ -64,6 +93,27 @@ namespace
 	}
 #endif
 
+	dSpaceID CreateBroadphaseSpace()
+	{
+		switch (physics_broadphase)
+		{
+			default:
+				DEBUG_BREAK("invalid value; physics_broadphase:%d; range:[0,2]", physics_broadphase);
+			case 0:
+				return dSimpleSpaceCreate(0);
+
+			case 1:
+			{
+				auto space = dHashSpaceCreate(0);
+				dHashSpaceSetLevels(space, physics_hash_space_min_level, physics_hash_space_max_level);
+				return space;
+			}
+
+			case 2:
+				return dSweepAndPruneSpaceCreate(0, dSAP_AXES_XZY);
+		}
+	}
+
 #if defined(CRAG_DEBUG)
 	void DebugRenderSpace(dSpaceID space)
 	{
@@ -77,12 +127,17 @@ namespace
 	}
 #endif
 
-	void OnCastRayCollision(void *, CollisionHandle body_handle, CollisionHandle ray_handle)
+	// data is the body which the ray passes through or null
+	void OnCastRayCollision(void * data, CollisionHandle body_handle, CollisionHandle ray_handle)
 	{
 		ASSERT(dGeomGetClass(ray_handle) == dRayClass);
 
 		void * body_data = dGeomGetData (body_handle);
 		Body & body = ref(static_cast<Body *>(body_data));
+		if (& body == static_cast<Body const *>(data))
+		{
+			return;
+		}
 	
 		void * ray_data = dGeomGetData (ray_handle);
 		RayCast & ray_cast = ref(static_cast<RayCast *>(ray_data));
@@ -90,6 +145,14 @@ namespace
 		body.HandleCollisionWithRay(ray_cast);
 	}
 
+	void OnWakeCollision(void *, CollisionHandle body_handle, CollisionHandle)
+	{
+		void * body_data = dGeomGetData (body_handle);
+		Body & body = ref(static_cast<Body *>(body_data));
+		
+		body.Wake();
+	}
+
 	void OnSphereCollision(void * data, CollisionHandle body_handle, CollisionHandle sphere_handle)
 	{
 		//ASSERT(dGeomGetClass(body_handle) == dSphereClass);
@@ -104,6 +167,23 @@ namespace
 	
 		sphere.HandleCollision(body, contact_interface);
 	}
+	
+	bool IsRay(CollisionHandle geom)
+	{
+		return dGeomGetClass(geom) == dRayClass;
+	}
+	
+	// true iff neither body is moving and at least one is asleep,
+	// in which case, contact between them would change nothing
+	bool AreResting(Body const & body1, Body const & body2)
+	{
+		auto is_moving = [] (Body const & body)
+		{
+			return body.IsMovable() && ! body.IsSleeping();
+		};
+		
+		return (body1.IsSleeping() || body2.IsSleeping()) && ! is_moving(body1) && ! is_moving(body2);
+	}
 }
 CONFIG_DEFINE(collisions_parallelization, true);
 
@@ -112,9 +192,6 @@ CONFIG_DEFINE(collisions_parallelization, true);
 // physics::Engine members
 
 Engine::Engine()
-: world(dWorldCreate())
-, space(dSimpleSpaceCreate(0))
-, contact_joints(dJointGroupCreate(0))
 {
 	// init ODE error handling
 #if defined(CRAG_DEBUG)
@@ -125,6 +202,34 @@ Engine::Engine()
 
 	// init ODE
 	dInitODE();
+	
+	world = dWorldCreate();
+	space = CreateBroadphaseSpace();
+	_large_space = dSimpleSpaceCreate(0);
+	contact_joints = dJointGroupCreate(0);
+	
+	// narrow-phase collision is only spread across threads
+	// if the ODE library was built to allow it (see cmake/ODE.cmake)
+	if (collisions_parallelization)
+	{
+		if (dCheckConfiguration("ODE_EXT_mt_collisions"))
+		{
+			_thread_pool = smp::AcquireSharedThreadPool();
+		}
+		else
+		{
+			DEBUG_MESSAGE("collisions_parallelization ignored; ODE was built without ODE_EXT_mt_collisions");
+		}
+	}
+	
+	if (_thread_pool)
+	{
+		_narrowphase_buffers.resize(_thread_pool->GetNumThreads() * num_jobs_per_thread + 1);
+	}
+	else
+	{
+		_narrowphase_buffers.resize(1);
+	}
 
 	// init _contact
 	ZeroObject(_contact);
@@ -137,10 +242,23 @@ Engine::Engine()
 	dWorldSetDamping(world, linear_damping, angular_damping);
 	dWorldSetLinearDampingThreshold(world, linear_damping_threshold);
 	dWorldSetAngularDampingThreshold(world, linear_damping_threshold);
+	
+	// sleep settings are inherited by bodies as they are created;
+	// ODE wakes sleeping bodies which come into contact with moving bodies
+	dWorldSetAutoDisableFlag(world, physics_sleep);
+	dWorldSetAutoDisableLinearThreshold(world, physics_sleep_linear_threshold);
+	dWorldSetAutoDisableAngularThreshold(world, physics_sleep_angular_threshold);
+	dWorldSetAutoDisableSteps(world, physics_sleep_num_ticks);
+	dWorldSetAutoDisableTime(world, 0);
 }
 
 Engine::~Engine()
 {
+	// the pool may be shared with other systems and outlive this engine
+	// but its workers release their ODE data at the end of each job
+	_thread_pool.reset();
+	
+	dSpaceDestroy(_large_space);
 	dSpaceDestroy(space);
 	dWorldDestroy(world);
 	dJointGroupDestroy(contact_joints);
@@ -166,17 +284,17 @@ dBodyID Engine::CreateBody() const
 
 CollisionHandle Engine::CreateBox(Vector3 const & dimensions) const
 {
-	return dCreateBox(space, dimensions.x, dimensions.y, dimensions.z);
+	return dCreateBox(GetSpace(Magnitude(dimensions) * Scalar(.5)), dimensions.x, dimensions.y, dimensions.z);
 }
 
 CollisionHandle Engine::CreateSphere(Scalar radius) const
 {
-	return dCreateSphere(space, radius);
+	return dCreateSphere(GetSpace(radius), radius);
 }
 
 CollisionHandle Engine::CreateCylinder(Scalar radius, Scalar length) const
 {
-	return dCreateCylinder(space, radius, length);
+	return dCreateCylinder(GetSpace(std::sqrt(Squared(radius) + Squared(length * Scalar(.5)))), radius, length);
 }
 
 CollisionHandle Engine::CreateRay(Scalar length) const
@@ -209,6 +327,10 @@ void Engine::Attach(Body const & body1, Body const & body2)
 
 void Engine::Tick(double delta_time)
 {
+	// rays from the previous tick are forgotten
+	_ray_cast_queries.clear();
+	_ray_cast_results.clear();
+	
 	// call objects that want to know that physics is about to be ticked
 	GetPreTickRoster().Call();
 
@@ -218,6 +340,9 @@ void Engine::Tick(double delta_time)
 		CreateCollisions();
 		CreateJoints();
 		
+		// Cast rays against the same world in which collisions were detected.
+		CastSubmittedRays();
+		
 		// Tick physics (including acting upon collisions).
 		dWorldQuickStep (world, Scalar(delta_time));
 		//dWorldStep (world, delta_time);
@@ -228,7 +353,8 @@ void Engine::Tick(double delta_time)
 	}
 	else
 	{
-		// No collision checking, so just tick physics.
+		// No collision checking, so just cast rays and tick physics.
+		CastSubmittedRays();
 		dWorldQuickStep (world, Scalar(delta_time));
 	}
 	
@@ -239,6 +365,7 @@ void Engine::Tick(double delta_time)
 	if (physics_debug_draw)
 	{
 		DebugRenderSpace(space);
+		DebugRenderSpace(_large_space);
 	}
 #endif
 }
@@ -251,20 +378,90 @@ form::RayCastResult Engine::CastRay(Ray3 const & ray, Scalar length, Body const
 	RayCast ray_cast(* this, length);
 	ray_cast.SetRay(ray);
 	
-	// don't collide against given exception object
-	if (exception != nullptr)
-	{
-		ray_cast.SetIsCollidable(* exception, false);
-	}
-	
 	// perform collision between ray_cast and all pre-existing objects
+	// except the given exception object
 	auto handle = ray_cast.GetCollisionHandle();
-	dSpaceCollide2(reinterpret_cast<CollisionHandle>(space), handle, nullptr, OnCastRayCollision);
+	CollideWithSpaces(handle, const_cast<Body *>(exception), OnCastRayCollision);
 
 	// return result
 	return ray_cast.GetResult();
 }
 
+void Engine::CastRays(RayCastQuery const * begin, RayCastQuery const * end, form::RayCastResult * results)
+{
+	auto num_queries = static_cast<int>(end - begin);
+	std::fill(results, results + num_queries, form::RayCastResult());
+	
+	// a single physics::RayCast object is reused for each query
+	RayCast ray_cast(* this, 0);
+	auto ray_handle = ray_cast.GetCollisionHandle();
+	
+	// casts the queries one at a time against the given geom or space
+	auto cast_rays = [&] (CollisionHandle handle)
+	{
+		for (auto index = 0; index != num_queries; ++ index)
+		{
+			auto const & query = begin[index];
+			auto & result = results[index];
+			
+			ray_cast.SetRay(query.ray);
+			ray_cast.SetLength(query.length);
+			ray_cast.ResetResult();
+			ray_cast.SampleResult(result);
+			
+			dSpaceCollide2(handle, ray_handle, const_cast<Body *>(query.exception), OnCastRayCollision);
+			
+			result = ray_cast.GetResult();
+		}
+	};
+	
+	// most geoms are found by the broad-phase space one query at a time
+	cast_rays(reinterpret_cast<CollisionHandle>(space));
+	
+	// but large geoms, e.g. planets, may take all of the queries at once
+	auto num_large_geoms = dSpaceGetNumGeoms(_large_space);
+	for (auto i = 0; i != num_large_geoms; ++ i)
+	{
+		auto large_geom = dSpaceGetGeom(_large_space, i);
+		auto & body = ref(static_cast<Body *>(dGeomGetData(large_geom)));
+		if (! body.HandleCollisionWithRays(begin, end, results))
+		{
+			cast_rays(large_geom);
+		}
+	}
+}
+
+void Engine::CastSubmittedRays()
+{
+	if (_ray_cast_queries.empty())
+	{
+		return;
+	}
+	
+	// the rays were built by the pre-tick roster from pre-step transforms
+	_ray_cast_results.resize(_ray_cast_queries.size());
+	CastRays(_ray_cast_queries.data(), _ray_cast_queries.data() + _ray_cast_queries.size(), _ray_cast_results.data());
+}
+
+int Engine::SubmitRayCast(RayCastQuery const & query)
+{
+	CRAG_VERIFY_UNIT(query.ray, .0001f);
+	
+	auto index = static_cast<int>(_ray_cast_queries.size());
+	_ray_cast_queries.push_back(query);
+	return index;
+}
+
+form::RayCastResult Engine::GetRayCastResult(int index) const
+{
+	if (index < 0 || index >= static_cast<int>(_ray_cast_results.size()))
+	{
+		return form::RayCastResult();
+	}
+	
+	return _ray_cast_results[index];
+}
+
 void Engine::Collide(Sphere3 const & sphere, ContactFunction & contact_function)
 {
 	// create physics::SphereBody object
@@ -272,7 +469,12 @@ void Engine::Collide(Sphere3 const & sphere, ContactFunction & contact_function)
 	
 	// perform collision between ray_cast and all pre-existing objects
 	auto handle = body.GetCollisionHandle();
-	dSpaceCollide2(reinterpret_cast<CollisionHandle>(space), handle, & contact_function, OnSphereCollision);
+	CollideWithSpaces(handle, & contact_function, OnSphereCollision);
+}
+
+void Engine::WakeBodies(CollisionHandle handle)
+{
+	dSpaceCollide2(reinterpret_cast<CollisionHandle>(space), handle, nullptr, OnWakeCollision);
 }
 
 void Engine::ToggleCollisions()
@@ -280,14 +482,113 @@ void Engine::ToggleCollisions()
 	collisions = ! collisions;
 }
 
+dSpaceID Engine::GetSpace(Scalar bounding_radius) const
+{
+	return (bounding_radius > physics_large_geom_radius) ? _large_space : space;
+}
+
+void Engine::CollideWithSpaces(CollisionHandle handle, void * data, dNearCallback * callback)
+{
+	// the order in which the geoms are passed to callback is unchanged
+	dSpaceCollide2(reinterpret_cast<CollisionHandle>(space), handle, data, callback);
+	dSpaceCollide2(reinterpret_cast<CollisionHandle>(_large_space), handle, data, callback);
+}
+
 void Engine::CreateCollisions()
 {
-	// This basically calls a callback for all the geoms that are quite close.
+	// This basically calls a callback for all the pairs of geoms that are quite close.
 	dSpaceCollide(space, reinterpret_cast<void *>(this), OnNearCollisionCallback);
+	dSpaceCollide(_large_space, reinterpret_cast<void *>(this), OnNearCollisionCallback);
+	
+	// Large geoms are tested against the broad-phase space one at a time.
+	auto num_large_geoms = dSpaceGetNumGeoms(_large_space);
+	for (auto i = 0; i != num_large_geoms; ++ i)
+	{
+		auto large_geom = dSpaceGetGeom(_large_space, i);
+		dSpaceCollide2(large_geom, reinterpret_cast<CollisionHandle>(space), reinterpret_cast<void *>(this), OnNearCollisionCallback);
+	}
+	
+	CollidePairs();
+	_collision_pairs.clear();
 
 	STAT_SET(num_contacts, static_cast<int>(_contacts.size()));
 }
 
+// Generates contacts for the pairs gathered by the broad-phase. The results
+// of each job are kept apart and merged in order, so the outcome is the same
+// regardless of the number of threads or the order in which jobs complete.
+void Engine::CollidePairs()
+{
+	// rays store their results as they collide, so pairs involving rays
+	// are handled on this thread, before any others
+	auto pairs_begin = std::begin(_collision_pairs);
+	auto pairs_end = std::end(_collision_pairs);
+	auto parallel_pairs_begin = std::stable_partition(pairs_begin, pairs_end, [] (CollisionPair const & pair)
+	{
+		return IsRay(pair.first) || IsRay(pair.second);
+	});
+	
+	auto num_parallel_pairs = static_cast<int>(pairs_end - parallel_pairs_begin);
+	auto max_num_jobs = static_cast<int>(_narrowphase_buffers.size()) - 1;
+	auto num_jobs = std::min(max_num_jobs, num_parallel_pairs / min_pairs_per_job);
+	if (num_jobs > 1)
+	{
+		CollidePairs(pairs_begin, parallel_pairs_begin, _narrowphase_buffers[0]);
+		
+		auto caller_id = std::this_thread::get_id();
+		auto job = [&] (int job_index)
+		{
+			// the pool's workers are shared with other systems and may outlive
+			// ODE, so they only hold ODE's per-thread collision data for a job
+			auto is_worker = std::this_thread::get_id() != caller_id;
+			if (is_worker)
+			{
+				dAllocateODEDataForThread(dAllocateMaskAll);
+			}
+			
+			auto job_begin = parallel_pairs_begin + num_parallel_pairs * job_index / num_jobs;
+			auto job_end = parallel_pairs_begin + num_parallel_pairs * (job_index + 1) / num_jobs;
+			CollidePairs(job_begin, job_end, _narrowphase_buffers[job_index + 1]);
+			
+			if (is_worker)
+			{
+				dCleanupODEAllDataForThread();
+			}
+		};
+		
+		ASSERT(_thread_pool);
+		_thread_pool->Run(num_jobs, job);
+	}
+	else
+	{
+		CollidePairs(pairs_begin, pairs_end, _narrowphase_buffers[0]);
+		num_jobs = 0;
+	}
+	
+	STAT_SET(num_collision_jobs, num_jobs);
+	
+	// merge
+	std::for_each(std::begin(_narrowphase_buffers), std::begin(_narrowphase_buffers) + num_jobs + 1, [&] (NarrowphaseBuffer & buffer)
+	{
+		_contacts.insert(std::end(_contacts), std::begin(buffer.contacts), std::end(buffer.contacts));
+		buffer.contacts.clear();
+		
+		for (auto const & touch : buffer.touches)
+		{
+			touch.first->OnContact(* touch.second);
+		}
+		buffer.touches.clear();
+	});
+}
+
+void Engine::CollidePairs(CollisionPairVector::const_iterator begin, CollisionPairVector::const_iterator end, NarrowphaseBuffer & buffer) const
+{
+	std::for_each(begin, end, [&] (CollisionPair const & pair)
+	{
+		CollidePair(pair.first, pair.second, buffer);
+	});
+}
+
 void Engine::CreateJoints()
 {
 	for (ContactVector::const_iterator i = _contacts.begin(); i != _contacts.end(); ++ i)
@@ -334,11 +635,32 @@ void Engine::OnNearCollisionCallback (void * data, CollisionHandle geom1, Collis
 	{
 		return;
 	}
+	
+	// rays record contact with resting bodies; nothing else need do so
+	if (AreResting(body1, body2) && ! IsRay(geom1) && ! IsRay(geom2))
+	{
+		return;
+	}
+
+	engine._collision_pairs.emplace_back(geom1, geom2);
+}
+
+// May be called concurrently for pairs which don't involve rays;
+// bodies are notified of contact once all pairs have been collided.
+void Engine::CollidePair(CollisionHandle geom1, CollisionHandle geom2, NarrowphaseBuffer & buffer) const
+{
+	Body & body1 = ref(reinterpret_cast<Body *>(dGeomGetData(geom1)));
+	Body & body2 = ref(reinterpret_cast<Body *>(dGeomGetData(geom2)));
+	
+	auto add_touches = [& buffer, & body1, & body2] ()
+	{
+		buffer.touches.emplace_back(& body1, & body2);
+		buffer.touches.emplace_back(& body2, & body1);
+	};
 
-	auto contact_function = ContactFunction([& engine, & body1, & body2] (ContactGeom const * begin, ContactGeom const * end) {
-		engine.AddContacts(begin, end);
-		body1.OnContact(body2);
-		body2.OnContact(body1);
+	auto contact_function = ContactFunction([this, & buffer, & add_touches] (ContactGeom const * begin, ContactGeom const * end) {
+		AddContacts(begin, end, buffer);
+		add_touches();
 	});
 	
 	if (body1.HandleCollision(body2, contact_function))
@@ -351,13 +673,12 @@ void Engine::OnNearCollisionCallback (void * data, CollisionHandle geom1, Collis
 		return;
 	}
 	
-	engine.OnUnhandledCollision(geom1, geom2);
-	body1.OnContact(body2);
-	body2.OnContact(body1);
+	OnUnhandledCollision(geom1, geom2, buffer);
+	add_touches();
 }
 
 // This is the default handler. It leaves ODE to deal with it. 
-void Engine::OnUnhandledCollision(CollisionHandle geom1, CollisionHandle geom2)
+void Engine::OnUnhandledCollision(CollisionHandle geom1, CollisionHandle geom2, NarrowphaseBuffer & buffer) const
 {
 	// No reason not to keep this nice and high; it's on the stack.
 	int constexpr max_contacts_per_collision = 1024;
@@ -372,23 +693,24 @@ void Engine::OnUnhandledCollision(CollisionHandle geom1, CollisionHandle geom2)
 	// Time to increase max_num_contacts?
 	ASSERT (num_contacts * 2 <= max_contacts_per_collision);
 
-	AddContacts(contact_geoms, contact_geoms + num_contacts);
+	AddContacts(contact_geoms, contact_geoms + num_contacts, buffer);
 }
 
 // Called once individual points of contact have been determined.
-void Engine::AddContacts(ContactGeom const * begin, ContactGeom const * end)
+void Engine::AddContacts(ContactGeom const * begin, ContactGeom const * end, NarrowphaseBuffer & buffer) const
 {
+	auto & contacts = buffer.contacts;
 	auto count = end - begin;
-	_contacts.reserve(_contacts.size() + count);
-	std::for_each(begin, end, [=] (ContactGeom const & contact_geom)
+	contacts.reserve(contacts.size() + count);
+	std::for_each(begin, end, [&] (ContactGeom const & contact_geom)
 	{
 		// geometry sanity tests
 		CRAG_VERIFY_OP(contact_geom.g1, !=, contact_geom.g2);
 		CRAG_VERIFY_OP(contact_geom.depth, >=, 0);
 		CRAG_VERIFY_UNIT(Convert(contact_geom.normal), .01f);
 
-		_contact.geom = contact_geom;
-		_contacts.push_back(_contact);
+		contacts.push_back(_contact);
+		contacts.back().geom = contact_geom;
 
 #if defined(DEBUG_CONTACTS)
 		Vector3 pos(Convert(contact_geom.pos));
@@ -11,6 +11,8 @@
 
 #include "defs.h"
 
+#include "form/RayCastResult.h"
+
 namespace crag
 {
 	namespace core
@@ -19,9 +21,9 @@ namespace crag
 	}
 }
 
-namespace form
+namespace smp
 {
-	class RayCastResult;
+	class ThreadPool;
 }
 
 namespace physics
@@ -29,6 +31,14 @@ namespace physics
 	// forward-declarations
 	class Body;
 	
+	// a ray to be cast by Engine::CastRays
+	struct RayCastQuery
+	{
+		Ray3 ray;	// must have unit direction
+		Scalar length;
+		Body const * exception;	// body which the ray passes through; may be null
+	};
+	
 	// The physics singleton.
 	class Engine
 	{
@@ -37,6 +47,19 @@ namespace physics
 		
 		// store of all the contacts that occur in a Tick
 		typedef std::vector<Contact> ContactVector;
+		
+		// pairs of geoms which the broad-phase found to be quite close
+		typedef std::pair<CollisionHandle, CollisionHandle> CollisionPair;
+		typedef std::vector<CollisionPair> CollisionPairVector;
+		
+		// the results of narrow-phase collision for a range of pairs
+		struct NarrowphaseBuffer
+		{
+			ContactVector contacts;
+			
+			// bodies to be notified (via OnContact) of contact with other bodies
+			std::vector<std::pair<Body *, Body *>> touches;
+		};
 
 	public:
 		////////////////////////////////////////////////////////////////////////////////
@@ -65,29 +88,67 @@ namespace physics
 		
 		// use sparingly
 		form::RayCastResult CastRay(Ray3 const & ray, Scalar length, Body const * exception = nullptr);
+		
+		// performs the given ray casts together; fills out one result per query
+		void CastRays(RayCastQuery const * begin, RayCastQuery const * end, form::RayCastResult * results);
+		
+		// Rays submitted by the pre-tick roster are cast together before the
+		// world is stepped, so they see the same transforms they were built from;
+		// returns the index of the ray's result within the current tick.
+		int SubmitRayCast(RayCastQuery const & query);
+		
+		// returns an empty result if the index is not that of a ray cast this tick
+		form::RayCastResult GetRayCastResult(int index) const;
+		
 		void Collide(Sphere3 const & sphere, ContactFunction & contact_function);
 		
+		// wakes sleeping bodies whose geoms are near the given geom
+		void WakeBodies(CollisionHandle handle);
+		
 		void ToggleCollisions();
 	private:
+		// the space in which to create a geom of the given size
+		dSpaceID GetSpace(Scalar bounding_radius) const;
+		
+		// collides the given geom with every other geom
+		void CollideWithSpaces(CollisionHandle handle, void * data, dNearCallback * callback);
+		
+		// casts the rays submitted during the current tick
+		void CastSubmittedRays();
+		
 		void CreateCollisions();
+		void CollidePairs();
+		void CollidePairs(CollisionPairVector::const_iterator begin, CollisionPairVector::const_iterator end, NarrowphaseBuffer & buffer) const;
 		void CreateJoints();
 		void DestroyJoints();
 		void DestroyCollisions();
 		static void OnNearCollisionCallback (void *data, CollisionHandle geom1, CollisionHandle geom2);
+		void CollidePair(CollisionHandle geom1, CollisionHandle geom2, NarrowphaseBuffer & buffer) const;
 		
 		// called on bodies which don't handling their own collision
-		void OnUnhandledCollision(CollisionHandle geom1, CollisionHandle geom2);
+		void OnUnhandledCollision(CollisionHandle geom1, CollisionHandle geom2, NarrowphaseBuffer & buffer) const;
 
-		void AddContacts(ContactGeom const * begin, ContactGeom const * end);
+		void AddContacts(ContactGeom const * begin, ContactGeom const * end, NarrowphaseBuffer & buffer) const;
 
 		// variables
 		dWorldID world;
 		dSpaceID space;
+		dSpaceID _large_space;	// geoms which are too big for space
 		dJointGroupID contact_joints;
 
 		// it seems that ODE keeps a hold of the contacts which are passed to it.
 		ContactVector _contacts;
 		dContact _contact;	// permanently stores common properties
+		
+		// used by CreateCollisions to spread narrow-phase collision across cores;
+		// the first buffer is used when collision is performed serially
+		CollisionPairVector _collision_pairs;
+		std::vector<NarrowphaseBuffer> _narrowphase_buffers;
+		std::shared_ptr<smp::ThreadPool> _thread_pool;
+		
+		// rays submitted during the current tick and, once cast, their results
+		std::vector<RayCastQuery> _ray_cast_queries;
+		std::vector<form::RayCastResult> _ray_cast_results;
 	};
 	
 }
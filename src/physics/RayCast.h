@@ -36,12 +36,11 @@ namespace physics
 		
 		form::RayCastResult const & GetResult() const;
 		void SampleResult(form::RayCastResult const & result);
+		void ResetResult();
 
 		void DebugDraw() const override;
 
 	private:
-		void ResetResult();
-		
 		void SetDensity(Scalar density) override;
 
 		bool HandleCollision(Body & that_body, ContactFunction & contact_function) override;
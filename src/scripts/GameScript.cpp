@@ -31,7 +31,7 @@
 using geom::Vector3f;
 using applet::AppletInterface;
 
-CONFIG_DEFINE(profile_mode, false);
+CONFIG_DECLARE(profile_mode, bool);
 
 namespace
 {
@@ -59,6 +59,7 @@ void InitSpace(applet::AppletInterface & applet_interface, geom::Space const & s
 		gfx::SetLodParametersEvent event;
 		event.parameters.center = gfx::Vector3::Zero();
 		event.parameters.min_distance = 1.f;
+		event.parameters.velocity = gfx::Vector3::Zero();
 		gfx::Daemon::Broadcast(event);
 	}
 	
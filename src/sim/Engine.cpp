@@ -56,7 +56,7 @@ Engine::Engine()
 : quit_flag(false)
 , _time(0)
 , _camera(Ray3::Zero())
-, _lod_parameters({ Vector3::Zero(), 1.f })
+, _lod_parameters({ Vector3::Zero(), 1.f, Vector3::Zero() })
 , _physics_engine(new physics::Engine)
 #if defined(CRAG_SIM_FORMATION_PHYSICS)
 , _collision_scene(new form::Scene(512, 512))
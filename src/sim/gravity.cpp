@@ -38,6 +38,11 @@ namespace
 	{
 		Vector3 const & position = location.GetTranslation();
 		auto & body = core::StaticCast<physics::Body>(location);
+		if (body.IsSleeping())
+		{
+			return;
+		}
+		
 		Scalar mass = body.GetMass();
 		if (mass <= 0)
 		{
@@ -0,0 +1,154 @@
+//
+//  ThreadPool.cpp
+//  crag
+//
+//  Created on 2026-10-18.
+//  This program is distributed under the terms of the GNU General Public License.
+//
+
+#include "pch.h"
+
+#include "ThreadPool.h"
+
+#include "smp.h"
+
+using namespace smp;
+
+////////////////////////////////////////////////////////////////////////////////
+// smp::ThreadPool member definitions
+
+ThreadPool::ThreadPool(int num_workers, char const * name)
+: _workers(new Thread [num_workers])
+, _num_workers(num_workers)
+, _is_running(false)
+, _job_function(nullptr)
+, _next_job_index(0)
+, _num_jobs(0)
+, _quit_flag(false)
+{
+	ASSERT(num_workers >= 0);
+
+	for (auto worker_index = 0; worker_index != _num_workers; ++ worker_index)
+	{
+		_workers[worker_index].Launch([this] ()
+		{
+			WorkerLoop();
+		}, name);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	_quit_flag = true;
+
+	for (auto worker_index = 0; worker_index != _num_workers; ++ worker_index)
+	{
+		_start.Increment();
+	}
+
+	for (auto worker_index = 0; worker_index != _num_workers; ++ worker_index)
+	{
+		_workers[worker_index].Join();
+	}
+}
+
+int ThreadPool::GetNumThreads() const
+{
+	return _num_workers + 1;
+}
+
+void ThreadPool::Run(int num_jobs, JobFunction job_function)
+{
+	ASSERT(num_jobs >= 0);
+
+	// the workers are busy with another thread's batch
+	if (_is_running.exchange(true, std::memory_order_acquire))
+	{
+		for (auto job_index = 0; job_index != num_jobs; ++ job_index)
+		{
+			job_function(job_index);
+		}
+		return;
+	}
+
+	ASSERT(_job_function == nullptr);
+	_job_function = & job_function;
+	_num_jobs = num_jobs;
+	_next_job_index = 0;
+
+	// wake up enough workers to help out
+	auto num_helpers = std::min(_num_workers, num_jobs - 1);
+	for (auto helper_index = 0; helper_index < num_helpers; ++ helper_index)
+	{
+		_start.Increment();
+	}
+
+	// muck in
+	PerformJobs();
+
+	// wait for the stragglers
+	for (auto helper_index = 0; helper_index < num_helpers; ++ helper_index)
+	{
+		_finish.Decrement();
+	}
+
+	_job_function = nullptr;
+	_is_running.store(false, std::memory_order_release);
+}
+
+void ThreadPool::WorkerLoop()
+{
+	for (;;)
+	{
+		_start.Decrement();
+
+		if (_quit_flag)
+		{
+			break;
+		}
+
+		PerformJobs();
+
+		_finish.Increment();
+	}
+}
+
+void ThreadPool::PerformJobs()
+{
+	auto & job_function = * _job_function;
+
+	for (;;)
+	{
+		auto job_index = std::atomic_fetch_add(& _next_job_index, 1);
+		if (job_index >= _num_jobs)
+		{
+			break;
+		}
+
+		job_function(job_index);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// smp function definitions
+
+std::shared_ptr<ThreadPool> smp::AcquireSharedThreadPool()
+{
+	static std::mutex mutex;
+	static std::weak_ptr<ThreadPool> shared_thread_pool;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto thread_pool = shared_thread_pool.lock();
+	if (! thread_pool)
+	{
+		auto num_cpus = static_cast<int>(GetNumCpus());
+		if (num_cpus > 1)
+		{
+			thread_pool = std::make_shared<ThreadPool>(num_cpus - 1, "pool");
+			shared_thread_pool = thread_pool;
+		}
+	}
+
+	return thread_pool;
+}
@@ -0,0 +1,65 @@
+//
+//  ThreadPool.h
+//  crag
+//
+//  Created on 2026-10-18.
+//  This program is distributed under the terms of the GNU General Public License.
+//
+
+#pragma once
+
+#include "Semaphore.h"
+#include "Thread.h"
+
+#include "core/function_ref.h"
+
+namespace smp
+{
+	// A fixed set of worker threads which cooperate with the calling thread
+	// to perform a batch of independent jobs. Jobs are identified by index
+	// and are handed out in no particular order. Run returns once every job in
+	// the batch has been performed. If another thread is already running a
+	// batch, the caller performs its jobs alone rather than wait.
+	class ThreadPool
+	{
+		OBJECT_NO_COPY(ThreadPool);
+
+	public:
+		// types
+		using JobFunction = core::function_ref<void (int job_index)>;
+
+		// functions
+		ThreadPool(int num_workers, char const * name);
+		~ThreadPool();
+
+		// the number of threads which perform jobs, including the caller of Run
+		int GetNumThreads() const;
+
+		// calls job_function for each index in [0, num_jobs)
+		void Run(int num_jobs, JobFunction job_function);
+
+	private:
+		void WorkerLoop();
+		void PerformJobs();
+
+		////////////////////////////////////////////////////////////////////////////////
+		// variables
+
+		std::unique_ptr<Thread []> _workers;
+		int const _num_workers;
+
+		Semaphore _start;
+		Semaphore _finish;
+
+		std::atomic<bool> _is_running;
+		JobFunction const * _job_function;
+		std::atomic<int> _next_job_index;
+		int _num_jobs;
+		bool _quit_flag;
+	};
+	
+	// returns the pool which is shared by all systems, creating it if needed;
+	// it has one worker fewer than there are CPUs and is destroyed when the
+	// last reference is released; returns null on single-core systems
+	std::shared_ptr<ThreadPool> AcquireSharedThreadPool();
+}
@@ -0,0 +1,148 @@
+//
+//  TripleBuffer.h
+//  crag
+//
+//  Created on 2026-10-18.
+//  This program is distributed under the terms of the GNU General Public License.
+//
+
+#pragma once
+
+namespace smp
+{
+	// A lock-free, latest-wins mailbox through which a single writer thread
+	// passes values to a single reader thread. The writer always has a back
+	// value to fill and the reader always has a front value to read; the third
+	// value sits between them. Neither side ever blocks: when the writer
+	// publishes before the reader has picked up the previous value, that value
+	// is overwritten; when the reader updates and nothing new was published,
+	// it keeps its current value. Both occurrences are counted.
+	template <typename VALUE>
+	class TripleBuffer
+	{
+		OBJECT_NO_COPY(TripleBuffer);
+
+		////////////////////////////////////////////////////////////////////////////////
+		// types
+
+		using Array = std::array<VALUE, 3>;
+
+		// the middle index is stored alongside a flag which is set
+		// iff it was published since the reader last updated
+		enum
+		{
+			index_mask = 3,
+			fresh_flag = 4
+		};
+
+	public:
+		using value_type = VALUE;
+		using iterator = typename Array::iterator;
+
+		////////////////////////////////////////////////////////////////////////////////
+		// functions
+
+		TripleBuffer()
+		: _back(0)
+		, _middle(1)
+		, _front(2)
+		, _num_overwrites(0)
+		, _num_misses(0)
+		{
+		}
+
+		// writer interface
+
+		VALUE & GetBack()
+		{
+			return _values[_back];
+		}
+
+		// makes the back value available to the reader and takes a new back value;
+		// returns false iff the previously published value was never picked up,
+		// in which case, the reader has yet to be notified of the previous publish
+		bool Publish()
+		{
+			auto previous = _middle.exchange(_back | fresh_flag, std::memory_order_acq_rel);
+			_back = previous & index_mask;
+
+			if (previous & fresh_flag)
+			{
+				_num_overwrites.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			return true;
+		}
+
+		// reader interface
+
+		// makes the most recently published value the front value;
+		// returns false if nothing was published since the last call
+		bool Update()
+		{
+			if (! (_middle.load(std::memory_order_relaxed) & fresh_flag))
+			{
+				_num_misses.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			auto previous = _middle.exchange(_front, std::memory_order_acq_rel);
+			_front = previous & index_mask;
+			return true;
+		}
+
+		VALUE & GetFront()
+		{
+			return _values[_front];
+		}
+
+		VALUE const & GetFront() const
+		{
+			return _values[_front];
+		}
+
+		// counters; may be read from any thread
+
+		// number of published values which the reader never saw
+		int GetNumOverwrites() const
+		{
+			return _num_overwrites.load(std::memory_order_relaxed);
+		}
+
+		// number of times the reader found nothing new
+		int GetNumMisses() const
+		{
+			return _num_misses.load(std::memory_order_relaxed);
+		}
+
+		// access to all three values; only safe before the buffer is shared
+		iterator begin()
+		{
+			return std::begin(_values);
+		}
+
+		iterator end()
+		{
+			return std::end(_values);
+		}
+
+	private:
+		////////////////////////////////////////////////////////////////////////////////
+		// variables
+
+		Array _values;
+
+		// owned by the writer
+		int _back;
+
+		// shared
+		std::atomic<int> _middle;
+
+		// owned by the reader
+		int _front;
+
+		std::atomic<int> _num_overwrites;
+		std::atomic<int> _num_misses;
+	};
+}